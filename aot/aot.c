@@ -0,0 +1,320 @@
+#include "aot.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// where the runtime's sources are, set by the Makefile
+#ifndef MONKEY_ROOT
+#define MONKEY_ROOT "."
+#endif
+
+// what an executable links against besides its own translation
+static const char* runtime_sources[] = {
+  "aot/aot_runtime.c",
+  "vm/vm.c",
+  "vm/jit.c",
+  "code/code.c",
+  "object/object.c",
+  "object/gc.c",
+  "object/builtins.c",
+  "ast/ast.c",
+  "token/token.c",
+  "utils/list.c",
+  "utils/arena.c",
+};
+
+static void emit_function(
+  FILE* out, char* name, Instruct* ins, ConstantPool* pool);
+static void emit_instruction(
+  FILE* out, Byte* bytes, ConstantPool* pool);
+static char* constant_value(ConstantPool* pool, int index);
+static void emit_string(FILE* out, char* str);
+
+AotErr aot_emit_c(FILE* out, Bytecode* bytecode) {
+  ConstantPool* pool = bytecode->constants;
+  for (int i = 0; i < pool->length; i++) {
+    ObjectType type = pool->constants[i]->type;
+    if (type != INTEGER_OBJ && type != STRING_OBJ &&
+        type != COMPILED_FUNCTION_OBJ) {
+      char* err = malloc(100);
+      sprintf(err, "can't translate constant of type %s",
+        object_type(*pool->constants[i]));
+      return err;
+    }
+  }
+
+  fprintf(out, "// generated by `monkey build`\n");
+  fprintf(out, "#include \"aot/aot_runtime.h\"\n\n");
+  for (int i = 0; i < pool->length; i++)
+    if (pool->constants[i]->type == COMPILED_FUNCTION_OBJ)
+      fprintf(out, "static VmErr fn_%d(Vm vm);\n", i);
+  fprintf(out, "static VmErr fn_main(Vm vm);\n");
+
+  char name[32];
+  for (int i = 0; i < pool->length; i++) {
+    if (pool->constants[i]->type == COMPILED_FUNCTION_OBJ) {
+      sprintf(name, "fn_%d", i);
+      emit_function(out, name,
+        pool->constants[i]->value.compiled_fn->instructions, pool);
+    }
+  }
+  emit_function(out, "fn_main", bytecode->instructions, pool);
+
+  fprintf(out, "\nint main(void) {\n");
+  fprintf(out, "  Object* constants[] = {\n");
+  for (int i = 0; i < pool->length; i++) {
+    Object* constant = pool->constants[i];
+    fprintf(out, "    ");
+    if (constant->type == INTEGER_OBJ) {
+      fprintf(out, "aot_int(%d)", constant->value.i);
+    } else if (constant->type == STRING_OBJ) {
+      fprintf(out, "aot_string(");
+      emit_string(out, constant->value.str);
+      fprintf(out, ")");
+    } else {
+      CompiledFunction* fn = constant->value.compiled_fn;
+      fprintf(out, "aot_function(fn_%d, %d, %d)", i, fn->num_locals,
+        fn->num_params);
+    }
+    fprintf(out, ",\n");
+  }
+  fprintf(out, "    NULL,\n  };\n");
+  fprintf(out, "  return aot_main(%d, constants, fn_main);\n}\n",
+    pool->length);
+  return NULL;
+}
+
+// jumps become gotos, to labels placed only where something jumps to
+static void emit_function(
+  FILE* out, char* name, Instruct* ins, ConstantPool* pool) {
+  bool* targets = calloc(ins->length + 1, sizeof(bool));
+  for (int ip = 0; ip < ins->length;
+       ip += code_instruction_width(ins->bytes[ip])) {
+    switch (ins->bytes[ip]) {
+      case OP_JUMP:
+      case OP_JUMP_NOT_TRUTHY:
+      case OP_JUMP_IF_NOT_EQUAL:
+      case OP_JUMP_IF_EQUAL:
+      case OP_JUMP_IF_NOT_GREATER:
+        targets[read_uint32(&ins->bytes[ip + 1])] = true;
+        break;
+    }
+  }
+
+  fprintf(out, "\nstatic VmErr %s(Vm vm) {\n", name);
+  fprintf(out, "  AOT_ENTER(%d);\n", code_max_stack_depth(ins));
+  for (int ip = 0; ip < ins->length;
+       ip += code_instruction_width(ins->bytes[ip])) {
+    if (targets[ip])
+      fprintf(out, "L%d:;\n", ip);
+    emit_instruction(out, &ins->bytes[ip], pool);
+  }
+  if (targets[ins->length])
+    fprintf(out, "L%d:;\n", ins->length);
+  // only the main program runs off its end
+  fprintf(out, "  vm->sp = sp - vm->stack;\n");
+  fprintf(out, "  return NULL;\n}\n");
+  free(targets);
+}
+
+static void emit_instruction(FILE* out, Byte* bytes, ConstantPool* pool) {
+  fprintf(out, "  ");
+  switch (bytes[0]) {
+    case OP_CONSTANT:
+      fprintf(out, "AOT_PUSH(%s);\n",
+        constant_value(pool, read_uint16(&bytes[1])));
+      break;
+    case OP_TRUE:
+      fprintf(out, "AOT_PUSH(VALUE_TRUE);\n");
+      break;
+    case OP_FALSE:
+      fprintf(out, "AOT_PUSH(VALUE_FALSE);\n");
+      break;
+    case OP_NULL:
+      fprintf(out, "AOT_PUSH(VALUE_NULL);\n");
+      break;
+    case OP_POP:
+      fprintf(out, "sp--;\n");
+      break;
+    case OP_ADD:
+    case OP_ADD_INT:
+      fprintf(out, "AOT_ARITHMETIC(OP_ADD, +);\n");
+      break;
+    case OP_SUB:
+    case OP_SUB_INT:
+      fprintf(out, "AOT_ARITHMETIC(OP_SUB, -);\n");
+      break;
+    case OP_MUL:
+    case OP_MUL_INT:
+      fprintf(out, "AOT_ARITHMETIC(OP_MUL, *);\n");
+      break;
+    case OP_DIV:
+    case OP_DIV_INT:
+      fprintf(out, "AOT_ARITHMETIC(OP_DIV, /);\n");
+      break;
+    case OP_EQUAL:
+    case OP_EQUAL_INT:
+      fprintf(out, "AOT_COMPARISON(OP_EQUAL, ==);\n");
+      break;
+    case OP_NOT_EQUAL:
+    case OP_NOT_EQUAL_INT:
+      fprintf(out, "AOT_COMPARISON(OP_NOT_EQUAL, !=);\n");
+      break;
+    case OP_GREATER_THAN:
+    case OP_GREATER_THAN_INT:
+      fprintf(out, "AOT_COMPARISON(OP_GREATER_THAN, >);\n");
+      break;
+    case OP_MINUS:
+      fprintf(out, "AOT_RUNTIME(exec_minus_operator(vm));\n");
+      break;
+    case OP_BANG:
+      fprintf(out, "AOT_RUNTIME(exec_bang_operator(vm));\n");
+      break;
+    case OP_JUMP:
+      fprintf(out, "goto L%d;\n", read_uint32(&bytes[1]));
+      break;
+    case OP_JUMP_NOT_TRUTHY:
+      fprintf(out, "AOT_JUMP_NOT_TRUTHY(L%d);\n", read_uint32(&bytes[1]));
+      break;
+    case OP_SET_GLOBAL:
+      fprintf(out, "AOT_SET_GLOBAL(%d);\n", read_uint16(&bytes[1]));
+      break;
+    case OP_GET_GLOBAL:
+      fprintf(out, "AOT_PUSH(vm->globals[%d]);\n", read_uint16(&bytes[1]));
+      break;
+    case OP_SET_LOCAL:
+      fprintf(out, "locals[%d] = *--sp;\n", bytes[1]);
+      break;
+    case OP_GET_LOCAL:
+      fprintf(out, "AOT_PUSH(locals[%d]);\n", bytes[1]);
+      break;
+    case OP_ARRAY:
+      fprintf(out, "AOT_RUNTIME(aot_array(vm, %d));\n", read_uint16(&bytes[1]));
+      break;
+    case OP_HASH:
+      fprintf(out, "AOT_RUNTIME(aot_hash(vm, %d));\n", read_uint16(&bytes[1]));
+      break;
+    case OP_INDEX:
+      fprintf(out, "AOT_RUNTIME(aot_index(vm));\n");
+      break;
+    case OP_CALL:
+      fprintf(out, "AOT_RUNTIME(aot_call(vm, %d));\n", bytes[1]);
+      break;
+    case OP_TAIL_CALL:
+      fprintf(out, "AOT_RUNTIME(aot_tail_call(vm, %d));\n", bytes[1]);
+      break;
+    case OP_RETURN_VALUE:
+      fprintf(out, "AOT_RETURN(sp[-1]);\n");
+      break;
+    case OP_RETURN:
+      fprintf(out, "AOT_RETURN(VALUE_NULL);\n");
+      break;
+    case OP_GET_BUILTIN:
+      fprintf(out, "AOT_RUNTIME(aot_get_builtin(vm, %d));\n", bytes[1]);
+      break;
+    case OP_CLOSURE:
+      fprintf(out, "AOT_RUNTIME(aot_closure(vm, %d, %d));\n",
+        read_uint16(&bytes[1]), bytes[3]);
+      break;
+    case OP_CURRENT_CLOSURE:
+      fprintf(out, "AOT_PUSH(VALUE_OBJ(cl->object));\n");
+      break;
+    case OP_GET_FREE:
+      fprintf(out, "AOT_PUSH(cl->free[%d]);\n", bytes[1]);
+      break;
+    case OP_GET_LOCAL_CONSTANT:
+      fprintf(out, "AOT_PUSH(locals[%d]);\n  AOT_PUSH(%s);\n", bytes[1],
+        constant_value(pool, read_uint16(&bytes[2])));
+      break;
+    case OP_ADD_LOCAL_CONSTANT:
+    case OP_SUB_LOCAL_CONSTANT:
+      fprintf(out, "AOT_PUSH(locals[%d]);\n  AOT_PUSH(%s);\n", bytes[1],
+        constant_value(pool, read_uint16(&bytes[2])));
+      fprintf(out, "  AOT_ARITHMETIC(%s);\n",
+        bytes[0] == OP_ADD_LOCAL_CONSTANT ? "OP_ADD, +" : "OP_SUB, -");
+      break;
+    case OP_JUMP_IF_NOT_EQUAL:
+      fprintf(out, "AOT_COMPARE_AND_JUMP(OP_EQUAL, ==, L%d);\n",
+        read_uint32(&bytes[1]));
+      break;
+    case OP_JUMP_IF_EQUAL:
+      fprintf(out, "AOT_COMPARE_AND_JUMP(OP_NOT_EQUAL, !=, L%d);\n",
+        read_uint32(&bytes[1]));
+      break;
+    case OP_JUMP_IF_NOT_GREATER:
+      fprintf(out, "AOT_COMPARE_AND_JUMP(OP_GREATER_THAN, >, L%d);\n",
+        read_uint32(&bytes[1]));
+      break;
+  }
+}
+
+// int constants are inlined, the rest are read from the VM's constants
+static char* constant_value(ConstantPool* pool, int index) {
+  static char value[32];
+  Object* constant = pool->constants[index];
+  if (constant->type == INTEGER_OBJ)
+    sprintf(value, "VALUE_INT(%d)", constant->value.i);
+  else
+    sprintf(value, "constants[%d]", index);
+  return value;
+}
+
+static void emit_string(FILE* out, char* str) {
+  fputc('"', out);
+  for (unsigned char* c = (unsigned char*)str; *c; c++) {
+    if (*c == '"' || *c == '\\')
+      fprintf(out, "\\%c", *c);
+    else if (*c < ' ' || *c > '~')
+      fprintf(out, "\\%03o", *c);
+    else
+      fputc(*c, out);
+  }
+  fputc('"', out);
+}
+
+// the compiler is run directly rather than through a shell, so paths are
+// passed as they are, whatever characters they hold. $CC may name the
+// compiler with leading arguments, split on whitespace as make does
+AotErr aot_build(char* c_path, char* exe_path) {
+  char* cc = strdup(getenv("CC") ? getenv("CC") : "cc");
+  int num_sources = sizeof(runtime_sources) / sizeof(runtime_sources[0]);
+  char** argv = malloc(sizeof(char*) * (strlen(cc) + num_sources + 10));
+  int argc = 0;
+  for (char* word = strtok(cc, " \t"); word; word = strtok(NULL, " \t"))
+    argv[argc++] = word;
+  if (argc == 0)
+    argv[argc++] = "cc";
+  argv[argc++] = "-O2";
+  argv[argc++] = "-o";
+  argv[argc++] = exe_path;
+  argv[argc++] = c_path;
+  argv[argc++] = "-I" MONKEY_ROOT;
+  for (int i = 0; i < num_sources; i++) {
+    char* source = malloc(strlen(MONKEY_ROOT) + strlen(runtime_sources[i]) + 2);
+    sprintf(source, "%s/%s", MONKEY_ROOT, runtime_sources[i]);
+    argv[argc++] = source;
+  }
+  argv[argc++] = "-lm";
+  argv[argc] = NULL;
+
+  int status = -1;
+  pid_t pid = fork();
+  if (pid == 0) {
+    execvp(argv[0], argv);
+    _exit(127);
+  }
+  if (pid > 0)
+    waitpid(pid, &status, 0);
+  char* err = NULL;
+  if (pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    err = malloc(strlen(argv[0]) + 50);
+    sprintf(err, "%s failed with status %d", argv[0],
+      pid > 0 && WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+  }
+  for (int i = argc - num_sources - 1; i < argc - 1; i++) free(argv[i]);
+  free(argv);
+  free(cc);
+  return err;
+}
@@ -0,0 +1,22 @@
+#ifndef __AOT_H__
+#define __AOT_H__
+
+#include <stdio.h>
+#include "../compiler/compiler.h"
+
+typedef char* AotErr;
+
+/**
+ * Ahead-of-time compilation for `monkey build`: compiled bytecode is
+ * translated into a C program, one C function per Monkey function, which
+ * is then built into a native executable against the runtime in
+ * `aot_runtime.c`. The executable runs the program and prints its result
+ * just like `monkey run`, with no bytecode or dispatch loop left.
+ */
+AotErr aot_emit_c(FILE* out, Bytecode* bytecode);
+
+// builds the C program at `c_path` into the executable `exe_path`, with the
+// compiler named by $CC (`cc` by default)
+AotErr aot_build(char* c_path, char* exe_path);
+
+#endif  // __AOT_H__
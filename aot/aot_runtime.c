@@ -0,0 +1,138 @@
+#include "aot_runtime.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// native code is kept on functions as a data pointer
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+#define COLLECT_GARBAGE()                  \
+  do {                                     \
+    if (heap_needs_collection(&vm->heap))  \
+      collect_garbage(vm);                 \
+  } while (0)
+
+#define CHECK(expr)  \
+  do {               \
+    err = (expr);    \
+    if (err)         \
+      return err;    \
+  } while (0)
+
+// returned by a function whose frame a tail call replaced, for the
+// trampoline in `run_frame()` to run the callee in its place
+static char tail_call;
+#define TAIL_CALL (&tail_call)
+
+Object* aot_int(int i) {
+  Object* object = object_alloc(INTEGER_OBJ);
+  object->value.i = i;
+  return object;
+}
+
+Object* aot_string(char* str) {
+  Object* object = object_alloc(STRING_OBJ);
+  object->value.str = str;
+  return object;
+}
+
+// the bytecode isn't kept, so the function has no instructions to show
+Object* aot_function(NativeFn native, int num_locals, int num_params) {
+  CompiledFunction* fn = malloc(sizeof(CompiledFunction));
+  fn->instructions = calloc(1, sizeof(Instruct));
+  fn->num_locals = num_locals;
+  fn->num_params = num_params;
+  fn->closure = NULL;
+  fn->native = native;
+  Object* object = object_alloc(COMPILED_FUNCTION_OBJ);
+  object->value.compiled_fn = fn;
+  return object;
+}
+
+// runs the frame on top to completion, along with the frames of the
+// closures it tail calls, so tail recursion runs in constant C stack
+static VmErr run_frame(Vm vm) {
+  VmErr err;
+  do {
+    NativeFn native = (NativeFn)current_frame(vm)->cl->fn->native;
+    err = native(vm);
+  } while (err == TAIL_CALL);
+  return err;
+}
+
+int aot_main(int num_constants, Object** constants, NativeFn main_fn) {
+  ConstantPool pool = {.length = num_constants, .constants = constants};
+  Bytecode bytecode = {.instructions = calloc(1, sizeof(Instruct)),
+    .constants = &pool};
+  Vm vm = vm_new(&bytecode);
+  current_frame(vm)->cl->fn->native = main_fn;
+  heap_activate(&vm->heap);
+  VmErr err = run_frame(vm);
+  heap_activate(NULL);
+  if (err) {
+    printf("vm error: %s\n", err);
+    return EXIT_FAILURE;
+  }
+  printf("%s\n", object_inspect(*vm_last_popped(vm)));
+  return EXIT_SUCCESS;
+}
+
+VmErr aot_binary_operation(Vm vm, OpCode op) {
+  VmErr err;
+  CHECK(exec_binary_operation(vm, op));
+  COLLECT_GARBAGE();
+  return NULL;
+}
+
+VmErr aot_array(Vm vm, int num_elements) {
+  VmErr err;
+  Object* array = build_array(vm, vm->sp - num_elements, vm->sp);
+  vm->sp -= num_elements;
+  CHECK(push(vm, VALUE_OBJ(array)));
+  COLLECT_GARBAGE();
+  return NULL;
+}
+
+VmErr aot_hash(Vm vm, int num_elements) {
+  VmErr err;
+  CHECK(build_hash(vm, vm->sp - num_elements, vm->sp));
+  COLLECT_GARBAGE();
+  return NULL;
+}
+
+VmErr aot_index(Vm vm) {
+  Value index = pop(vm);
+  Value left = pop(vm);
+  return exec_index_expr(vm, left, index);
+}
+
+VmErr aot_get_builtin(Vm vm, int builtin_index) {
+  VmErr err;
+  CHECK(push(vm, VALUE_OBJ(get_builtin_by_index(builtin_index))));
+  COLLECT_GARBAGE();
+  return NULL;
+}
+
+VmErr aot_closure(Vm vm, int const_index, int num_free) {
+  VmErr err;
+  CHECK(push_closure(vm, const_index, num_free));
+  COLLECT_GARBAGE();
+  return NULL;
+}
+
+VmErr aot_call(Vm vm, int num_args) {
+  VmErr err;
+  int frames_index = vm->frames_index;
+  CHECK(execute_call(vm, num_args));
+  if (vm->frames_index > frames_index)
+    CHECK(run_frame(vm));
+  COLLECT_GARBAGE();
+  return NULL;
+}
+
+VmErr aot_tail_call(Vm vm, int num_args) {
+  VmErr err;
+  Value callee = vm->stack[vm->sp - 1 - num_args];
+  CHECK(execute_tail_call(vm, num_args));
+  COLLECT_GARBAGE();
+  return VALUE_HAS_TYPE(callee, CLOSURE_OBJ) ? TAIL_CALL : NULL;
+}
@@ -0,0 +1,125 @@
+#ifndef __AOT_RUNTIME_H__
+#define __AOT_RUNTIME_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "../vm/vm_internal.h"
+
+/**
+ * The runtime linked into executables built by `monkey build`. Each
+ * compiled function becomes a C function working on the VM's own stack
+ * and frames through the macros below, so anything they don't inline
+ * (strings, collections, calls, errors) is handled by the VM's runtime
+ * helpers, exactly as when interpreted.
+ *
+ * A function's stack pointer is kept in the local `sp`, and written back
+ * to `vm->sp` around every call into the runtime.
+ */
+
+typedef VmErr (*NativeFn)(Vm vm);
+
+Object* aot_int(int i);
+Object* aot_string(char* str);
+Object* aot_function(NativeFn native, int num_locals, int num_params);
+
+// runs the program and prints its result like `monkey run`, returning the
+// process exit status
+int aot_main(int num_constants, Object** constants, NativeFn main_fn);
+
+VmErr aot_binary_operation(Vm vm, OpCode op);
+VmErr aot_array(Vm vm, int num_elements);
+VmErr aot_hash(Vm vm, int num_elements);
+VmErr aot_index(Vm vm);
+VmErr aot_get_builtin(Vm vm, int builtin_index);
+VmErr aot_closure(Vm vm, int const_index, int num_free);
+VmErr aot_call(Vm vm, int num_args);
+VmErr aot_tail_call(Vm vm, int num_args);
+
+#define AOT_ENTER(max_depth)                          \
+  Frame* frame = current_frame(vm);                   \
+  Closure* cl = frame->cl;                            \
+  Value* locals = &vm->stack[frame->base_pointer];    \
+  Value* constants = vm->constants;                   \
+  Value* sp = &vm->stack[vm->sp];                     \
+  VmErr err;                                          \
+  (void)cl, (void)locals, (void)constants, (void)err; \
+  if (vm->sp + (max_depth) > STACK_SIZE)              \
+    return "stack overflow";
+
+#define AOT_RUNTIME(expr)    \
+  do {                       \
+    vm->sp = sp - vm->stack; \
+    err = (expr);            \
+    if (err)                 \
+      return err;            \
+    sp = &vm->stack[vm->sp]; \
+  } while (0)
+
+#define AOT_PUSH(value) (*sp++ = (value))
+
+#define AOT_BOTH_INTS(left, right) VALUE_IS_INT((left) & (right))
+
+// a division by zero is reported by the runtime, like a type error
+#define AOT_ARITHMETIC(op, operator)                                       \
+  do {                                                                     \
+    Value left = sp[-2], right = sp[-1];                                   \
+    if (AOT_BOTH_INTS(left, right) &&                                      \
+        ((op) != OP_DIV || right != VALUE_INT(0))) {                       \
+      sp[-2] = VALUE_INT(VALUE_AS_INT(left) operator VALUE_AS_INT(right)); \
+      sp--;                                                                \
+    } else {                                                               \
+      AOT_RUNTIME(aot_binary_operation(vm, op));                           \
+    }                                                                      \
+  } while (0)
+
+#define AOT_COMPARISON(op, operator)                                        \
+  do {                                                                      \
+    Value left = sp[-2], right = sp[-1];                                    \
+    if (AOT_BOTH_INTS(left, right)) {                                       \
+      sp[-2] = VALUE_BOOL(VALUE_AS_INT(left) operator VALUE_AS_INT(right)); \
+      sp--;                                                                 \
+    } else {                                                                \
+      AOT_RUNTIME(exec_comparison(vm, op));                                 \
+    }                                                                       \
+  } while (0)
+
+// a comparison followed by OP_JUMP_NOT_TRUTHY
+#define AOT_COMPARE_AND_JUMP(op, operator, label)               \
+  do {                                                          \
+    Value left = sp[-2], right = sp[-1];                        \
+    bool result;                                                \
+    if (AOT_BOTH_INTS(left, right)) {                           \
+      sp -= 2;                                                  \
+      result = VALUE_AS_INT(left) operator VALUE_AS_INT(right); \
+    } else {                                                    \
+      AOT_RUNTIME(exec_comparison(vm, op));                     \
+      result = *--sp == VALUE_TRUE;                             \
+    }                                                           \
+    if (!result)                                                \
+      goto label;                                               \
+  } while (0)
+
+#define AOT_JUMP_NOT_TRUTHY(label)   \
+  do {                               \
+    Value condition = *--sp;         \
+    if (!VALUE_IS_TRUTHY(condition)) \
+      goto label;                    \
+  } while (0)
+
+#define AOT_SET_GLOBAL(index)        \
+  do {                               \
+    vm->globals[index] = *--sp;      \
+    if ((index) >= vm->num_globals)  \
+      vm->num_globals = (index) + 1; \
+  } while (0)
+
+// pops the frame, leaving `value` in the callee's slot
+#define AOT_RETURN(value)        \
+  do {                           \
+    locals[-1] = (value);        \
+    vm->sp = locals - vm->stack; \
+    vm->frames_index--;          \
+    return NULL;                 \
+  } while (0)
+
+#endif  // __AOT_RUNTIME_H__
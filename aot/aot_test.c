@@ -0,0 +1,145 @@
+#include "aot.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../compiler/optimizer.h"
+#include "../test/compile.h"
+#include "../test/test.h"
+
+typedef struct AotTest {
+  char* input;
+  char* expected_output;
+} AotTest;
+
+// `monkey build` translates optimized bytecode
+static Bytecode* optimized_source(char* source, const char* t) {
+  Bytecode* bytecode = compile_source(source, t);
+  optimize_bytecode(bytecode);
+  return bytecode;
+}
+
+static char* emit_source(char* source, const char* t) {
+  char* c_source;
+  size_t size;
+  FILE* out = open_memstream(&c_source, &size);
+  AotErr err = aot_emit_c(out, optimized_source(source, t));
+  fclose(out);
+  if (err)
+    fail(ss("aot error: %s", err), t);
+  return c_source;
+}
+
+// builds the program and returns everything the executable printed
+static char* build_and_run(char* source, const char* t) {
+  char c_path[] = "/tmp/monkey_aot_XXXXXX.c";
+  int fd = mkstemps(c_path, 2);
+  if (fd == -1)
+    fail("can't create a temporary file", t);
+  FILE* out = fdopen(fd, "w");
+  AotErr err = aot_emit_c(out, optimized_source(source, t));
+  fclose(out);
+
+  char exe_path[sizeof(c_path)];
+  strcpy(exe_path, c_path);
+  exe_path[strlen(exe_path) - 2] = '\0';
+  if (!err)
+    err = aot_build(c_path, exe_path);
+  remove(c_path);
+  if (err) {
+    fail(ss("aot error: %s", err), t);
+    return "";
+  }
+
+  FILE* exe = popen(exe_path, "r");
+  char* output = calloc(1000, 1);
+  fread(output, 1, 999, exe);
+  pclose(exe);
+  remove(exe_path);
+  return output;
+}
+
+void test_emit_c(void) {
+  char* t = "emit_c";
+  char* c_source = emit_source(
+    "let f = fn(x) { if (x > 1) { f(x - 1) } else { \"a\\b\" } }; f(3)",
+    t);
+  char* expected[] = {
+    "static VmErr fn_2(Vm vm) {\n  AOT_ENTER(3);\n",
+    "AOT_COMPARE_AND_JUMP(OP_GREATER_THAN, >, L",
+    "AOT_ARITHMETIC(OP_SUB, -);\n  AOT_RUNTIME(aot_tail_call(vm, 1));\n",
+    "AOT_PUSH(constants[1]);\n",
+    "aot_string(\"a\\\\b\"),\n",
+    "aot_function(fn_2, 1, 1),\n",
+    "return aot_main(4, constants, fn_main);\n",
+  };
+  for (int i = 0; i < LEN(expected); i++)
+    assert(strstr(c_source, expected[i]) != NULL,
+      ss("emits `%s`", expected[i]), t);
+}
+
+void test_build(void) {
+  AotTest tests[] = {
+    {
+      .input = "let fib = fn(n) { if (n < 2) { n } else { fib(n - 1) + "
+               "fib(n - 2) } }; fib(15)",
+      .expected_output = "610\n",
+    },
+    {
+      .input = "let add = fn(x) { fn(y) { x + y } };"
+               "let loop = fn(n, acc) { if (n == 0) { acc } "
+               "else { loop(n - 1, acc + n) } };"
+               "[add(1)(2), loop(10000, 0), {\"a\": \"b\" + \"c\"}[\"a\"], "
+               "-len(rest([1, 2])), !true, 1 != 2]",
+      .expected_output = "[3, 50005000, bc, -1, false, true]\n",
+    },
+    {
+      .input = "puts(\"hi\"); let f = fn() { 1 + \"a\" }; f()",
+      .expected_output =
+        "hi\nvm error: unsupported types for binary operation: "
+        "INTEGER STRING\n",
+    },
+    {
+      .input = "let f = fn(x) { 10 / x }; f(5) + f(0)",
+      .expected_output = "vm error: division by zero\n",
+    },
+  };
+  for (int i = 0; i < LEN(tests); i++) {
+    char* output = build_and_run(tests[i].input, __func__);
+    assert_str_is(tests[i].expected_output, output,
+      ss("input=`%s`", tests[i].input), __func__);
+  }
+}
+
+// the compiler isn't run through a shell, so paths are taken literally
+void test_build_unusual_path(void) {
+  char* t = "build_unusual_path";
+  char dir[] = "/tmp/monkey aot $(false); 'x' XXXXXX";
+  if (mkdtemp(dir) == NULL) {
+    fail("can't create a temporary directory", t);
+    return;
+  }
+  char* c_path = malloc(strlen(dir) + 10);
+  char* exe_path = malloc(strlen(dir) + 10);
+  sprintf(c_path, "%s/prog.c", dir);
+  sprintf(exe_path, "%s/prog", dir);
+  FILE* out = fopen(c_path, "w");
+  AotErr err = aot_emit_c(out, optimized_source("1 + 2", t));
+  fclose(out);
+  if (!err)
+    err = aot_build(c_path, exe_path);
+  assert(err == NULL, ss("built without error: %s", err ? err : ""), t);
+  assert(access(exe_path, X_OK) == 0, "executable built", t);
+  remove(c_path);
+  remove(exe_path);
+  rmdir(dir);
+}
+
+int main(int argc, char** argv) {
+  pass_argv(argc, argv);
+  test_emit_c();
+  test_build();
+  test_build_unusual_path();
+  printf("\n");
+  return 0;
+}
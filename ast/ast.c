@@ -47,6 +47,10 @@ ExpressionStatement *get_expression(Statement *statement) {
   return (ExpressionStatement *)statement->node;
 }
 
+void program_free(Program *program) {
+  arena_free(program->arena);
+}
+
 #define MAX_STMT_STR_LEN 100
 
 char *program_string(Program *program) {
@@ -128,9 +128,12 @@ typedef struct CallExpression {
 typedef struct Program {
   char *token_literal;
   List *statements;
+  Arena *arena;  // the tokens and nodes of the whole tree
 } Program;
 
 NodeType ast_statement_node_type(Statement *statement);
+// frees the whole tree at once, once nothing (e.g. the interpreter) needs it
+void program_free(Program *program);
 char *program_string(Program *program);
 char *statement_string(Statement *statement);
 char *let_statement_string(LetStatement *let_statement);
@@ -15,7 +15,7 @@ void test_string(void) {
   LetStatement letStatement = {&myVarLetToken, &letNameIdent, &letValueExpr};
   Statement statement = {myVarLetToken.literal, STATEMENT_LET, &letStatement};
   List statements = {&statement, NULL};
-  Program program = {myVarLetToken.literal, &statements};
+  Program program = {myVarLetToken.literal, &statements, NULL};
   assert_str_is(program_string(&program), "let myVar = anotherVar;\n",
     "hand-constructed AST has correct string representation", "test_string");
 }
@@ -1,5 +1,6 @@
 #include "code.h"
 #include <stdarg.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -39,8 +40,12 @@ Instruct* code_make(int op_int, ...) {
     int width = def->operand_widths[i];
     int operand = va_arg(ap, int);
     switch (width) {
+      case 4:
+        bytes[byte_pos++] = operand >> 24;
+        bytes[byte_pos++] = (operand >> 16) & 0xff;
+        // fallthrough
       case 2:
-        bytes[byte_pos++] = operand >> 8;
+        bytes[byte_pos++] = (operand >> 8) & 0xff;
         bytes[byte_pos++] = operand & 0xff;
         break;
       case 1:
@@ -136,6 +141,10 @@ UInt16 read_uint16(Byte* byte) {
   return (first << 8) + second;
 }
 
+UInt32 read_uint32(Byte* byte) {
+  return ((UInt32)read_uint16(byte) << 16) + read_uint16(byte + 2);
+}
+
 ReadOpResult code_read_operands(Definition def, Instruct instructions) {
   IntBag operands;
   operands.len = def.num_operands;
@@ -144,6 +153,9 @@ ReadOpResult code_read_operands(Definition def, Instruct instructions) {
   for (int i = 0; i < def.num_operands; i++) {
     int width = def.operand_widths[i];
     switch (width) {
+      case 4:
+        operands.arr[i] = (int)read_uint32(&instructions.bytes[bytes_read + 1]);
+        break;
       case 2:
         operands.arr[i] = (int)read_uint16(&instructions.bytes[bytes_read + 1]);
         break;
@@ -282,12 +294,12 @@ Definition* code_opcode_lookup(OpCode op) {
       def->name = "OpCurrentClosure";
       break;
     case OP_JUMP:
-      def->operand_widths[0] = 2;
+      def->operand_widths[0] = 4;
       def->num_operands = 1;
       def->name = "OpJump";
       break;
     case OP_JUMP_NOT_TRUTHY:
-      def->operand_widths[0] = 2;
+      def->operand_widths[0] = 4;
       def->num_operands = 1;
       def->name = "OpJumpNotTruthy";
       break;
@@ -296,6 +308,65 @@ Definition* code_opcode_lookup(OpCode op) {
       def->num_operands = 1;
       def->name = "OpGetFree";
       break;
+    case OP_TAIL_CALL:
+      def->operand_widths[0] = 1;
+      def->num_operands = 1;
+      def->name = "OpTailCall";
+      break;
+    case OP_ADD_INT:
+      def->name = "OpAddInt";
+      break;
+    case OP_SUB_INT:
+      def->name = "OpSubInt";
+      break;
+    case OP_MUL_INT:
+      def->name = "OpMulInt";
+      break;
+    case OP_DIV_INT:
+      def->name = "OpDivInt";
+      break;
+    case OP_EQUAL_INT:
+      def->name = "OpEqualInt";
+      break;
+    case OP_NOT_EQUAL_INT:
+      def->name = "OpNotEqualInt";
+      break;
+    case OP_GREATER_THAN_INT:
+      def->name = "OpGreaterThanInt";
+      break;
+    case OP_GET_LOCAL_CONSTANT:
+      def->operand_widths[0] = 1;
+      def->operand_widths[1] = 2;
+      def->num_operands = 2;
+      def->name = "OpGetLocalConstant";
+      break;
+    case OP_ADD_LOCAL_CONSTANT:
+      def->operand_widths[0] = 1;
+      def->operand_widths[1] = 2;
+      def->num_operands = 2;
+      def->name = "OpAddLocalConstant";
+      break;
+    case OP_SUB_LOCAL_CONSTANT:
+      def->operand_widths[0] = 1;
+      def->operand_widths[1] = 2;
+      def->num_operands = 2;
+      def->name = "OpSubLocalConstant";
+      break;
+    case OP_JUMP_IF_NOT_EQUAL:
+      def->operand_widths[0] = 4;
+      def->num_operands = 1;
+      def->name = "OpJumpIfNotEqual";
+      break;
+    case OP_JUMP_IF_EQUAL:
+      def->operand_widths[0] = 4;
+      def->num_operands = 1;
+      def->name = "OpJumpIfEqual";
+      break;
+    case OP_JUMP_IF_NOT_GREATER:
+      def->operand_widths[0] = 4;
+      def->num_operands = 1;
+      def->name = "OpJumpIfNotGreater";
+      break;
     default:
       free(def);
       return NULL;
@@ -303,6 +374,95 @@ Definition* code_opcode_lookup(OpCode op) {
   return def;
 }
 
+int code_instruction_width(OpCode op) {
+  Definition* def = code_opcode_lookup(op);
+  int width = 1;
+  for (int i = 0; i < def->num_operands; i++)
+    width += def->operand_widths[i];
+  free(def);
+  return width;
+}
+
+int code_max_stack_depth(Instruct* ins) {
+  int* depths = malloc((ins->length + 1) * sizeof(int));
+  for (int i = 0; i <= ins->length; i++)
+    depths[i] = -1;
+  int depth = 0, max = 0;
+  bool reachable = true;  // jumps only go forwards
+  for (int ip = 0; ip < ins->length;) {
+    Byte* bytes = &ins->bytes[ip];
+    if (!reachable && depths[ip] >= 0)
+      depth = depths[ip];
+    reachable = true;
+    int target = -1;
+    switch (bytes[0]) {
+      case OP_CONSTANT:
+      case OP_TRUE:
+      case OP_FALSE:
+      case OP_NULL:
+      case OP_GET_GLOBAL:
+      case OP_GET_LOCAL:
+      case OP_GET_BUILTIN:
+      case OP_CURRENT_CLOSURE:
+      case OP_GET_FREE:
+        depth++;
+        break;
+      case OP_GET_LOCAL_CONSTANT:
+        depth += 2;
+        break;
+      case OP_ADD_LOCAL_CONSTANT:
+      case OP_SUB_LOCAL_CONSTANT:
+        // native code pushes both operands for the generic fallback
+        if (depth + 2 > max)
+          max = depth + 2;
+        depth++;
+        break;
+      case OP_ARRAY:
+      case OP_HASH:
+        depth += 1 - read_uint16(&bytes[1]);
+        break;
+      case OP_CLOSURE:
+        depth += 1 - bytes[3];
+        break;
+      case OP_CALL:
+      case OP_TAIL_CALL:
+        depth -= bytes[1];
+        break;
+      case OP_JUMP:
+        target = read_uint32(&bytes[1]);
+        reachable = false;
+        break;
+      case OP_JUMP_NOT_TRUTHY:
+        depth--;
+        target = read_uint32(&bytes[1]);
+        break;
+      case OP_JUMP_IF_NOT_EQUAL:
+      case OP_JUMP_IF_EQUAL:
+      case OP_JUMP_IF_NOT_GREATER:
+        depth -= 2;
+        target = read_uint32(&bytes[1]);
+        break;
+      case OP_RETURN:
+      case OP_RETURN_VALUE:
+        reachable = false;
+        break;
+      case OP_MINUS:
+      case OP_BANG:
+        break;
+      default:  // binary operations, comparisons, pops, sets and index
+        depth--;
+        break;
+    }
+    if (target >= 0 && target <= ins->length && depth > depths[target])
+      depths[target] = depth;
+    if (depth > max)
+      max = depth;
+    ip += code_instruction_width(bytes[0]);
+  }
+  free(depths);
+  return max;
+}
+
 IntBag int_bag(int len, ...) {
   va_list ap;
   va_start(ap, len);
@@ -3,6 +3,7 @@
 
 typedef unsigned char UInt8;
 typedef unsigned short UInt16;
+typedef unsigned int UInt32;
 typedef unsigned char Byte;
 typedef unsigned char OpCode;
 
@@ -37,10 +38,32 @@ enum OpCodes {
   OP_CLOSURE,
   OP_CURRENT_CLOSURE,
   OP_GET_FREE,
+  // an OP_CALL whose result is returned right away, so the callee can take
+  // over the caller's frame
+  OP_TAIL_CALL,
+  // int-specialized forms of the arithmetic and comparison opcodes, only
+  // ever written by the VM over a generic opcode it has seen take two ints
+  OP_ADD_INT,
+  OP_SUB_INT,
+  OP_MUL_INT,
+  OP_DIV_INT,
+  OP_EQUAL_INT,
+  OP_NOT_EQUAL_INT,
+  OP_GREATER_THAN_INT,
+  // superinstructions, fused by the compiler from the most frequent opcode
+  // pairs: OP_GET_LOCAL + OP_CONSTANT, that + OP_ADD or OP_SUB, and each
+  // comparison + OP_JUMP_NOT_TRUTHY
+  OP_GET_LOCAL_CONSTANT,
+  OP_ADD_LOCAL_CONSTANT,
+  OP_SUB_LOCAL_CONSTANT,
+  OP_JUMP_IF_NOT_EQUAL,
+  OP_JUMP_IF_EQUAL,
+  OP_JUMP_IF_NOT_GREATER,
+  NUM_OPCODES,
 };
 
 typedef struct Instruct {
-  UInt8 length;
+  int length;
   Byte* bytes;
 } Instruct;
 
@@ -75,7 +98,17 @@ Instruct* code_make_nv(int, IntBag);
 Instruct* code_concat_ins(int, ...);
 ReadOpResult code_read_operands(Definition, Instruct);
 char* instructions_str(Instruct instructions);
+
+// the opcode plus its operands, in bytes
+int code_instruction_width(OpCode op);
+
+/**
+ * The furthest a function's instructions grow the stack past its locals,
+ * so native code can check for room once on entry instead of on every push.
+ */
+int code_max_stack_depth(Instruct* instructions);
 UInt16 read_uint16(Byte* byte);
+UInt32 read_uint32(Byte* byte);
 
 IntBag int_bag(int len, ...);
 IntBag i(int i1);
@@ -38,6 +38,12 @@ void test_make(void) {
       .expected = (Byte[]){OP_CLOSURE, 255, 254, 255},
       .expected_len = 4,
     },
+    {
+      .op = OP_JUMP,
+      .operands = i(16909060),
+      .expected = (Byte[]){OP_JUMP, 1, 2, 3, 4},
+      .expected_len = 5,
+    },
   };
 
   for (int i = 0; i < LEN(tests); i++) {
@@ -69,6 +75,11 @@ void test_read_operands(void) {
       .operands = i(255),
       .bytes_read = 1,
     },
+    {
+      .op = OP_JUMP_NOT_TRUTHY,
+      .operands = i(70000),
+      .bytes_read = 4,
+    },
   };
 
   for (int i = 0; i < LEN(tests); i++) {
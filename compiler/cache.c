@@ -0,0 +1,286 @@
+#include "cache.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CACHE_MAGIC "MKYC"
+
+typedef struct Header {
+  char magic[4];
+  uint32_t version;
+  uint64_t source_hash;
+  uint32_t source_length;
+  uint32_t num_constants;
+  uint64_t payload_hash;  // of everything after the header
+} Header;
+
+// bounds-checked reads from the mapped file
+typedef struct Cursor {
+  Byte* pos;
+  Byte* end;
+} Cursor;
+
+// hashes the payload as it's written, for the header written last
+typedef struct Writer {
+  FILE* file;
+  uint64_t hash;
+} Writer;
+
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+
+static uint64_t fnv1a(uint64_t hash, const Byte* bytes, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static Header make_header(char* source, int num_constants) {
+  Header header = {
+    .version = BYTECODE_CACHE_VERSION,
+    .source_hash = fnv1a(FNV_OFFSET_BASIS, (Byte*)source, strlen(source)),
+    .source_length = strlen(source),
+    .num_constants = num_constants,
+  };
+  memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+  return header;
+}
+
+static void write_bytes(Writer* writer, const void* bytes, size_t length) {
+  writer->hash = fnv1a(writer->hash, bytes, length);
+  fwrite(bytes, 1, length, writer->file);
+}
+
+static void write_u32(Writer* writer, uint32_t n) {
+  write_bytes(writer, &n, sizeof(n));
+}
+
+static void write_instructions(Writer* writer, Instruct* instructions) {
+  write_u32(writer, instructions->length);
+  write_bytes(writer, instructions->bytes, instructions->length);
+}
+
+static bool write_constant(Writer* writer, Object* constant) {
+  Byte type = constant->type;
+  write_bytes(writer, &type, 1);
+  switch (constant->type) {
+    case INTEGER_OBJ:
+      write_u32(writer, constant->value.i);
+      return true;
+    case STRING_OBJ: {
+      uint32_t length = strlen(constant->value.str);
+      write_u32(writer, length);
+      write_bytes(writer, constant->value.str, length + 1);
+      return true;
+    }
+    case COMPILED_FUNCTION_OBJ: {
+      CompiledFunction* fn = constant->value.compiled_fn;
+      write_u32(writer, fn->num_locals);
+      write_u32(writer, fn->num_params);
+      write_instructions(writer, fn->instructions);
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+bool bytecode_cache_write(char* path, Bytecode* bytecode, char* source) {
+  // write then rename, so a concurrent run never maps a partial file
+  char tmp_path[strlen(path) + 5];
+  sprintf(tmp_path, "%s.tmp", path);
+  FILE* file = fopen(tmp_path, "wb");
+  if (file == NULL)
+    return false;
+
+  ConstantPool* pool = bytecode->constants;
+  Header header = make_header(source, pool->length);
+  fseek(file, sizeof(header), SEEK_SET);
+  Writer writer = {.file = file, .hash = FNV_OFFSET_BASIS};
+  write_instructions(&writer, bytecode->instructions);
+  bool ok = true;
+  for (int i = 0; ok && i < pool->length; i++)
+    ok = write_constant(&writer, pool->constants[i]);
+
+  header.payload_hash = writer.hash;
+  rewind(file);
+  fwrite(&header, sizeof(header), 1, file);
+  ok = !ferror(file) && fclose(file) == 0 && ok;
+  if (ok)
+    ok = rename(tmp_path, path) == 0;
+  if (!ok)
+    remove(tmp_path);
+  return ok;
+}
+
+static Byte* read_bytes(Cursor* cursor, uint32_t length) {
+  if ((uint64_t)(cursor->end - cursor->pos) < length)
+    return NULL;
+  Byte* bytes = cursor->pos;
+  cursor->pos += length;
+  return bytes;
+}
+
+static bool read_u32(Cursor* cursor, uint32_t* n) {
+  Byte* bytes = read_bytes(cursor, sizeof(*n));
+  if (bytes != NULL)
+    memcpy(n, bytes, sizeof(*n));
+  return bytes != NULL;
+}
+
+static Instruct* read_instructions(Cursor* cursor) {
+  uint32_t length;
+  if (!read_u32(cursor, &length))
+    return NULL;
+  Byte* bytes = read_bytes(cursor, length);
+  if (bytes == NULL)
+    return NULL;
+  Instruct* instructions = malloc(sizeof(Instruct));
+  instructions->length = length;
+  instructions->bytes = bytes;
+  return instructions;
+}
+
+static Object* read_constant(Cursor* cursor) {
+  Byte* type = read_bytes(cursor, 1);
+  if (type == NULL)
+    return NULL;
+  uint32_t n;
+  switch (*type) {
+    case INTEGER_OBJ: {
+      if (!read_u32(cursor, &n))
+        return NULL;
+      Object* constant = object_alloc(INTEGER_OBJ);
+      constant->value.i = (int)n;
+      return constant;
+    }
+    case STRING_OBJ: {
+      if (!read_u32(cursor, &n) || n == UINT32_MAX)
+        return NULL;
+      Byte* str = read_bytes(cursor, n + 1);
+      if (str == NULL || str[n] != '\0')
+        return NULL;
+      Object* constant = object_alloc(STRING_OBJ);
+      constant->value.str = (char*)str;
+      return constant;
+    }
+    case COMPILED_FUNCTION_OBJ: {
+      uint32_t num_locals, num_params;
+      if (!read_u32(cursor, &num_locals) || !read_u32(cursor, &num_params))
+        return NULL;
+      Instruct* instructions = read_instructions(cursor);
+      if (instructions == NULL)
+        return NULL;
+      CompiledFunction* fn = malloc(sizeof(CompiledFunction));
+      fn->instructions = instructions;
+      fn->num_locals = num_locals;
+      fn->num_params = num_params;
+      fn->closure = NULL;
+      fn->native = NULL;
+      Object* constant = object_alloc(COMPILED_FUNCTION_OBJ);
+      constant->value.compiled_fn = fn;
+      return constant;
+    }
+    default:
+      return NULL;
+  }
+}
+
+// constants read from the file point into the mapping, so only their
+// headers (and a function's Instruct) were allocated
+static void free_constant(Object* constant) {
+  if (constant->type == COMPILED_FUNCTION_OBJ) {
+    free(constant->value.compiled_fn->instructions);
+    free(constant->value.compiled_fn);
+  }
+  free(constant);
+}
+
+static void free_read(Instruct* instructions, ConstantPool* pool) {
+  for (int i = 0; i < pool->length; i++)
+    free_constant(pool->constants[i]);
+  free(pool->constants);
+  free(pool->index);
+  free(pool);
+  free(instructions);
+}
+
+static Bytecode* read_bytecode(Cursor* cursor, char* source) {
+  Header* header = (Header*)read_bytes(cursor, sizeof(Header));
+  Header expected = make_header(source, 0);
+  if (header == NULL || memcmp(header->magic, CACHE_MAGIC, 4) != 0 ||
+      header->version != expected.version ||
+      header->source_length != expected.source_length ||
+      header->source_hash != expected.source_hash ||
+      header->num_constants > MAX_CONSTANTS)
+    return NULL;
+  // the body isn't validated opcode by opcode, so a corrupt one must never
+  // get as far as the VM
+  if (fnv1a(FNV_OFFSET_BASIS, cursor->pos, cursor->end - cursor->pos) !=
+      header->payload_hash)
+    return NULL;
+
+  Instruct* instructions = read_instructions(cursor);
+  if (instructions == NULL)
+    return NULL;
+  ConstantPool* pool = constant_pool_new();
+  for (uint32_t i = 0; i < header->num_constants; i++) {
+    Object* constant = read_constant(cursor);
+    if (constant == NULL) {
+      free_read(instructions, pool);
+      return NULL;
+    }
+    if (pool->length == pool->capacity) {
+      pool->capacity *= 2;
+      pool->constants =
+        realloc(pool->constants, sizeof(Object*) * pool->capacity);
+    }
+    pool->constants[pool->length++] = constant;
+  }
+  if (cursor->pos != cursor->end) {
+    free_read(instructions, pool);
+    return NULL;
+  }
+
+  Bytecode* bytecode = malloc(sizeof(Bytecode));
+  bytecode->instructions = instructions;
+  bytecode->constants = pool;
+  return bytecode;
+}
+
+Bytecode* bytecode_cache_read(char* path, char* source) {
+  int fd = open(path, O_RDONLY);
+  if (fd == -1)
+    return NULL;
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(Header)) {
+    close(fd);
+    return NULL;
+  }
+  // writable but private: the VM quickens opcodes in place, and those
+  // rewrites must never reach the file
+  Byte* mapped =
+    mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED)
+    return NULL;
+
+  // the mapping stays alive as long as the bytecode, which points into it
+  Cursor cursor = {.pos = mapped, .end = mapped + st.st_size};
+  Bytecode* bytecode = read_bytecode(&cursor, source);
+  if (bytecode == NULL)
+    munmap(mapped, st.st_size);
+  return bytecode;
+}
+
+char* bytecode_cache_path(char* source_path) {
+  char* path = malloc(strlen(source_path) + 2);
+  sprintf(path, "%sc", source_path);
+  return path;
+}
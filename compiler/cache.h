@@ -0,0 +1,32 @@
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include <stdbool.h>
+#include "compiler.h"
+
+// bump whenever opcodes, operand widths or the file layout change
+#define BYTECODE_CACHE_VERSION 4
+
+/**
+ * `.mkyc` files hold compiled bytecode for a `.mky` source file, so later
+ * runs of an unchanged file can skip lexing, parsing and compiling. The
+ * file starts with a header identifying the format version, a hash of the
+ * source it was compiled from and a checksum of the rest of the file,
+ * followed by the top-level instructions and the constant pool (compiled
+ * functions included, since the compiler keeps every function body as a
+ * constant).
+ */
+bool bytecode_cache_write(char* path, Bytecode* bytecode, char* source);
+
+/**
+ * Maps the cache file at `path` into memory and returns its bytecode, whose
+ * instructions and strings point straight into the (copy-on-write) mapping.
+ * Returns NULL if the file is missing, corrupt, from another version, or was
+ * compiled from something other than `source`.
+ */
+Bytecode* bytecode_cache_read(char* path, char* source);
+
+// `foo.mky` -> `foo.mkyc`
+char* bytecode_cache_path(char* source_path);
+
+#endif  // __CACHE_H__
@@ -0,0 +1,117 @@
+#include "cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../test/compile.h"
+#include "../test/test.h"
+
+static void assert_instructions_equal(
+  Instruct* expected, Instruct* actual, const char* t) {
+  assert_int_is(expected->length, actual->length, "instructions length", t);
+  assert(memcmp(expected->bytes, actual->bytes, expected->length) == 0,
+    "instruction bytes equal", t);
+}
+
+static char* temp_cache_path(void) {
+  char* path = malloc(32);
+  sprintf(path, "/tmp/monkey_test_%d.mkyc", getpid());
+  return path;
+}
+
+void test_cache_round_trip(void) {
+  char* t = "cache_round_trip";
+  char* source =
+    "let greet = fn(name) { \"hello \" + name };"
+    "let add = fn(a, b) { let sum = a + b; sum };"
+    "greet(\"monkey\"); add(-3, 1000000);";
+  Bytecode* expected = compile_source(source, t);
+  char* path = temp_cache_path();
+  assert(bytecode_cache_write(path, expected, source), "wrote cache", t);
+
+  Bytecode* actual = bytecode_cache_read(path, source);
+  assert(actual != NULL, "read cache", t);
+  assert_instructions_equal(expected->instructions, actual->instructions, t);
+  assert_int_is(expected->constants->length, actual->constants->length,
+    "constants length", t);
+  for (int i = 0; i < expected->constants->length; i++) {
+    Object* want = expected->constants->constants[i];
+    Object* got = actual->constants->constants[i];
+    assert_int_is(want->type, got->type, "constant type", t);
+    switch (want->type) {
+      case INTEGER_OBJ:
+        assert_int_is(want->value.i, got->value.i, "int constant", t);
+        break;
+      case STRING_OBJ:
+        assert_str_is(want->value.str, got->value.str, "str constant", t);
+        break;
+      case COMPILED_FUNCTION_OBJ: {
+        CompiledFunction* want_fn = want->value.compiled_fn;
+        CompiledFunction* got_fn = got->value.compiled_fn;
+        assert_int_is(want_fn->num_locals, got_fn->num_locals, "locals", t);
+        assert_int_is(want_fn->num_params, got_fn->num_params, "params", t);
+        assert_instructions_equal(
+          want_fn->instructions, got_fn->instructions, t);
+      } break;
+    }
+  }
+  remove(path);
+}
+
+void test_cache_invalidation(void) {
+  char* t = "cache_invalidation";
+  char* source = "let x = 5; x * 2;";
+  char* path = temp_cache_path();
+  assert(bytecode_cache_read(path, source) == NULL, "missing file", t);
+
+  bytecode_cache_write(path, compile_source(source, t), source);
+  assert(bytecode_cache_read(path, "let x = 6; x * 2;") == NULL,
+    "changed source", t);
+  assert(bytecode_cache_read(path, "let x = 5; x * 2; ") == NULL,
+    "appended source", t);
+
+  // a truncated file must not be trusted
+  FILE* file = fopen(path, "r+b");
+  fseek(file, 0, SEEK_END);
+  assert(ftruncate(fileno(file), ftell(file) - 1) == 0, "truncated", t);
+  fclose(file);
+  assert(bytecode_cache_read(path, source) == NULL, "truncated file", t);
+  remove(path);
+}
+
+// flipping any byte, opcodes and operands included, falls back to a compile
+void test_cache_corruption(void) {
+  char* t = "cache_corruption";
+  char* source = "let f = fn(x) { if (x > 1) { x * f(x - 1) } else { 1 } };"
+                 "f(5) + len(\"four\")";
+  char* path = temp_cache_path();
+  bytecode_cache_write(path, compile_source(source, t), source);
+  assert(bytecode_cache_read(path, source) != NULL, "intact file", t);
+
+  FILE* file = fopen(path, "r+b");
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  for (long offset = 0; offset < size; offset++) {
+    fseek(file, offset, SEEK_SET);
+    int byte = fgetc(file);
+    fseek(file, offset, SEEK_SET);
+    fputc(byte ^ 0x01, file);
+    fflush(file);
+    assert(bytecode_cache_read(path, source) == NULL,
+      ss("corrupt byte at offset %ld", offset), t);
+    fseek(file, offset, SEEK_SET);
+    fputc(byte, file);
+    fflush(file);
+  }
+  fclose(file);
+  remove(path);
+}
+
+int main(int argc, char** argv) {
+  pass_argv(argc, argv);
+  test_cache_round_trip();
+  test_cache_invalidation();
+  test_cache_corruption();
+  printf("\n");
+  return 0;
+}
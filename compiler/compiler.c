@@ -18,6 +18,8 @@ typedef struct EmittedInstructions {
 
 typedef struct Scope {
   Instruct* instructions;
+  int capacity;  // bytes allocated for `instructions`, doubled as needed
+  int jump_target;  // latest position a jump was patched to land on
   EmittedInstruction last_instruction;
   EmittedInstruction previous_instruction;
 } Scope;
@@ -35,9 +37,12 @@ static CompilerErr compile_statements(Compiler c, List* statements);
 static CompilerErr compile_expressions(Compiler c, List* expressions);
 static int add_constant(Compiler c, Object* object);
 static int emit(Compiler c, OpCode op_code, IntBag operands);
+static int fuse_instruction(Compiler c, OpCode op_code, IntBag operands);
 static int add_instruction(Compiler c, Instruct* instructions);
 static void set_last_instruction(Compiler c, OpCode op_code, int position);
 static void remove_last_pop(Compiler c);
+static void mark_tail_calls(Compiler c);
+static bool returns_at(Instruct* instructions, int position);
 static void replace_instruction(Compiler c, int pos, Instruct* new_instruction);
 static void change_operand(Compiler c, int op_code_pos, int operand);
 static Scope make_scope(void);
@@ -57,9 +62,7 @@ void compiler_test_emit(Compiler c, OpCode op_code);
 
 Compiler compiler_new() {
   Compiler compiler = malloc(sizeof(struct Compiler_t));
-  compiler->constant_pool = malloc(sizeof(ConstantPool));
-  compiler->constant_pool->length = 0;
-  compiler->constant_pool->constants = malloc(sizeof(Object) * MAX_CONSTANTS);
+  compiler->constant_pool = constant_pool_new();
   compiler->symbol_table = symbol_table_new();
   compiler->scope_index = 0;
   compiler->scopes[0] = make_scope();
@@ -105,10 +108,13 @@ CompilerErr compile(Compiler c, void* node, NodeType type) {
       break;
 
     case INTEGER_LITERAL_NODE: {
-      Object* int_lit = malloc(sizeof(Object));
-      int_lit->type = INTEGER_OBJ;
+      Object* int_lit = object_alloc(INTEGER_OBJ);
       int_lit->value.i = ((IntegerLiteral*)node)->value;
       int constant_idx = add_constant(c, int_lit);
+      if (constant_idx < 0) {
+        sprintf(err, "too many constants");
+        return err;
+      }
       emit(c, OP_CONSTANT, i(constant_idx));
     } break;
 
@@ -208,10 +214,13 @@ CompilerErr compile(Compiler c, void* node, NodeType type) {
 
         case EXPRESSION_STRING_LITERAL: {
           StringLiteral* str = exp->node;
-          Object* str_lit = malloc(sizeof(Object));
-          str_lit->type = STRING_OBJ;
-          str_lit->value.str = str->value;
+          Object* str_lit = object_alloc(STRING_OBJ);
+          str_lit->value.str = strdup(str->value);
           int constant_idx = add_constant(c, str_lit);
+          if (constant_idx < 0) {
+            sprintf(err, "too many constants");
+            return err;
+          }
           emit(c, OP_CONSTANT, i(constant_idx));
         } break;
 
@@ -279,6 +288,7 @@ CompilerErr compile(Compiler c, void* node, NodeType type) {
             replace_last_pop_with_return(c);
           if (!last_instruction_is(c, OP_RETURN_VALUE))
             emit(c, OP_RETURN, _);
+          mark_tail_calls(c);
 
           SymbolTable symbol_table = compiler_symbol_table(c);
           Symbol** free_symbols = symbol_table_get_free(symbol_table);
@@ -293,10 +303,14 @@ CompilerErr compile(Compiler c, void* node, NodeType type) {
           compiled_fn->num_locals = num_locals;
           compiled_fn->instructions = instructions;
           compiled_fn->num_params = list_count(fn_lit->parameters);
-          Object* compiled_fn_obj = malloc(sizeof(Object));
-          compiled_fn_obj->type = COMPILED_FUNCTION_OBJ;
+          compiled_fn->closure = NULL;
+          compiled_fn->native = NULL;
+          Object* compiled_fn_obj = object_alloc(COMPILED_FUNCTION_OBJ);
           compiled_fn_obj->value.compiled_fn = compiled_fn;
-          emit(c, OP_CLOSURE, ii(add_constant(c, compiled_fn_obj), num_free));
+          int constant_idx = add_constant(c, compiled_fn_obj);
+          if (constant_idx < 0)
+            return "too many constants";
+          emit(c, OP_CLOSURE, ii(constant_idx, num_free));
         } break;
 
         case EXPRESSION_CALL: {
@@ -355,12 +369,65 @@ CompilerErr compile(Compiler c, void* node, NodeType type) {
 }
 
 int emit(Compiler c, OpCode op, IntBag operands) {
+  int fused_pos = fuse_instruction(c, op, operands);
+  if (fused_pos != -1)
+    return fused_pos;
   Instruct* instruction = code_make_nv(op, operands);
   int pos = add_instruction(c, instruction);
   set_last_instruction(c, op, pos);
   return pos;
 }
 
+// peephole pass, run as each instruction is emitted: fuses it into the last
+// one when the pair is among the most frequent in `run -m` opcode profiles
+// (PROFILE=true builds) of the bundled benchmarks. Returns the position of
+// the fused instruction, or -1 to emit `op` as is
+static int fuse_instruction(Compiler c, OpCode op, IntBag operands) {
+  Scope* current = &c->scopes[c->scope_index];
+  int length = current->instructions->length;
+  // never fuse away an instruction a jump lands on
+  if (length == 0 || current->jump_target == length)
+    return -1;
+
+  EmittedInstruction last = current->last_instruction;
+  Byte* last_bytes = &current->instructions->bytes[last.position];
+  OpCode fused;
+  IntBag fused_operands = operands;
+  switch (last.op_code) {
+    case OP_GET_LOCAL:
+      if (op != OP_CONSTANT)
+        return -1;
+      fused = OP_GET_LOCAL_CONSTANT;
+      fused_operands = ii(last_bytes[1], operands.arr[0]);
+      break;
+    case OP_GET_LOCAL_CONSTANT:
+      if (op == OP_ADD)
+        fused = OP_ADD_LOCAL_CONSTANT;
+      else if (op == OP_SUB)
+        fused = OP_SUB_LOCAL_CONSTANT;
+      else
+        return -1;
+      fused_operands = ii(last_bytes[1], read_uint16(&last_bytes[2]));
+      break;
+    case OP_EQUAL:
+    case OP_NOT_EQUAL:
+    case OP_GREATER_THAN:
+      if (op != OP_JUMP_NOT_TRUTHY)
+        return -1;
+      fused = last.op_code == OP_EQUAL       ? OP_JUMP_IF_NOT_EQUAL
+              : last.op_code == OP_NOT_EQUAL ? OP_JUMP_IF_EQUAL
+                                             : OP_JUMP_IF_NOT_GREATER;
+      break;
+    default:
+      return -1;
+  }
+
+  current->instructions->length = last.position;
+  add_instruction(c, code_make_nv(fused, fused_operands));
+  current->last_instruction.op_code = fused;
+  return last.position;
+}
+
 static void replace_instruction(
   Compiler c, int pos, Instruct* new_instruction) {
   for (int i = 0; i < new_instruction->length; i++) {
@@ -368,7 +435,9 @@ static void replace_instruction(
   }
 }
 
+// only used to patch jumps, so `operand` is always a jump target
 static void change_operand(Compiler c, int op_code_pos, int operand) {
+  c->scopes[c->scope_index].jump_target = operand;
   OpCode op = scope(c).instructions->bytes[op_code_pos];
   Instruct* new_instruction = code_make(op, operand);
   replace_instruction(c, op_code_pos, new_instruction);
@@ -387,6 +456,36 @@ static void replace_last_pop_with_return(Compiler c) {
   c->scopes[c->scope_index].last_instruction.op_code = OP_RETURN_VALUE;
 }
 
+// rewrites each call whose result is returned right away, directly or
+// after jumps, into a tail call. Both are the same width, so no jumps move
+static void mark_tail_calls(Compiler c) {
+  Instruct* instructions = scope(c).instructions;
+  for (int pos = 0; pos < instructions->length;) {
+    Byte* op = &instructions->bytes[pos];
+    Definition* def = code_opcode_lookup(*op);
+    pos++;
+    for (int i = 0; i < def->num_operands; i++)
+      pos += def->operand_widths[i];
+    if (*op == OP_CALL && returns_at(instructions, pos))
+      *op = OP_TAIL_CALL;
+  }
+}
+
+static bool returns_at(Instruct* instructions, int position) {
+  // bounded, in case the jumps form a cycle
+  for (int hops = 0; hops < instructions->length; hops++) {
+    if (position >= instructions->length)
+      return false;
+    Byte* op = &instructions->bytes[position];
+    if (*op == OP_RETURN_VALUE)
+      return true;
+    if (*op != OP_JUMP)
+      return false;
+    position = read_uint32(op + 1);
+  }
+  return false;
+}
+
 static void remove_last_pop(Compiler c) {
   scope(c).instructions->length--;
   c->scopes[c->scope_index].last_instruction = scope(c).previous_instruction;
@@ -430,9 +529,20 @@ Bytecode* compiler_bytecode(Compiler c) {
   return bytecode;
 }
 
+ConstantPool* constant_pool_new(void) {
+  ConstantPool* pool = malloc(sizeof(ConstantPool));
+  pool->length = 0;
+  pool->capacity = INITIAL_CONSTANTS;
+  pool->constants = malloc(sizeof(Object*) * pool->capacity);
+  pool->index = hash_new(pool->capacity);
+  return pool;
+}
+
 ConstantPool* make_constant_pool(int len, ...) {
   ConstantPool* pool = malloc(sizeof(ConstantPool));
   pool->length = len;
+  pool->capacity = len;
+  pool->index = NULL;
 
   if (len == 0) {
     pool->constants = NULL;
@@ -442,10 +552,11 @@ ConstantPool* make_constant_pool(int len, ...) {
   va_list ap;
   va_start(ap, len);
 
-  Object* constants = malloc(sizeof(Object) * len);
+  Object** constants = malloc(sizeof(Object*) * len);
   for (int i = 0; i < len; i++) {
     Object constant = va_arg(ap, Object);
-    constants[i] = constant;
+    constants[i] = malloc(sizeof(Object));
+    *constants[i] = constant;
   }
 
   va_end(ap);
@@ -454,18 +565,73 @@ ConstantPool* make_constant_pool(int len, ...) {
   return pool;
 }
 
+static void grow_constant_pool(ConstantPool* pool) {
+  pool->capacity *= 2;
+  pool->constants =
+    realloc(pool->constants, sizeof(Object*) * pool->capacity);
+  if (pool->index == NULL)
+    return;
+
+  // hashes have a fixed number of entries, so re-index into a bigger one
+  Hash* index = hash_new(pool->capacity);
+  for (int i = 0; i < pool->index->length; i++) {
+    HashEntry* entry = &pool->index->entries[i];
+    hash_put(index, entry->key, entry->value);
+  }
+  free(pool->index);
+  pool->index = index;
+}
+
 int add_constant(Compiler c, Object* obj) {
-  c->constant_pool->constants[c->constant_pool->length] = *obj;
-  c->constant_pool->length += 1;
-  return c->constant_pool->length - 1;
+  return constant_pool_add(c->constant_pool, obj);
+}
+
+// returns the index of `obj` in the pool, reusing an equal int or string
+// constant if there is one (`obj` is freed then), or -1 if the pool is full
+int constant_pool_add(ConstantPool* pool, Object* obj) {
+  Value key = value_from(obj);
+  bool interned = pool->index != NULL &&
+                  (obj->type == INTEGER_OBJ || obj->type == STRING_OBJ);
+  if (interned) {
+    HashEntry* entry = hash_get(pool->index, key);
+    if (entry != NULL) {
+      int constant_idx = VALUE_AS_INT(entry->value);
+      // the duplicate is the caller's fresh copy, made while no heap is
+      // active to track it, so nothing else holds it
+      if (pool->constants[constant_idx] != obj) {
+        if (obj->type == STRING_OBJ)
+          free(obj->value.str);
+        free(obj);
+      }
+      return constant_idx;
+    }
+  }
+
+  if (pool->length == MAX_CONSTANTS)
+    return -1;
+  if (pool->length == pool->capacity)
+    grow_constant_pool(pool);
+  int constant_idx = pool->length++;
+  pool->constants[constant_idx] = obj;
+  if (interned)
+    hash_put(pool->index, key, VALUE_INT(constant_idx));
+  return constant_idx;
 }
 
 int add_instruction(Compiler c, Instruct* instruction) {
-  int insert_idx = scope(c).instructions->length;
-  scope(c).instructions->length += instruction->length;
-  for (int i = 0; i < instruction->length; i++) {
-    scope(c).instructions->bytes[insert_idx + i] = instruction->bytes[i];
+  Scope* current = &c->scopes[c->scope_index];
+  int insert_idx = current->instructions->length;
+  int length = insert_idx + instruction->length;
+  if (length > current->capacity) {
+    while (length > current->capacity)
+      current->capacity *= 2;
+    current->instructions->bytes =
+      realloc(current->instructions->bytes, current->capacity);
   }
+  current->instructions->length = length;
+  memcpy(&current->instructions->bytes[insert_idx], instruction->bytes,
+    instruction->length);
+  free(instruction->bytes);
   free(instruction);
   return insert_idx;
 }
@@ -506,7 +672,9 @@ static Scope make_scope(void) {
   Scope scope;
   scope.instructions = malloc(sizeof(Instruct));
   scope.instructions->length = 0;
-  scope.instructions->bytes = malloc(sizeof(Byte) * MAX_INSTRUCTIONS);
+  scope.capacity = INITIAL_INSTRUCTIONS;
+  scope.jump_target = -1;
+  scope.instructions->bytes = malloc(sizeof(Byte) * scope.capacity);
   return scope;
 }
 
@@ -1,22 +1,32 @@
 #ifndef __COMPILER_H__
 #define __COMPILER_H__
 
+#include <stdint.h>
 #include "../ast/ast.h"
 #include "../code/code.h"
 #include "../object/object.h"
 #include "symbol_table.h"
 
-#define MAX_CONSTANTS 64
-#define MAX_INSTRUCTIONS 1024
+#define INITIAL_CONSTANTS 64
+#define MAX_CONSTANTS (UINT16_MAX + 1)  // OP_CONSTANT has a 2-byte operand
+#define INITIAL_INSTRUCTIONS 64
 
 // incomplete declaration for encapsulation
 typedef struct Compiler_t* Compiler;
 
 typedef char* CompilerErr;
 
+/**
+ * Constants are separately allocated so the pool can grow without moving
+ * objects the VM (or REPL globals) already point to. Integer and string
+ * constants are interned through `index`, which maps each one to its
+ * position in the pool.
+ */
 typedef struct ConstantPool {
-  UInt8 length;
-  Object* constants;
+  int length;
+  int capacity;
+  Object** constants;
+  Hash* index;
 } ConstantPool;
 
 typedef struct Bytecode {
@@ -30,6 +40,8 @@ Compiler compiler_new_with_state(
 CompilerErr compile(Compiler c, void* node, NodeType type);
 Bytecode* compiler_bytecode(Compiler c);
 SymbolTable compiler_symbol_table(Compiler c);
+ConstantPool* constant_pool_new(void);
 ConstantPool* make_constant_pool(int len, ...);
+int constant_pool_add(ConstantPool* pool, Object* obj);
 
 #endif  // __COMPILER_H__
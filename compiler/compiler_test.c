@@ -1,6 +1,7 @@
 #include "compiler.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "../code/code.h"
 #include "../parser/parser.h"
 #include "../test/test.h"
@@ -322,13 +323,13 @@ void test_conditionals(void) {
         (Object){INTEGER_OBJ, .value = {.i = 3333}}),  //
       .expected_instructions = code_concat_ins(8,      //
         code_make(OP_TRUE),                            // 0000
-        code_make(OP_JUMP_NOT_TRUTHY, 10),             // 0001
-        code_make(OP_CONSTANT, 0),                     // 0004
-        code_make(OP_JUMP, 11),                        // 0007
-        code_make(OP_NULL),                            // 0010
-        code_make(OP_POP),                             // 0011
-        code_make(OP_CONSTANT, 1),                     // 0012
-        code_make(OP_POP)),                            // 0015
+        code_make(OP_JUMP_NOT_TRUTHY, 14),             // 0001
+        code_make(OP_CONSTANT, 0),                     // 0006
+        code_make(OP_JUMP, 15),                        // 0009
+        code_make(OP_NULL),                            // 0014
+        code_make(OP_POP),                             // 0015
+        code_make(OP_CONSTANT, 1),                     // 0016
+        code_make(OP_POP)),                            // 0019
     },
     {
       .input = "if (true) { 10 } else { 20 }; 3333;",
@@ -338,13 +339,13 @@ void test_conditionals(void) {
         (Object){INTEGER_OBJ, .value = {.i = 3333}}),  //
       .expected_instructions = code_concat_ins(8,      //
         code_make(OP_TRUE),                            // 0000
-        code_make(OP_JUMP_NOT_TRUTHY, 10),             // 0001
-        code_make(OP_CONSTANT, 0),                     // 0004
-        code_make(OP_JUMP, 13),                        // 0007
-        code_make(OP_CONSTANT, 1),                     // 0010
-        code_make(OP_POP),                             // 0013
-        code_make(OP_CONSTANT, 2),                     // 0014
-        code_make(OP_POP)),                            // 0017
+        code_make(OP_JUMP_NOT_TRUTHY, 14),             // 0001
+        code_make(OP_CONSTANT, 0),                     // 0006
+        code_make(OP_JUMP, 17),                        // 0009
+        code_make(OP_CONSTANT, 1),                     // 0014
+        code_make(OP_POP),                             // 0017
+        code_make(OP_CONSTANT, 2),                     // 0018
+        code_make(OP_POP)),                            // 0021
     },
   };
   run_compiler_tests(LEN(tests), tests, "test_conditionals");
@@ -393,36 +394,32 @@ void test_index_expressions(void) {
   CompilerTest tests[] = {
     {
       .input = "[1, 2, 3][1 + 1]",
-      .expected_constants = make_constant_pool(5,   //
+      .expected_constants = make_constant_pool(3,   //
         (Object){INTEGER_OBJ, .value = {.i = 1}},   //
         (Object){INTEGER_OBJ, .value = {.i = 2}},   //
-        (Object){INTEGER_OBJ, .value = {.i = 3}},   //
-        (Object){INTEGER_OBJ, .value = {.i = 1}},   //
-        (Object){INTEGER_OBJ, .value = {.i = 1}}),  //
+        (Object){INTEGER_OBJ, .value = {.i = 3}}),  //
       .expected_instructions = code_concat_ins(9,   //
         code_make(OP_CONSTANT, 0),                  //
         code_make(OP_CONSTANT, 1),                  //
         code_make(OP_CONSTANT, 2),                  //
         code_make(OP_ARRAY, 3),                     //
-        code_make(OP_CONSTANT, 3),                  //
-        code_make(OP_CONSTANT, 4),                  //
+        code_make(OP_CONSTANT, 0),                  //
+        code_make(OP_CONSTANT, 0),                  //
         code_make(OP_ADD),                          //
         code_make(OP_INDEX),                        //
         code_make(OP_POP)),                         //
     },
     {
       .input = "{1: 2}[2 - 1]",
-      .expected_constants = make_constant_pool(4,   //
+      .expected_constants = make_constant_pool(2,   //
         (Object){INTEGER_OBJ, .value = {.i = 1}},   //
-        (Object){INTEGER_OBJ, .value = {.i = 2}},   //
-        (Object){INTEGER_OBJ, .value = {.i = 2}},   //
-        (Object){INTEGER_OBJ, .value = {.i = 1}}),  //
+        (Object){INTEGER_OBJ, .value = {.i = 2}}),  //
       .expected_instructions = code_concat_ins(8,   //
         code_make(OP_CONSTANT, 0),                  //
         code_make(OP_CONSTANT, 1),                  //
         code_make(OP_HASH, 2),                      //
-        code_make(OP_CONSTANT, 2),                  //
-        code_make(OP_CONSTANT, 3),                  //
+        code_make(OP_CONSTANT, 1),                  //
+        code_make(OP_CONSTANT, 0),                  //
         code_make(OP_SUB),                          //
         code_make(OP_INDEX),                        //
         code_make(OP_POP)),                         //
@@ -649,7 +646,7 @@ void test_builtins(void) {
           code_concat_ins(4,                         //
             code_make(OP_GET_BUILTIN, BUILTIN_LEN),  //
             code_make(OP_ARRAY, 0),                  //
-            code_make(OP_CALL, 1),                   //
+            code_make(OP_TAIL_CALL, 1),              //
             code_make(OP_RETURN_VALUE))              //
           )),                                        //
       .expected_instructions = code_concat_ins(2,    //
@@ -769,25 +766,22 @@ void test_recursive_functions(void) {
     {
       .input = "let countDown = fn(x) { countDown(x - 1); }"
                "countDown(1);",
-      .expected_constants = make_constant_pool(3,   //
-        (Object){INTEGER_OBJ, .value = {.i = 1}},   //
-        make_compiled_fn_obj(0,                     //
-          code_concat_ins(6,                        //
-            code_make(OP_CURRENT_CLOSURE),          //
-            code_make(OP_GET_LOCAL, 0),             //
-            code_make(OP_CONSTANT, 0),              //
-            code_make(OP_SUB),                      //
-            code_make(OP_CALL, 1),                  //
-            code_make(OP_RETURN_VALUE))             //
-          ),                                        //
-        (Object){INTEGER_OBJ, .value = {.i = 1}}),  //
-      .expected_instructions = code_concat_ins(6,   //
-        code_make(OP_CLOSURE, 1, 0),                //
-        code_make(OP_SET_GLOBAL, 0),                //
-        code_make(OP_GET_GLOBAL, 0),                //
-        code_make(OP_CONSTANT, 2),                  //
-        code_make(OP_CALL, 1),                      //
-        code_make(OP_POP)),                         //
+      .expected_constants = make_constant_pool(2,    //
+        (Object){INTEGER_OBJ, .value = {.i = 1}},    //
+        make_compiled_fn_obj(0,                      //
+          code_concat_ins(4,                         //
+            code_make(OP_CURRENT_CLOSURE),           //
+            code_make(OP_SUB_LOCAL_CONSTANT, 0, 0),  //
+            code_make(OP_TAIL_CALL, 1),              //
+            code_make(OP_RETURN_VALUE))              //
+          )),                                        //
+      .expected_instructions = code_concat_ins(6,    //
+        code_make(OP_CLOSURE, 1, 0),                 //
+        code_make(OP_SET_GLOBAL, 0),                 //
+        code_make(OP_GET_GLOBAL, 0),                 //
+        code_make(OP_CONSTANT, 0),                   //
+        code_make(OP_CALL, 1),                       //
+        code_make(OP_POP)),                          //
     },
     {
       .input = "let wrapper = fn() {"
@@ -795,33 +789,77 @@ void test_recursive_functions(void) {
                "  countDown(1);"
                "};"
                "wrapper();",
-      .expected_constants = make_constant_pool(4,  //
-        (Object){INTEGER_OBJ, .value = {.i = 1}},  //
-        make_compiled_fn_obj(0,                    //
-          code_concat_ins(6,                       //
-            code_make(OP_CURRENT_CLOSURE),         //
-            code_make(OP_GET_LOCAL, 0),            //
-            code_make(OP_CONSTANT, 0),             //
-            code_make(OP_SUB),                     //
-            code_make(OP_CALL, 1),                 //
-            code_make(OP_RETURN_VALUE))            //
+      .expected_constants = make_constant_pool(3,    //
+        (Object){INTEGER_OBJ, .value = {.i = 1}},    //
+        make_compiled_fn_obj(0,                      //
+          code_concat_ins(4,                         //
+            code_make(OP_CURRENT_CLOSURE),           //
+            code_make(OP_SUB_LOCAL_CONSTANT, 0, 0),  //
+            code_make(OP_TAIL_CALL, 1),              //
+            code_make(OP_RETURN_VALUE))              //
           ),
-        (Object){INTEGER_OBJ, .value = {.i = 1}},  //
-        make_compiled_fn_obj(0,                    //
-          code_concat_ins(6,                       //
-            code_make(OP_CLOSURE, 1, 0),           //
-            code_make(OP_SET_LOCAL, 0),            //
-            code_make(OP_GET_LOCAL, 0),            //
-            code_make(OP_CONSTANT, 2),             //
-            code_make(OP_CALL, 1),                 //
-            code_make(OP_RETURN_VALUE))            //
-          )),                                      //
-      .expected_instructions = code_concat_ins(5,  //
-        code_make(OP_CLOSURE, 3, 0),               //
-        code_make(OP_SET_GLOBAL, 0),               //
-        code_make(OP_GET_GLOBAL, 0),               //
-        code_make(OP_CALL, 0),                     //
-        code_make(OP_POP)),                        //
+        make_compiled_fn_obj(0,                      //
+          code_concat_ins(5,                         //
+            code_make(OP_CLOSURE, 1, 0),             //
+            code_make(OP_SET_LOCAL, 0),              //
+            code_make(OP_GET_LOCAL_CONSTANT, 0, 0),  //
+            code_make(OP_TAIL_CALL, 1),              //
+            code_make(OP_RETURN_VALUE))              //
+          )),                                        //
+      .expected_instructions = code_concat_ins(5,    //
+        code_make(OP_CLOSURE, 2, 0),                 //
+        code_make(OP_SET_GLOBAL, 0),                 //
+        code_make(OP_GET_GLOBAL, 0),                 //
+        code_make(OP_CALL, 0),                       //
+        code_make(OP_POP)),                          //
+    },
+  };
+  run_compiler_tests(LEN(tests), tests, __func__);
+}
+
+void test_tail_calls(void) {
+  CompilerTest tests[] = {
+    {
+      // the consequence's call is returned after a jump to the end
+      .input = "fn(f, n) { if (n) { f(1) } else { return f(2); } }",
+      .expected_constants = make_constant_pool(3,    //
+        (Object){INTEGER_OBJ, .value = {.i = 1}},    //
+        (Object){INTEGER_OBJ, .value = {.i = 2}},    //
+        make_compiled_fn_obj(0,                      //
+          code_concat_ins(9,                         //
+            code_make(OP_GET_LOCAL, 1),              // 0000
+            code_make(OP_JUMP_NOT_TRUTHY, 18),       // 0002
+            code_make(OP_GET_LOCAL_CONSTANT, 0, 0),  // 0007
+            code_make(OP_TAIL_CALL, 1),              // 0011
+            code_make(OP_JUMP, 25),                  // 0013
+            code_make(OP_GET_LOCAL_CONSTANT, 0, 1),  // 0018
+            code_make(OP_TAIL_CALL, 1),              // 0022
+            code_make(OP_RETURN_VALUE),              // 0024
+            code_make(OP_RETURN_VALUE))              // 0025
+          )),                                        //
+      .expected_instructions = code_concat_ins(2,    //
+        code_make(OP_CLOSURE, 2, 0),                 //
+        code_make(OP_POP)),                          //
+    },
+    {
+      .input = "fn(f) { let x = f(1); f(x) + 1 }",
+      .expected_constants = make_constant_pool(2,    //
+        (Object){INTEGER_OBJ, .value = {.i = 1}},    //
+        make_compiled_fn_obj(0,                      //
+          code_concat_ins(9,                         //
+            code_make(OP_GET_LOCAL_CONSTANT, 0, 0),  //
+            code_make(OP_CALL, 1),                   //
+            code_make(OP_SET_LOCAL, 1),              //
+            code_make(OP_GET_LOCAL, 0),              //
+            code_make(OP_GET_LOCAL, 1),              //
+            code_make(OP_CALL, 1),                   //
+            code_make(OP_CONSTANT, 0),               //
+            code_make(OP_ADD),                       //
+            code_make(OP_RETURN_VALUE))              //
+          )),                                        //
+      .expected_instructions = code_concat_ins(2,    //
+        code_make(OP_CLOSURE, 1, 0),                 //
+        code_make(OP_POP)),                          //
     },
   };
   run_compiler_tests(LEN(tests), tests, __func__);
@@ -878,9 +916,124 @@ void test_compiler_scopes(void) {
     t);
 }
 
+void test_superinstructions(void) {
+  CompilerTest tests[] = {
+    {
+      .input = "fn(x) { if (x == 1) { x + 2 } else { 3 } }",
+      .expected_constants = make_constant_pool(4,          //
+        (Object){INTEGER_OBJ, .value = {.i = 1}},          //
+        (Object){INTEGER_OBJ, .value = {.i = 2}},          //
+        (Object){INTEGER_OBJ, .value = {.i = 3}},          //
+        make_compiled_fn_obj(1,                            //
+          code_concat_ins(6,                               //
+            code_make(OP_GET_LOCAL_CONSTANT, 0, 0),        // 0000
+            code_make(OP_JUMP_IF_NOT_EQUAL, 18),           // 0004
+            code_make(OP_ADD_LOCAL_CONSTANT, 0, 1),        // 0009
+            code_make(OP_JUMP, 21),                        // 0013
+            code_make(OP_CONSTANT, 2),                     // 0018
+            code_make(OP_RETURN_VALUE)))),                 // 0021
+      .expected_instructions = code_concat_ins(2,          //
+        code_make(OP_CLOSURE, 3, 0),                       //
+        code_make(OP_POP)),                                //
+    },
+    {
+      // the constant is a jump target, so it can't be fused into x
+      .input = "fn(x) { (if (x > 1) { 1 } else { x }) - 1 }",
+      .expected_constants = make_constant_pool(2,          //
+        (Object){INTEGER_OBJ, .value = {.i = 1}},          //
+        make_compiled_fn_obj(1,                            //
+          code_concat_ins(8,                               //
+            code_make(OP_GET_LOCAL_CONSTANT, 0, 0),        // 0000
+            code_make(OP_JUMP_IF_NOT_GREATER, 17),         // 0004
+            code_make(OP_CONSTANT, 0),                     // 0009
+            code_make(OP_JUMP, 19),                        // 0012
+            code_make(OP_GET_LOCAL, 0),                    // 0017
+            code_make(OP_CONSTANT, 0),                     // 0019
+            code_make(OP_SUB),                             // 0022
+            code_make(OP_RETURN_VALUE)))),                 // 0023
+      .expected_instructions = code_concat_ins(2,          //
+        code_make(OP_CLOSURE, 1, 0),                       //
+        code_make(OP_POP)),                                //
+    },
+  };
+  run_compiler_tests(LEN(tests), tests, __func__);
+}
+
+void test_constant_pool(void) {
+  CompilerTest tests[] = {
+    {
+      .input = "\"a\"; 1; \"a\" + \"b\"; 1;",
+      .expected_constants = make_constant_pool(3,        //
+        (Object){STRING_OBJ, .value = {.str = "a"}},     //
+        (Object){INTEGER_OBJ, .value = {.i = 1}},        //
+        (Object){STRING_OBJ, .value = {.str = "b"}}),    //
+      .expected_instructions = code_concat_ins(10,       //
+        code_make(OP_CONSTANT, 0),                       //
+        code_make(OP_POP),                               //
+        code_make(OP_CONSTANT, 1),                       //
+        code_make(OP_POP),                               //
+        code_make(OP_CONSTANT, 0),                       //
+        code_make(OP_CONSTANT, 2),                       //
+        code_make(OP_ADD),                               //
+        code_make(OP_POP),                               //
+        code_make(OP_CONSTANT, 1),                       //
+        code_make(OP_POP)),                              //
+    },
+  };
+  run_compiler_tests(LEN(tests), tests, __func__);
+
+  // more constants than the initial pool holds, each used twice
+  char* t = "constant_pool_growth";
+  char input[4096] = "";
+  for (int i = 0; i < 300; i++)
+    sprintf(&input[strlen(input)], "%d;", i);
+  strcat(input, "299;");
+  Compiler compiler = compiler_new();
+  assert(compile(compiler, parse_program(input), PROGRAM_NODE) == NULL,
+    "compiled", t);
+  Bytecode* bytecode = compiler_bytecode(compiler);
+  assert_int_is(300, bytecode->constants->length, "constants length", t);
+  assert_int_is(299, bytecode->constants->constants[299]->value.i,
+    "last constant", t);
+  Byte* last = &bytecode->instructions->bytes[300 * 4];
+  assert_int_is(299, read_uint16(last + 1), "reused constant", t);
+}
+
+void test_large_programs(void) {
+  char* t = "large_programs";
+  int num_statements = 100000;
+  Program* program = parse_program("if (true) { false } else { true };");
+  List* statements = NULL;
+  for (int i = 0; i < num_statements; i++) {
+    List* node = malloc(sizeof(List));
+    node->item = program->statements->item;
+    node->next = statements;
+    statements = node;
+  }
+  program->statements = statements;
+
+  Compiler compiler = compiler_new();
+  assert(compile(compiler, program, PROGRAM_NODE) == NULL, "compiled", t);
+  Instruct* ins = compiler_bytecode(compiler)->instructions;
+  int statement_len = 14;
+  assert_int_is(num_statements * statement_len, ins->length,
+    "instructions length", t);
+
+  int last = (num_statements - 1) * statement_len;
+  Definition* def = code_opcode_lookup(OP_JUMP_NOT_TRUTHY);
+  Instruct jump = {.length = 5, .bytes = &ins->bytes[last + 1]};
+  ReadOpResult res = code_read_operands(*def, jump);
+  assert_int_is(OP_JUMP_NOT_TRUTHY, ins->bytes[last + 1], "last jump", t);
+  assert_int_is(last + 12, res.operands.arr[0], "jump past 64k", t);
+}
+
 int main(int argc, char** argv) {
   pass_argv(argc, argv);
+  test_large_programs();
+  test_constant_pool();
+  test_superinstructions();
   test_recursive_functions();
+  test_tail_calls();
   test_closures();
   test_builtins();
   test_compiler_scopes();
@@ -915,8 +1068,8 @@ void test_instructions(Instruct* expected, Instruct* actual, char* test) {
 void test_constants(ConstantPool* expected, ConstantPool* actual, char* test) {
   assert_int_is(expected->length, actual->length, "constants length", test);
   for (int i = 0; i < expected->length; i++) {
-    Object expected_constant = expected->constants[i];
-    Object actual_constant = actual->constants[i];
+    Object expected_constant = *expected->constants[i];
+    Object actual_constant = *actual->constants[i];
     switch (expected_constant.type) {
       case INTEGER_OBJ:
         assert_integer_object(expected_constant.value.i, actual_constant, test);
@@ -963,5 +1116,6 @@ Object make_compiled_fn_obj(int num_locals, Instruct* instructions) {
   CompiledFunction* compiled_fn = malloc(sizeof(CompiledFunction));
   compiled_fn->num_locals = num_locals;
   compiled_fn->instructions = instructions;
-  return (Object){.type = COMPILED_FUNCTION_OBJ, {.compiled_fn = compiled_fn}};
+  return (Object){
+    .type = COMPILED_FUNCTION_OBJ, .value = {.compiled_fn = compiled_fn}};
 }
@@ -0,0 +1,393 @@
+#include "optimizer.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// passes repeat until the instructions stop shrinking, since each one can
+// leave more to do (a resolved jump orphans the code it jumped over)
+#define MAX_PASSES 8
+
+// a decoded instruction
+typedef struct Op {
+  OpCode op_code;
+  IntBag operands;
+  int position;  // in the instructions being optimized
+  bool is_target;
+} Op;
+
+typedef struct Ops {
+  int length;
+  Op* ops;
+  bool reachable;
+} Ops;
+
+static int optimize_instructions(Instruct* instructions, ConstantPool* pool);
+static Ops decode(Instruct* instructions);
+static void encode(Instruct* instructions, Ops* ops);
+static void thread_jumps(Ops* ops, int num_bytes);
+static void mark_jump_targets(Ops* ops, int num_bytes);
+static void append(Ops* out, Op op, ConstantPool* pool);
+static bool fold_unary(Ops* out, Op op, ConstantPool* pool);
+static bool fold_binary(Ops* out, Op op, ConstantPool* pool);
+static bool fold_jump(Ops* out, Op op, ConstantPool* pool);
+static bool binary_result(OpCode op, Value left, Value right, Value* result);
+static bool int_result(OpCode op, int left, int right, Value* result);
+static bool constant_op(Value value, ConstantPool* pool, Op* op);
+static bool is_constant(Op op);
+static Value constant_value(Op op, ConstantPool* pool);
+static bool is_jump(OpCode op);
+static bool ends_block(OpCode op);
+static OpCode comparison_of(OpCode jump);
+
+int optimize_bytecode(Bytecode* bytecode) {
+  ConstantPool* pool = bytecode->constants;
+  int saved = optimize_instructions(bytecode->instructions, pool);
+  // folding only ever adds int and string constants, so this sees every fn
+  for (int i = 0; i < pool->length; i++) {
+    Object* constant = pool->constants[i];
+    if (constant->type == COMPILED_FUNCTION_OBJ)
+      saved += optimize_instructions(
+        constant->value.compiled_fn->instructions, pool);
+  }
+  return saved;
+}
+
+static int optimize_instructions(Instruct* instructions, ConstantPool* pool) {
+  int original_length = instructions->length;
+  for (int pass = 0; pass < MAX_PASSES; pass++) {
+    int length = instructions->length;
+    Ops ops = decode(instructions);
+    thread_jumps(&ops, length);
+    mark_jump_targets(&ops, length);
+
+    Ops out = {.length = 0, .ops = malloc(sizeof(Op) * (ops.length + 1))};
+    out.reachable = true;
+    for (int i = 0; i < ops.length; i++) {
+      Op op = ops.ops[i];
+      if (op.is_target)
+        out.reachable = true;
+      if (!out.reachable)
+        continue;
+      // a jump to the very next instruction does nothing
+      while (out.length > 0 && out.ops[out.length - 1].op_code == OP_JUMP &&
+             out.ops[out.length - 1].operands.arr[0] == op.position)
+        out.length--;
+      append(&out, op, pool);
+    }
+
+    // the ops map their old positions to new ones, so the jumps are
+    // re-encoded in terms of the old instructions
+    encode(instructions, &out);
+    free(ops.ops);
+    free(out.ops);
+    if (instructions->length == length)
+      break;
+  }
+  return original_length - instructions->length;
+}
+
+static Ops decode(Instruct* instructions) {
+  Ops ops = {.length = 0, .ops = malloc(sizeof(Op) * instructions->length)};
+  for (int pos = 0; pos < instructions->length;) {
+    Definition* def = code_opcode_lookup(instructions->bytes[pos]);
+    Instruct rest = {instructions->length - pos, &instructions->bytes[pos]};
+    ReadOpResult read = code_read_operands(*def, rest);
+    ops.ops[ops.length++] = (Op){
+      .op_code = instructions->bytes[pos],
+      .operands = read.operands,
+      .position = pos,
+      .is_target = false,
+    };
+    pos += 1 + read.bytes_read;
+  }
+  return ops;
+}
+
+static void encode(Instruct* instructions, Ops* ops) {
+  int old_length = instructions->length;
+  int* new_positions = malloc(sizeof(int) * (old_length + 1));
+  for (int pos = 0; pos <= old_length; pos++)
+    new_positions[pos] = -1;
+
+  Instruct** encoded = malloc(sizeof(Instruct*) * (ops->length + 1));
+  int length = 0;
+  for (int i = 0; i < ops->length; i++) {
+    encoded[i] = code_make_nv(ops->ops[i].op_code, ops->ops[i].operands);
+    new_positions[ops->ops[i].position] = length;
+    length += encoded[i]->length;
+  }
+
+  // an old position whose instruction was dropped now means the next one
+  // that was kept
+  new_positions[old_length] = length;
+  for (int pos = old_length - 1; pos >= 0; pos--)
+    if (new_positions[pos] == -1)
+      new_positions[pos] = new_positions[pos + 1];
+
+  Byte* bytes = malloc(length > 0 ? length : 1);
+  int pos = 0;
+  for (int i = 0; i < ops->length; i++) {
+    Op op = ops->ops[i];
+    if (is_jump(op.op_code)) {
+      free(encoded[i]->bytes);
+      encoded[i] =
+        code_make(op.op_code, new_positions[op.operands.arr[0]]);
+    }
+    memcpy(&bytes[pos], encoded[i]->bytes, encoded[i]->length);
+    pos += encoded[i]->length;
+    free(encoded[i]->bytes);
+    free(encoded[i]);
+  }
+
+  // the old bytes may live in a cache file mapping, so they're not freed
+  instructions->bytes = bytes;
+  instructions->length = length;
+  free(encoded);
+  free(new_positions);
+}
+
+// a jump landing on an OP_JUMP can go straight to where that one goes
+static void thread_jumps(Ops* ops, int num_bytes) {
+  int* op_at = malloc(sizeof(int) * (num_bytes + 1));
+  for (int pos = 0; pos <= num_bytes; pos++)
+    op_at[pos] = -1;
+  for (int i = 0; i < ops->length; i++)
+    op_at[ops->ops[i].position] = i;
+
+  for (int i = 0; i < ops->length; i++) {
+    Op* op = &ops->ops[i];
+    if (!is_jump(op->op_code))
+      continue;
+    // bounded, since jumps can form a cycle (though Monkey has no loops)
+    for (int hops = 0; hops < ops->length; hops++) {
+      int target = op_at[op->operands.arr[0]];
+      if (target == -1 || ops->ops[target].op_code != OP_JUMP ||
+          target == i)
+        break;
+      op->operands.arr[0] = ops->ops[target].operands.arr[0];
+    }
+  }
+  free(op_at);
+}
+
+static void mark_jump_targets(Ops* ops, int num_bytes) {
+  bool* is_target = calloc(num_bytes + 1, sizeof(bool));
+  for (int i = 0; i < ops->length; i++)
+    if (is_jump(ops->ops[i].op_code))
+      is_target[ops->ops[i].operands.arr[0]] = true;
+  for (int i = 0; i < ops->length; i++)
+    ops->ops[i].is_target = is_target[ops->ops[i].position];
+  free(is_target);
+}
+
+// appends `op`, first folding it into the constants before it if it can.
+// Only the first op of a folded sequence may be a jump target: otherwise
+// the operands could come from another path
+static void append(Ops* out, Op op, ConstantPool* pool) {
+  if (!op.is_target &&
+      (fold_unary(out, op, pool) || fold_binary(out, op, pool) ||
+        fold_jump(out, op, pool)))
+    return;
+  out->ops[out->length++] = op;
+  out->reachable = !ends_block(op.op_code);
+}
+
+static bool fold_unary(Ops* out, Op op, ConstantPool* pool) {
+  if ((op.op_code != OP_MINUS && op.op_code != OP_BANG) || out->length < 1)
+    return false;
+  Op* operand = &out->ops[out->length - 1];
+  if (!is_constant(*operand))
+    return false;
+
+  Value value = constant_value(*operand, pool);
+  Value result;
+  if (op.op_code == OP_BANG)
+    result = VALUE_BOOL(!VALUE_IS_TRUTHY(value));
+  else if (VALUE_IS_INT(value))
+    result = VALUE_INT(-VALUE_AS_INT(value));
+  else
+    return false;  // left for the VM to report
+  return constant_op(result, pool, operand);
+}
+
+static bool fold_binary(Ops* out, Op op, ConstantPool* pool) {
+  if (out->length < 2)
+    return false;
+  Op* left = &out->ops[out->length - 2];
+  Op* right = &out->ops[out->length - 1];
+  if (!is_constant(*left) || !is_constant(*right) || right->is_target)
+    return false;
+
+  Value result;
+  if (!binary_result(op.op_code, constant_value(*left, pool),
+        constant_value(*right, pool), &result))
+    return false;
+  if (!constant_op(result, pool, left))
+    return false;
+  out->length--;
+  return true;
+}
+
+// a conditional jump on a constant condition either always or never jumps
+static bool fold_jump(Ops* out, Op op, ConstantPool* pool) {
+  Value condition;
+  int num_operands;
+  if (op.op_code == OP_JUMP_NOT_TRUTHY) {
+    if (out->length < 1 || !is_constant(out->ops[out->length - 1]))
+      return false;
+    condition = constant_value(out->ops[out->length - 1], pool);
+    num_operands = 1;
+  } else if (comparison_of(op.op_code) != OP_JUMP) {
+    if (out->length < 2)
+      return false;
+    Op left = out->ops[out->length - 2];
+    Op right = out->ops[out->length - 1];
+    if (!is_constant(left) || !is_constant(right) || right.is_target ||
+        !binary_result(comparison_of(op.op_code),
+          constant_value(left, pool), constant_value(right, pool),
+          &condition))
+      return false;
+    num_operands = 2;
+  } else {
+    return false;
+  }
+
+  out->length -= num_operands;
+  if (VALUE_IS_TRUTHY(condition))
+    return true;
+  Op* first = &out->ops[out->length++];
+  first->op_code = OP_JUMP;
+  first->operands = op.operands;
+  out->reachable = false;
+  return true;
+}
+
+// mirrors the VM, but leaves anything it would fail on unfolded
+static bool binary_result(OpCode op, Value left, Value right, Value* result) {
+  if (VALUE_IS_INT(left) && VALUE_IS_INT(right))
+    return int_result(op, VALUE_AS_INT(left), VALUE_AS_INT(right), result);
+
+  if (op == OP_ADD && VALUE_HAS_TYPE(left, STRING_OBJ) &&
+      VALUE_HAS_TYPE(right, STRING_OBJ)) {
+    char* l = VALUE_AS_OBJ(left)->value.str;
+    char* r = VALUE_AS_OBJ(right)->value.str;
+    Object* str = object_alloc(STRING_OBJ);
+    str->value.str = malloc(strlen(l) + strlen(r) + 1);
+    sprintf(str->value.str, "%s%s", l, r);
+    *result = VALUE_OBJ(str);
+    return true;
+  }
+
+  if (VALUE_IS_BOOL(left) && VALUE_IS_BOOL(right)) {
+    if (op == OP_EQUAL)
+      *result = VALUE_BOOL(left == right);
+    else if (op == OP_NOT_EQUAL)
+      *result = VALUE_BOOL(left != right);
+    else
+      return false;
+    return true;
+  }
+  return false;
+}
+
+static bool int_result(OpCode op, int left, int right, Value* result) {
+  switch (op) {
+    case OP_ADD:
+      *result = VALUE_INT(left + right);
+      return true;
+    case OP_SUB:
+      *result = VALUE_INT(left - right);
+      return true;
+    case OP_MUL:
+      *result = VALUE_INT(left * right);
+      return true;
+    case OP_DIV:
+      if (right == 0)
+        return false;
+      *result = VALUE_INT(left / right);
+      return true;
+    case OP_EQUAL:
+      *result = VALUE_BOOL(left == right);
+      return true;
+    case OP_NOT_EQUAL:
+      *result = VALUE_BOOL(left != right);
+      return true;
+    case OP_GREATER_THAN:
+      *result = VALUE_BOOL(left > right);
+      return true;
+    default:
+      return false;
+  }
+}
+
+// overwrites `op` with one that pushes `value`
+static bool constant_op(Value value, ConstantPool* pool, Op* op) {
+  if (value == VALUE_TRUE || value == VALUE_FALSE) {
+    op->op_code = value == VALUE_TRUE ? OP_TRUE : OP_FALSE;
+    op->operands = (IntBag){.len = 0};
+    return true;
+  }
+
+  Object* constant;
+  if (VALUE_IS_INT(value)) {
+    constant = object_alloc(INTEGER_OBJ);
+    constant->value.i = VALUE_AS_INT(value);
+  } else {
+    constant = VALUE_AS_OBJ(value);
+  }
+  int constant_idx = constant_pool_add(pool, constant);
+  if (constant_idx < 0)
+    return false;
+  op->op_code = OP_CONSTANT;
+  op->operands = i(constant_idx);
+  return true;
+}
+
+static bool is_constant(Op op) {
+  switch (op.op_code) {
+    case OP_CONSTANT:
+    case OP_TRUE:
+    case OP_FALSE:
+    case OP_NULL:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static Value constant_value(Op op, ConstantPool* pool) {
+  switch (op.op_code) {
+    case OP_TRUE:
+      return VALUE_TRUE;
+    case OP_FALSE:
+      return VALUE_FALSE;
+    case OP_NULL:
+      return VALUE_NULL;
+    default:
+      return value_from(pool->constants[op.operands.arr[0]]);
+  }
+}
+
+static bool is_jump(OpCode op) {
+  return op == OP_JUMP || op == OP_JUMP_NOT_TRUTHY ||
+         comparison_of(op) != OP_JUMP;
+}
+
+static bool ends_block(OpCode op) {
+  return op == OP_JUMP || op == OP_RETURN || op == OP_RETURN_VALUE;
+}
+
+// the comparison a fused compare-and-jump makes, or OP_JUMP for other ops
+static OpCode comparison_of(OpCode jump) {
+  switch (jump) {
+    case OP_JUMP_IF_NOT_EQUAL:
+      return OP_EQUAL;
+    case OP_JUMP_IF_EQUAL:
+      return OP_NOT_EQUAL;
+    case OP_JUMP_IF_NOT_GREATER:
+      return OP_GREATER_THAN;
+    default:
+      return OP_JUMP;
+  }
+}
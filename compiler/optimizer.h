@@ -0,0 +1,16 @@
+#ifndef __OPTIMIZER_H__
+#define __OPTIMIZER_H__
+
+#include "compiler.h"
+
+/**
+ * Peephole pass over compiled bytecode, run by `monkey run -O`. Folds
+ * operators whose operands are constants (`1 + 2`, `"a" + "b"`, `!true`),
+ * resolves conditional jumps on constant conditions, threads jumps that land
+ * on unconditional jumps, and drops code no jump can reach after a jump or
+ * return. The top-level instructions and every compiled function in the
+ * constant pool are rewritten in place; returns the number of bytes saved.
+ */
+int optimize_bytecode(Bytecode* bytecode);
+
+#endif  // __OPTIMIZER_H__
@@ -0,0 +1,195 @@
+#include "optimizer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../test/compile.h"
+#include "../test/test.h"
+
+typedef struct OptimizerTest {
+  char* input;
+  Instruct* expected_instructions;
+  int expected_bytes_saved;
+} OptimizerTest;
+
+// the instructions of the last function in the pool, if there is one
+static Instruct* optimized_instructions(Bytecode* bytecode) {
+  ConstantPool* pool = bytecode->constants;
+  for (int i = pool->length - 1; i >= 0; i--)
+    if (pool->constants[i]->type == COMPILED_FUNCTION_OBJ)
+      return pool->constants[i]->value.compiled_fn->instructions;
+  return bytecode->instructions;
+}
+
+static void run_optimizer_tests(
+  int len, OptimizerTest tests[len], const char* t) {
+  for (int i = 0; i < len; i++) {
+    OptimizerTest test = tests[i];
+    Bytecode* bytecode = compile_source(test.input, t);
+    int bytes_saved = optimize_bytecode(bytecode);
+    Instruct* actual = optimized_instructions(bytecode);
+    Instruct* expected = test.expected_instructions;
+    char* input = ss("input=`%s`", test.input);
+    assert_int_is(test.expected_bytes_saved, bytes_saved, "bytes saved", t);
+    assert_int_is(expected->length, actual->length, input, t);
+    if (expected->length == actual->length &&
+        memcmp(expected->bytes, actual->bytes, expected->length) != 0)
+      fail(ss("%s: want=\n%s\ngot=\n%s", input, instructions_str(*expected),
+             instructions_str(*actual)),
+        t);
+  }
+}
+
+void test_constant_folding(void) {
+  OptimizerTest tests[] = {
+    {
+      // 2 * 3 and then 1 + 6 are added to the pool as constants 3 and 4
+      .input = "1 + 2 * 3",
+      .expected_instructions = code_concat_ins(2,  //
+        code_make(OP_CONSTANT, 4),                 //
+        code_make(OP_POP)),                        //
+      .expected_bytes_saved = 8,
+    },
+    {
+      .input = "!true; -5",
+      .expected_instructions = code_concat_ins(4,  //
+        code_make(OP_FALSE),                       //
+        code_make(OP_POP),                         //
+        code_make(OP_CONSTANT, 1),                 //
+        code_make(OP_POP)),                        //
+      .expected_bytes_saved = 2,
+    },
+    {
+      .input = "10 > 2 == true",
+      .expected_instructions = code_concat_ins(2,  //
+        code_make(OP_TRUE),                        //
+        code_make(OP_POP)),                        //
+      .expected_bytes_saved = 8,
+    },
+    {
+      // left for the VM to fail on
+      .input = "1 / 0; 1 == true; \"a\" - \"b\"; -true",
+      .expected_instructions = code_concat_ins(15,  //
+        code_make(OP_CONSTANT, 0),                  //
+        code_make(OP_CONSTANT, 1),                  //
+        code_make(OP_DIV),                          //
+        code_make(OP_POP),                          //
+        code_make(OP_CONSTANT, 0),                  //
+        code_make(OP_TRUE),                         //
+        code_make(OP_EQUAL),                        //
+        code_make(OP_POP),                          //
+        code_make(OP_CONSTANT, 2),                  //
+        code_make(OP_CONSTANT, 3),                  //
+        code_make(OP_SUB),                          //
+        code_make(OP_POP),                          //
+        code_make(OP_TRUE),                         //
+        code_make(OP_MINUS),                        //
+        code_make(OP_POP)),                         //
+      .expected_bytes_saved = 0,
+    },
+  };
+  run_optimizer_tests(LEN(tests), tests, __func__);
+}
+
+void test_string_folding(void) {
+  char* t = "string_folding";
+  Bytecode* bytecode = compile_source("\"mon\" + \"key\"", t);
+  assert_int_is(4, optimize_bytecode(bytecode), "bytes saved", t);
+  assert_int_is(3, bytecode->constants->length, "constants", t);
+  assert_str_is("monkey", bytecode->constants->constants[2]->value.str,
+    "folded string", t);
+}
+
+void test_constant_conditions(void) {
+  OptimizerTest tests[] = {
+    {
+      .input = "if (true) { 10 } else { 20 }; 3333;",
+      .expected_instructions = code_concat_ins(4,  //
+        code_make(OP_CONSTANT, 0),                 //
+        code_make(OP_POP),                         //
+        code_make(OP_CONSTANT, 2),                 //
+        code_make(OP_POP)),                        //
+      .expected_bytes_saved = 14,
+    },
+    {
+      .input = "if (1 > 2) { 10 }",
+      .expected_instructions = code_concat_ins(2,  //
+        code_make(OP_NULL),                        //
+        code_make(OP_POP)),                        //
+      .expected_bytes_saved = 19,
+    },
+    {
+      .input = "fn(x) { if (1 == 1) { x } else { 5 } }",
+      .expected_instructions = code_concat_ins(2,  //
+        code_make(OP_GET_LOCAL, 0),                //
+        code_make(OP_RETURN_VALUE)),               //
+      .expected_bytes_saved = 19,
+    },
+  };
+  run_optimizer_tests(LEN(tests), tests, __func__);
+}
+
+void test_jumps(void) {
+  OptimizerTest tests[] = {
+    {
+      // the inner if's jump over its alternative goes straight to the end
+      .input = "fn(x, y) { if (x) { if (y) { 1 } else { 2 } } else { 3 } }",
+      .expected_instructions = code_concat_ins(10,  //
+        code_make(OP_GET_LOCAL, 0),                 // 0000
+        code_make(OP_JUMP_NOT_TRUTHY, 30),          // 0002
+        code_make(OP_GET_LOCAL, 1),                 // 0007
+        code_make(OP_JUMP_NOT_TRUTHY, 22),          // 0009
+        code_make(OP_CONSTANT, 0),                  // 0014
+        code_make(OP_JUMP, 33),                     // 0017
+        code_make(OP_CONSTANT, 1),                  // 0022
+        code_make(OP_JUMP, 33),                     // 0025
+        code_make(OP_CONSTANT, 2),                  // 0030
+        code_make(OP_RETURN_VALUE)),                // 0033
+      .expected_bytes_saved = 0,
+    },
+    {
+      .input = "fn() { return 1; 2 }",
+      .expected_instructions = code_concat_ins(2,  //
+        code_make(OP_CONSTANT, 0),                 //
+        code_make(OP_RETURN_VALUE)),               //
+      .expected_bytes_saved = 4,
+    },
+    {
+      // the consequence ends in a return, so its jump to the end is dead
+      .input = "fn(x) { if (x == 1) { return 2; } 3 }",
+      .expected_instructions = code_concat_ins(8,  //
+        code_make(OP_GET_LOCAL_CONSTANT, 0, 0),    //
+        code_make(OP_JUMP_IF_NOT_EQUAL, 13),       //
+        code_make(OP_CONSTANT, 1),                 //
+        code_make(OP_RETURN_VALUE),                //
+        code_make(OP_NULL),                        //
+        code_make(OP_POP),                         //
+        code_make(OP_CONSTANT, 2),                 //
+        code_make(OP_RETURN_VALUE)),               //
+      .expected_bytes_saved = 5,
+    },
+    {
+      // OP_MINUS is a jump target, so its operand isn't always the 2
+      .input = "fn(x) { -(if (x) { 1 } else { 2 }) }",
+      .expected_instructions = code_concat_ins(7,  //
+        code_make(OP_GET_LOCAL, 0),                //
+        code_make(OP_JUMP_NOT_TRUTHY, 15),         //
+        code_make(OP_CONSTANT, 0),                 //
+        code_make(OP_JUMP, 18),                    //
+        code_make(OP_CONSTANT, 1),                 //
+        code_make(OP_MINUS),                       //
+        code_make(OP_RETURN_VALUE)),               //
+      .expected_bytes_saved = 0,
+    },
+  };
+  run_optimizer_tests(LEN(tests), tests, __func__);
+}
+
+int main(int argc, char** argv) {
+  pass_argv(argc, argv);
+  test_constant_folding();
+  test_string_folding();
+  test_constant_conditions();
+  test_jumps();
+  printf("\n");
+  return 0;
+}
@@ -1,37 +1,33 @@
 #include "symbol_table.h"
-#include <ctype.h>
-#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
 #include "../object/object.h"
+#include "../utils/intern.h"
 
-// 26 (uppercase) + 26 (lowercase) + 10 (digits) + 1 (underscore)
-#define NUM_IDENT_CHARS 63
+#define INITIAL_STORE_CAPACITY 16  // a power of 2
 
-typedef struct HashNode {
-  struct HashNode* chars[NUM_IDENT_CHARS];
-  Symbol* symbol;
-} HashNode;
-
-typedef HashNode Store;
+// names are interned, so they're hashed and compared by pointer
+typedef struct Store {
+  Symbol** symbols;  // open addressing, NULL for an empty slot
+  int capacity;
+  int length;
+} Store;
 
 struct SymbolTable_t {
   struct SymbolTable_t* outer;
-  Store* store;
+  Store store;
   int num_definitions;
   Symbol* free_symbols[MAX_FREE_VARIABLES];
 };
 
-int symbol_char_hash(char ch);
-static void symbol_put(HashNode* node, Symbol* symbol, int char_idx);
-static Symbol* symbol_get(HashNode* node, char* name);
-static HashNode* new_node(Symbol*);
+static void symbol_put(Store* store, Symbol* symbol);
+static Symbol* symbol_get(Store* store, char* name);
 static Symbol* define_free(SymbolTable t, Symbol* original);
 
 static Symbol* new_symbol(char* name, int index, SymbolScope scope) {
   Symbol* symbol = malloc(sizeof(Symbol));
-  symbol->name = strdup(name);
+  symbol->name = name;
   symbol->index = index;
   symbol->scope = scope;
   return symbol;
@@ -40,7 +36,8 @@ static Symbol* new_symbol(char* name, int index, SymbolScope scope) {
 SymbolTable symbol_table_new() {
   SymbolTable table = calloc(sizeof(struct SymbolTable_t), 1);
   table->num_definitions = 0;
-  table->store = new_node(NULL);
+  table->store.capacity = INITIAL_STORE_CAPACITY;
+  table->store.symbols = calloc(INITIAL_STORE_CAPACITY, sizeof(Symbol*));
   return table;
 }
 
@@ -53,7 +50,7 @@ SymbolTable symbol_table_new_enclosed(SymbolTable outer) {
 Symbol* symbol_table_define(SymbolTable t, char* name) {
   SymbolScope scope = t->outer == NULL ? SCOPE_GLOBAL : SCOPE_LOCAL;
   Symbol* symbol = new_symbol(name, t->num_definitions, scope);
-  symbol_put(t->store, symbol, 0);
+  symbol_put(&t->store, symbol);
   t->num_definitions++;
   return symbol;
 }
@@ -63,25 +60,25 @@ static Symbol* define_free(SymbolTable t, Symbol* original) {
   while (t->free_symbols[index] != NULL) index++;
   t->free_symbols[index] = original;
   Symbol* symbol = new_symbol(original->name, index, SCOPE_FREE);
-  symbol_put(t->store, symbol, 0);
+  symbol_put(&t->store, symbol);
   t->num_definitions++;
   return symbol;
 }
 
 Symbol* symbol_table_define_builtin(SymbolTable t, int index, char* name) {
   Symbol* symbol = new_symbol(name, index, SCOPE_BUILTIN);
-  symbol_put(t->store, symbol, 0);
+  symbol_put(&t->store, symbol);
   return symbol;
 }
 
 Symbol* symbol_table_define_fn_name(SymbolTable t, char* name) {
   Symbol* symbol = new_symbol(name, 0, SCOPE_FUNCTION);
-  symbol_put(t->store, symbol, 0);
+  symbol_put(&t->store, symbol);
   return symbol;
 }
 
 Symbol* symbol_table_resolve(SymbolTable t, char* name) {
-  Symbol* resolved = symbol_get(t->store, name);
+  Symbol* resolved = symbol_get(&t->store, name);
   if (!resolved && t->outer) {
     resolved = symbol_table_resolve(t->outer, name);
     if (!resolved) {
@@ -112,47 +109,34 @@ char* symbol_scope_name(SymbolScope scope) {
   }
 }
 
-static void symbol_put(HashNode* node, Symbol* symbol, int char_idx) {
-  char ch = symbol->name[char_idx];
-  int hash = symbol_char_hash(ch);
-  bool is_last_char = char_idx == (int)strlen(symbol->name) - 1;
-  if (is_last_char) {
-    node->chars[hash] = new_node(symbol);
-    return;
-  } else if (node->chars[hash] == NULL) {
-    node->chars[hash] = new_node(NULL);
+static int store_slot(Store* store, char* name) {
+  int mask = store->capacity - 1;
+  int slot = (int)(((uintptr_t)name >> 3) * 2654435761u) & mask;
+  while (store->symbols[slot] && store->symbols[slot]->name != name)
+    slot = (slot + 1) & mask;
+  return slot;
+}
+
+// a redefinition replaces the symbol of the same name
+static void symbol_put(Store* store, Symbol* symbol) {
+  if ((store->length + 1) * 2 > store->capacity) {
+    Store grown = {calloc(store->capacity * 2, sizeof(Symbol*)),
+      store->capacity * 2, store->length};
+    for (int i = 0; i < store->capacity; i++)
+      if (store->symbols[i])
+        grown.symbols[store_slot(&grown, store->symbols[i]->name)] =
+          store->symbols[i];
+    free(store->symbols);
+    *store = grown;
   }
-  symbol_put(node->chars[hash], symbol, ++char_idx);
-}
-
-static Symbol* symbol_get(HashNode* node, char* name) {
-  char ch = *name;
-  int hash = symbol_char_hash(ch);
-  HashNode* char_node = node->chars[hash];
-  if (char_node == NULL)
-    return NULL;
-  if (strlen(name) != 1)
-    return symbol_get(char_node, ++name);
-  return char_node->symbol;
-}
-
-static HashNode* new_node(Symbol* symbol) {
-  HashNode* node = calloc(1, sizeof(HashNode));
-  node->symbol = symbol;
-  return node;
+  int slot = store_slot(store, symbol->name);
+  if (store->symbols[slot] == NULL)
+    store->length++;
+  store->symbols[slot] = symbol;
 }
 
-int symbol_char_hash(char ch) {
-  if (islower(ch))
-    return ch - 'a';
-  if (isupper(ch))
-    return ch - 'A' + 26;
-  if (isdigit(ch))
-    return ch - '0' + 52;
-  if (ch == '_')
-    return 62;
-  printf("Unexpected char for ident hashing: %c\n", ch);
-  exit(EXIT_FAILURE);
+static Symbol* symbol_get(Store* store, char* name) {
+  return store->symbols[store_slot(store, name)];
 }
 
 SymbolTable symbol_table_outer(SymbolTable table) {
@@ -164,12 +148,12 @@ int symbol_table_num_definitions(SymbolTable table) {
 }
 
 void symbol_table_define_builtins(SymbolTable table) {
-  symbol_table_define_builtin(table, BUILTIN_LEN, "len");
-  symbol_table_define_builtin(table, BUILTIN_FIRST, "first");
-  symbol_table_define_builtin(table, BUILTIN_REST, "rest");
-  symbol_table_define_builtin(table, BUILTIN_PUSH, "push");
-  symbol_table_define_builtin(table, BUILTIN_PUTS, "puts");
-  symbol_table_define_builtin(table, BUILTIN_LAST, "last");
+  symbol_table_define_builtin(table, BUILTIN_LEN, intern("len"));
+  symbol_table_define_builtin(table, BUILTIN_FIRST, intern("first"));
+  symbol_table_define_builtin(table, BUILTIN_REST, intern("rest"));
+  symbol_table_define_builtin(table, BUILTIN_PUSH, intern("push"));
+  symbol_table_define_builtin(table, BUILTIN_PUTS, intern("puts"));
+  symbol_table_define_builtin(table, BUILTIN_LAST, intern("last"));
 }
 
 int symbol_table_num_free(SymbolTable table) {
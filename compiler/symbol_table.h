@@ -20,6 +20,8 @@ typedef struct Symbol {
   int index;
 } Symbol;
 
+// names passed in must be interned (see utils/intern.h), as the lexer's
+// identifiers are: symbols are looked up by pointer, and keep the name as is
 SymbolTable symbol_table_new();
 SymbolTable symbol_table_new_enclosed(SymbolTable outer);
 Symbol* symbol_table_define(SymbolTable table, char* name);
@@ -3,34 +3,35 @@
 #include <stdlib.h>
 #include <string.h>
 #include "../test/test.h"
+#include "../utils/intern.h"
 
 void assert_symbol_is(Symbol* symbol, char* name, SymbolScope scope, int index,
   const char* test_name);
 
 void test_define(void) {
   SymbolTable global = symbol_table_new();
-  Symbol* abc = symbol_table_define(global, "abc");
+  Symbol* abc = symbol_table_define(global, intern("abc"));
   assert_symbol_is(abc, "abc", SCOPE_GLOBAL, 0, "test_define");
-  Symbol* a = symbol_table_define(global, "a");
+  Symbol* a = symbol_table_define(global, intern("a"));
   assert_symbol_is(a, "a", SCOPE_GLOBAL, 1, "test_define");
 }
 
 void test_scoped_define(void) {
   SymbolTable global = symbol_table_new();
-  Symbol* a = symbol_table_define(global, "a");
-  Symbol* b = symbol_table_define(global, "b");
+  Symbol* a = symbol_table_define(global, intern("a"));
+  Symbol* b = symbol_table_define(global, intern("b"));
   assert_symbol_is(a, "a", SCOPE_GLOBAL, 0, __func__);
   assert_symbol_is(b, "b", SCOPE_GLOBAL, 1, __func__);
 
   SymbolTable local_1 = symbol_table_new_enclosed(global);
-  Symbol* c = symbol_table_define(local_1, "c");
-  Symbol* d = symbol_table_define(local_1, "d");
+  Symbol* c = symbol_table_define(local_1, intern("c"));
+  Symbol* d = symbol_table_define(local_1, intern("d"));
   assert_symbol_is(c, "c", SCOPE_LOCAL, 0, __func__);
   assert_symbol_is(d, "d", SCOPE_LOCAL, 1, __func__);
 
   SymbolTable local_2 = symbol_table_new_enclosed(local_1);
-  Symbol* e = symbol_table_define(local_2, "e");
-  Symbol* f = symbol_table_define(local_2, "f");
+  Symbol* e = symbol_table_define(local_2, intern("e"));
+  Symbol* f = symbol_table_define(local_2, intern("f"));
   assert_symbol_is(e, "e", SCOPE_LOCAL, 0, __func__);
   assert_symbol_is(f, "f", SCOPE_LOCAL, 1, __func__);
 }
@@ -38,17 +39,17 @@ void test_scoped_define(void) {
 void test_resolve(void) {
   char* t = "test_resolve";
   SymbolTable global = symbol_table_new();
-  symbol_table_define(global, "a");
-  symbol_table_define(global, "b");
-  symbol_table_define(global, "bb");
-  symbol_table_define(global, "bbb");
-  symbol_table_define(global, "abc");
-  Symbol* a = symbol_table_resolve(global, "a");
-  Symbol* b = symbol_table_resolve(global, "b");
-  Symbol* bb = symbol_table_resolve(global, "bb");
-  Symbol* bbb = symbol_table_resolve(global, "bbb");
-  Symbol* abc = symbol_table_resolve(global, "abc");
-  Symbol* unknown = symbol_table_resolve(global, "unknown");
+  symbol_table_define(global, intern("a"));
+  symbol_table_define(global, intern("b"));
+  symbol_table_define(global, intern("bb"));
+  symbol_table_define(global, intern("bbb"));
+  symbol_table_define(global, intern("abc"));
+  Symbol* a = symbol_table_resolve(global, intern("a"));
+  Symbol* b = symbol_table_resolve(global, intern("b"));
+  Symbol* bb = symbol_table_resolve(global, intern("bb"));
+  Symbol* bbb = symbol_table_resolve(global, intern("bbb"));
+  Symbol* abc = symbol_table_resolve(global, intern("abc"));
+  Symbol* unknown = symbol_table_resolve(global, intern("unknown"));
   assert_symbol_is(a, "a", SCOPE_GLOBAL, 0, t);
   assert_symbol_is(b, "b", SCOPE_GLOBAL, 1, t);
   assert_symbol_is(bb, "bb", SCOPE_GLOBAL, 2, t);
@@ -59,15 +60,15 @@ void test_resolve(void) {
 
 void test_resolve_local(void) {
   SymbolTable global = symbol_table_new();
-  symbol_table_define(global, "a");
-  symbol_table_define(global, "b");
+  symbol_table_define(global, intern("a"));
+  symbol_table_define(global, intern("b"));
   SymbolTable local = symbol_table_new_enclosed(global);
-  symbol_table_define(local, "c");
-  symbol_table_define(local, "d");
-  Symbol* a = symbol_table_resolve(local, "a");
-  Symbol* b = symbol_table_resolve(local, "b");
-  Symbol* c = symbol_table_resolve(local, "c");
-  Symbol* d = symbol_table_resolve(local, "d");
+  symbol_table_define(local, intern("c"));
+  symbol_table_define(local, intern("d"));
+  Symbol* a = symbol_table_resolve(local, intern("a"));
+  Symbol* b = symbol_table_resolve(local, intern("b"));
+  Symbol* c = symbol_table_resolve(local, intern("c"));
+  Symbol* d = symbol_table_resolve(local, intern("d"));
   assert_symbol_is(a, "a", SCOPE_GLOBAL, 0, __func__);
   assert_symbol_is(b, "b", SCOPE_GLOBAL, 1, __func__);
   assert_symbol_is(c, "c", SCOPE_LOCAL, 0, __func__);
@@ -76,28 +77,28 @@ void test_resolve_local(void) {
 
 void test_resolve_nested_local(void) {
   SymbolTable global = symbol_table_new();
-  symbol_table_define(global, "a");
-  symbol_table_define(global, "b");
+  symbol_table_define(global, intern("a"));
+  symbol_table_define(global, intern("b"));
   SymbolTable local_1 = symbol_table_new_enclosed(global);
-  symbol_table_define(local_1, "c");
-  symbol_table_define(local_1, "d");
+  symbol_table_define(local_1, intern("c"));
+  symbol_table_define(local_1, intern("d"));
   SymbolTable local_2 = symbol_table_new_enclosed(local_1);
-  symbol_table_define(local_2, "e");
-  symbol_table_define(local_2, "f");
+  symbol_table_define(local_2, intern("e"));
+  symbol_table_define(local_2, intern("f"));
 
-  Symbol* a = symbol_table_resolve(local_1, "a");
-  Symbol* b = symbol_table_resolve(local_1, "b");
-  Symbol* c = symbol_table_resolve(local_1, "c");
-  Symbol* d = symbol_table_resolve(local_1, "d");
+  Symbol* a = symbol_table_resolve(local_1, intern("a"));
+  Symbol* b = symbol_table_resolve(local_1, intern("b"));
+  Symbol* c = symbol_table_resolve(local_1, intern("c"));
+  Symbol* d = symbol_table_resolve(local_1, intern("d"));
   assert_symbol_is(a, "a", SCOPE_GLOBAL, 0, __func__);
   assert_symbol_is(b, "b", SCOPE_GLOBAL, 1, __func__);
   assert_symbol_is(c, "c", SCOPE_LOCAL, 0, __func__);
   assert_symbol_is(d, "d", SCOPE_LOCAL, 1, __func__);
 
-  a = symbol_table_resolve(local_2, "a");
-  b = symbol_table_resolve(local_2, "b");
-  Symbol* e = symbol_table_resolve(local_2, "e");
-  Symbol* f = symbol_table_resolve(local_2, "f");
+  a = symbol_table_resolve(local_2, intern("a"));
+  b = symbol_table_resolve(local_2, intern("b"));
+  Symbol* e = symbol_table_resolve(local_2, intern("e"));
+  Symbol* f = symbol_table_resolve(local_2, intern("f"));
   assert_symbol_is(a, "a", SCOPE_GLOBAL, 0, __func__);
   assert_symbol_is(b, "b", SCOPE_GLOBAL, 1, __func__);
   assert_symbol_is(e, "e", SCOPE_LOCAL, 0, __func__);
@@ -109,14 +110,14 @@ void test_define_resolve_builtins(void) {
   SymbolTable local_1 = symbol_table_new_enclosed(global);
   SymbolTable local_2 = symbol_table_new_enclosed(local_1);
   SymbolTable tables[] = {global, local_1, local_2};
-  symbol_table_define_builtin(global, 0, "a");
-  symbol_table_define_builtin(global, 1, "b");
-  symbol_table_define_builtin(global, 2, "c");
+  symbol_table_define_builtin(global, 0, intern("a"));
+  symbol_table_define_builtin(global, 1, intern("b"));
+  symbol_table_define_builtin(global, 2, intern("c"));
 
   for (int i = 0; i < LEN(tables); i++) {
-    Symbol* a = symbol_table_resolve(tables[i], "a");
-    Symbol* b = symbol_table_resolve(tables[i], "b");
-    Symbol* c = symbol_table_resolve(tables[i], "c");
+    Symbol* a = symbol_table_resolve(tables[i], intern("a"));
+    Symbol* b = symbol_table_resolve(tables[i], intern("b"));
+    Symbol* c = symbol_table_resolve(tables[i], intern("c"));
     assert_symbol_is(a, "a", SCOPE_BUILTIN, 0, __func__);
     assert_symbol_is(b, "b", SCOPE_BUILTIN, 1, __func__);
     assert_symbol_is(c, "c", SCOPE_BUILTIN, 2, __func__);
@@ -125,19 +126,19 @@ void test_define_resolve_builtins(void) {
 
 void test_resolve_free(void) {
   SymbolTable global = symbol_table_new();
-  symbol_table_define(global, "a");
-  symbol_table_define(global, "b");
+  symbol_table_define(global, intern("a"));
+  symbol_table_define(global, intern("b"));
   SymbolTable local_1 = symbol_table_new_enclosed(global);
-  symbol_table_define(local_1, "c");
-  symbol_table_define(local_1, "d");
+  symbol_table_define(local_1, intern("c"));
+  symbol_table_define(local_1, intern("d"));
   SymbolTable local_2 = symbol_table_new_enclosed(local_1);
-  symbol_table_define(local_2, "e");
-  symbol_table_define(local_2, "f");
+  symbol_table_define(local_2, intern("e"));
+  symbol_table_define(local_2, intern("f"));
 
-  Symbol* a = symbol_table_resolve(local_1, "a");
-  Symbol* b = symbol_table_resolve(local_1, "b");
-  Symbol* c = symbol_table_resolve(local_1, "c");
-  Symbol* d = symbol_table_resolve(local_1, "d");
+  Symbol* a = symbol_table_resolve(local_1, intern("a"));
+  Symbol* b = symbol_table_resolve(local_1, intern("b"));
+  Symbol* c = symbol_table_resolve(local_1, intern("c"));
+  Symbol* d = symbol_table_resolve(local_1, intern("d"));
   assert_symbol_is(a, "a", SCOPE_GLOBAL, 0, __func__);
   assert_symbol_is(b, "b", SCOPE_GLOBAL, 1, __func__);
   assert_symbol_is(c, "c", SCOPE_LOCAL, 0, __func__);
@@ -145,12 +146,12 @@ void test_resolve_free(void) {
   assert_int_is(
     0, symbol_table_num_free(local_1), "correct num free symbols", __func__);
 
-  a = symbol_table_resolve(local_2, "a");
-  b = symbol_table_resolve(local_2, "b");
-  c = symbol_table_resolve(local_2, "c");
-  d = symbol_table_resolve(local_2, "d");
-  Symbol* e = symbol_table_resolve(local_2, "e");
-  Symbol* f = symbol_table_resolve(local_2, "f");
+  a = symbol_table_resolve(local_2, intern("a"));
+  b = symbol_table_resolve(local_2, intern("b"));
+  c = symbol_table_resolve(local_2, intern("c"));
+  d = symbol_table_resolve(local_2, intern("d"));
+  Symbol* e = symbol_table_resolve(local_2, intern("e"));
+  Symbol* f = symbol_table_resolve(local_2, intern("f"));
   assert_symbol_is(a, "a", SCOPE_GLOBAL, 0, __func__);
   assert_symbol_is(b, "b", SCOPE_GLOBAL, 1, __func__);
   assert_symbol_is(c, "c", SCOPE_FREE, 0, __func__);
@@ -168,52 +169,58 @@ void test_resolve_free(void) {
 
 void test_unresolvable_free(void) {
   SymbolTable global = symbol_table_new();
-  symbol_table_define(global, "a");
+  symbol_table_define(global, intern("a"));
   SymbolTable local_1 = symbol_table_new_enclosed(global);
-  symbol_table_define(local_1, "c");
+  symbol_table_define(local_1, intern("c"));
   SymbolTable local_2 = symbol_table_new_enclosed(local_1);
-  symbol_table_define(local_2, "e");
-  symbol_table_define(local_2, "f");
+  symbol_table_define(local_2, intern("e"));
+  symbol_table_define(local_2, intern("f"));
 
-  Symbol* a = symbol_table_resolve(local_2, "a");
-  Symbol* c = symbol_table_resolve(local_2, "c");
-  Symbol* e = symbol_table_resolve(local_2, "e");
-  Symbol* f = symbol_table_resolve(local_2, "f");
+  Symbol* a = symbol_table_resolve(local_2, intern("a"));
+  Symbol* c = symbol_table_resolve(local_2, intern("c"));
+  Symbol* e = symbol_table_resolve(local_2, intern("e"));
+  Symbol* f = symbol_table_resolve(local_2, intern("f"));
   assert_symbol_is(a, "a", SCOPE_GLOBAL, 0, __func__);
   assert_symbol_is(c, "c", SCOPE_FREE, 0, __func__);
   assert_symbol_is(e, "e", SCOPE_LOCAL, 0, __func__);
   assert_symbol_is(f, "f", SCOPE_LOCAL, 1, __func__);
 
-  Symbol* b = symbol_table_resolve(local_2, "b");
+  Symbol* b = symbol_table_resolve(local_2, intern("b"));
   assert(b == NULL, "b should be unresolvable", __func__);
-  Symbol* d = symbol_table_resolve(local_2, "d");
+  Symbol* d = symbol_table_resolve(local_2, intern("d"));
   assert(d == NULL, "d should be unresolvable", __func__);
 }
 
 void test_define_resolve_fn_name(void) {
   SymbolTable global = symbol_table_new();
-  symbol_table_define_fn_name(global, "a");
-  Symbol* a = symbol_table_resolve(global, "a");
+  symbol_table_define_fn_name(global, intern("a"));
+  Symbol* a = symbol_table_resolve(global, intern("a"));
   assert_symbol_is(a, "a", SCOPE_FUNCTION, 0, __func__);
 }
 
 void test_define_resolve_shadowing_fn_name(void) {
   SymbolTable global = symbol_table_new();
-  symbol_table_define_fn_name(global, "a");
-  symbol_table_define(global, "a");
-  Symbol* a = symbol_table_resolve(global, "a");
+  symbol_table_define_fn_name(global, intern("a"));
+  symbol_table_define(global, intern("a"));
+  Symbol* a = symbol_table_resolve(global, intern("a"));
   assert_symbol_is(a, "a", SCOPE_GLOBAL, 0, __func__);
 }
 
-void test_char_hash(void) {
-  char* t = "char_hash";
-  int symbol_char_hash(char ch);
-  assert_int_is(0, symbol_char_hash('a'), "a should be 0", t);
-  assert_int_is(1, symbol_char_hash('b'), "b should be 1", t);
-  assert_int_is(26, symbol_char_hash('A'), "A should be 26", t);
-  assert_int_is(52, symbol_char_hash('0'), "0 should be 52", t);
-  assert_int_is(53, symbol_char_hash('1'), "1 should be 53", t);
-  assert_int_is(62, symbol_char_hash('_'), "_ should be 62", t);
+void test_interned_names(void) {
+  char* t = "interned_names";
+  char name[] = "abc";
+  assert(intern(name) == intern("abc"), "equal names intern alike", t);
+  assert(intern_n("abcd", 3) == intern("abc"), "a prefix interns alike", t);
+  assert(intern("ab") != intern("abc"), "different names differ", t);
+
+  SymbolTable global = symbol_table_new();
+  for (int i = 0; i < 100; i++)  // past the initial capacity
+    symbol_table_define(global, intern(ss("x_%d", i)));
+  Symbol* abc = symbol_table_define(global, intern(name));
+  assert(abc->name == intern("abc"), "symbol keeps the interned name", t);
+  assert(symbol_table_resolve(global, intern("abc")) == abc, "resolves", t);
+  assert(symbol_table_resolve(global, intern("x_42"))->index == 42,
+    "resolves after growing", t);
 }
 
 int main(int argc, char** argv) {
@@ -226,7 +233,7 @@ int main(int argc, char** argv) {
   test_scoped_define();
   test_resolve_local();
   test_resolve_nested_local();
-  test_char_hash();
+  test_interned_names();
   test_resolve();
   test_define();
   printf("\n");
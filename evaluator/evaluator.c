@@ -20,6 +20,7 @@ Object eval_index_expression(Object left, Object index);
 Object eval_array_index_expression(Object array, Object index);
 Object eval_hash_index_expression(Object hash, Object index);
 Object eval_hash_literal(HashLiteralExpression *hash_lit_exp, Env *env);
+Object eval_array_literal(ArrayLiteral *array_lit, Env *env);
 List *eval_expressions(List *expressions, Env *env);
 Object apply_function(Object fn, List *args);
 Object unwrap_return_value(Object obj);
@@ -28,7 +29,7 @@ Object error(char *fmt, char **types, int num_types);
 bool is_error(Object object);
 
 Object eval(void *node, NodeType type, Env *env) {
-  Object object = {INTEGER_OBJ, {0}};
+  Object object = {.type = INTEGER_OBJ, .value = {0}};
   switch (type) {
     case PROGRAM_NODE:
       return eval_program(((Program *)node)->statements, env);
@@ -108,18 +109,8 @@ Object eval(void *node, NodeType type, Env *env) {
           }
           return apply_function(fn, args);
         }
-        case EXPRESSION_ARRAY_LITERAL: {
-          ArrayLiteral *array = exp->node;
-          List *elements = eval_expressions(array->elements, env);
-          if (list_count(elements) > 0) {
-            Object *first_el = elements->item;
-            if (list_count(elements) == 1 && is_error(*first_el))
-              return *first_el;
-          }
-          object.type = ARRAY_OBJ;
-          object.value.list = elements;
-          return object;
-        }
+        case EXPRESSION_ARRAY_LITERAL:
+          return eval_array_literal(exp->node, env);
         case EXPRESSION_INDEX: {
           IndexExpression *ie = exp->node;
           Object left = eval(ie->left, EXPRESSION_NODE, env);
@@ -198,7 +189,7 @@ Object eval_minus_prefix_operator_expression(Object right) {
     return error("unknown operator: -%s", (char *[1]){object_type(right)}, 1);
   }
   int value = right.value.i;
-  Object object = {INTEGER_OBJ, {.i = value * -1}};
+  Object object = {.type = INTEGER_OBJ, .value = {.i = value * -1}};
   return object;
 }
 
@@ -241,7 +232,7 @@ Object eval_infix_expression(char *operator, Object left, Object right) {
 
 Object eval_integer_infix_expression(
   char *operator, Object left, Object right) {
-  Object object = {INTEGER_OBJ, {.i = 0}};
+  Object object = {.type = INTEGER_OBJ, .value = {.i = 0}};
   switch (*operator) {
     case '+':
       object.value.i = left.value.i + right.value.i;
@@ -276,7 +267,7 @@ Object eval_string_infix_expression(char *operator, Object left, Object right) {
   char *right_val = right.value.str;
   char *combined = malloc(strlen(left_val) + strlen(right_val) + 1);
   sprintf(combined, "%s%s", left_val, right_val);
-  return (Object){STRING_OBJ, {.str = combined}};
+  return (Object){.type = STRING_OBJ, .value = {.str = combined}};
 }
 
 Object eval_if_expression(IfExpression *if_exp, Env *env) {
@@ -307,7 +298,7 @@ Object error(char *fmt, char **types, int num_types) {
       printf("ERROR: unhandled error types amount\n");
       exit(EXIT_FAILURE);
   }
-  Object error = {ERROR_OBJ, {.str = err_msg}};
+  Object error = {.type = ERROR_OBJ, .value = {.str = err_msg}};
   return error;
 }
 
@@ -354,7 +345,12 @@ Object apply_function(Object fn_obj, List *args) {
   }
 
   if (fn_obj.type == BUILT_IN_OBJ) {
-    return (fn_obj.value.builtin_fn)(args);
+    int num_args = list_count(args);
+    Value arg_values[num_args > 0 ? num_args : 1];
+    List *current = args;
+    for (int i = 0; i < num_args; i++, current = current->next)
+      arg_values[i] = value_from(current->item);
+    return value_to_object((fn_obj.value.builtin_fn)(arg_values, num_args));
   }
 
   return error("not a function: %s", (char *[1]){object_type(fn_obj)}, 1);
@@ -399,46 +395,48 @@ Object eval_index_expression(Object left, Object index) {
 }
 
 Object eval_array_index_expression(Object array, Object index) {
-  List *elements = array.value.list;
+  Array *elements = array.value.array;
   int idx = index.value.i;
-  int max = list_count(elements) - 1;
 
-  if (idx < 0 || idx > max)
+  if (idx < 0 || idx >= elements->length)
     return M_NULL;
 
-  List *current = elements;
-  int i = 0;
-  while (true) {
-    if (i == idx) {
-      Object *obj = current->item;
-      return *obj;
+  return value_to_object(array_get(elements, idx));
+}
+
+Object eval_array_literal(ArrayLiteral *array_lit, Env *env) {
+  Value *elements = malloc(list_count(array_lit->elements) * sizeof(Value));
+  int length = 0;
+  List *current = array_lit->elements;
+  for (; current != NULL; current = current->next) {
+    if (current->item != NULL) {
+      Object element = eval(current->item, EXPRESSION_NODE, env);
+      if (is_error(element))
+        return element;
+      elements[length++] = value_from_copy(element);
     }
-    current = current->next;
-    i += 1;
   }
+  Array *array = array_from(elements, length);
+  free(elements);
+  return (Object){.type = ARRAY_OBJ, .value = {.array = array}};
 }
 
 Object eval_hash_index_expression(Object hash, Object index) {
-  char *index_hash = object_hash(index);
-  if (index_hash == NULL)
+  Value key = value_from(&index);
+  if (!object_hashable(key))
     return error(
       "unusable as hash key: %s", (char *[1]){object_type(index)}, 1);
 
-  List *current = hash.value.list;
-  for (; current != NULL; current = current->next) {
-    HashPair *pair = current->item;
-    char *key_hash = object_hash(*pair->key);
-    if (strcmp(key_hash, index_hash) == 0)
-      return *pair->value;
-  }
-  return M_NULL;
+  HashEntry *entry = hash_get(hash.value.hash, key);
+  if (entry == NULL)
+    return M_NULL;
+  return value_to_object(entry->value);
 }
 
 Object eval_hash_literal(HashLiteralExpression *hash_lit_exp, Env *env) {
   List *exp_pairs = hash_lit_exp->pairs;  // List<HashLiteralPair>
-  List *obj_pairs = NULL;                 // List<Object>
-
   int num_pairs = list_count(exp_pairs);
+  Hash *hash = hash_new(num_pairs);
   List *current = exp_pairs;
 
   for (int i = 0; i < num_pairs; i++) {
@@ -447,7 +445,7 @@ Object eval_hash_literal(HashLiteralExpression *hash_lit_exp, Env *env) {
     if (is_error(key))
       return key;
 
-    if (object_hash(key) == NULL)
+    if (!object_hashable(value_from(&key)))
       return error(
         "unusable as hash key: %s", (char *[1]){object_type(key)}, 1);
 
@@ -455,13 +453,10 @@ Object eval_hash_literal(HashLiteralExpression *hash_lit_exp, Env *env) {
     if (is_error(value))
       return value;
 
-    HashPair *obj_pair = malloc(sizeof(HashPair));
-    obj_pair->key = object_copy(key);
-    obj_pair->value = object_copy(value);
-    obj_pairs = list_append(obj_pairs, obj_pair);
+    hash_put(hash, value_from_copy(key), value_from_copy(value));
     current = current->next;
   }
 
-  Object hash_obj = {.type = HASH_OBJ, .value = {.list = obj_pairs}};
+  Object hash_obj = {.type = HASH_OBJ, .value = {.hash = hash}};
   return hash_obj;
 }
@@ -305,14 +305,11 @@ void test_array_literals(void) {
   char *t = "array_literals";
   Object evaluated = eval_test("[1, 2 * 2, 3 + 3]");
   assert_int_is(ARRAY_OBJ, evaluated.type, "eval'd is array", t);
-  List *elements = evaluated.value.list;
-  assert_int_is(3, list_count(elements), "array.length = 3", t);
-  Object *first = elements->item;
-  assert_integer_object(1, *first, t);
-  Object *second = elements->next->item;
-  assert_integer_object(4, *second, t);
-  Object *third = elements->next->next->item;
-  assert_integer_object(6, *third, t);
+  Array *elements = evaluated.value.array;
+  assert_int_is(3, elements->length, "array.length = 3", t);
+  assert_integer_object(1, value_to_object(array_get(elements, 0)), t);
+  assert_integer_object(4, value_to_object(array_get(elements, 1)), t);
+  assert_integer_object(6, value_to_object(array_get(elements, 2)), t);
 }
 
 void test_array_index_expressions(void) {
@@ -353,34 +350,37 @@ void test_hash_literals(void) {
     "}";
 
   Object res = eval_test(input);
-  List *pairs = res.value.list;
+  Hash *hash = res.value.hash;
 
   assert_int_is(HASH_OBJ, res.type, "result should be hash", t);
-  assert_int_is(6, list_count(pairs), "should have 6 pairs", t);
-
-  HashPair *pair1 = pairs->item;
-  assert_str_is("one", pair1->key->value.str, "key one is \"one\"", t);
-  assert_integer_object(1, *pair1->value, t);
-
-  HashPair *pair2 = pairs->next->item;
-  assert_str_is("two", pair2->key->value.str, "key two is \"two\"", t);
-  assert_integer_object(2, *pair2->value, t);
-
-  HashPair *pair3 = pairs->next->next->item;
-  assert_str_is("three", pair3->key->value.str, "key three is \"three\"", t);
-  assert_integer_object(3, *pair3->value, t);
-
-  HashPair *pair4 = pairs->next->next->next->item;
-  assert_integer_object(4, *pair4->key, t);
-  assert_integer_object(4, *pair4->value, t);
-
-  HashPair *pair5 = pairs->next->next->next->next->item;
-  assert_boolean_object(*pair5->key, true, t);
-  assert_integer_object(5, *pair5->value, t);
-
-  HashPair *pair6 = pairs->next->next->next->next->next->item;
-  assert_boolean_object(*pair6->key, false, t);
-  assert_integer_object(6, *pair6->value, t);
+  assert_int_is(6, hash->length, "should have 6 pairs", t);
+
+  HashEntry *pair1 = &hash->entries[0];
+  assert_str_is("one", VALUE_AS_OBJ(pair1->key)->value.str,
+    "key one is \"one\"", t);
+  assert_integer_object(1, value_to_object(pair1->value), t);
+
+  HashEntry *pair2 = &hash->entries[1];
+  assert_str_is("two", VALUE_AS_OBJ(pair2->key)->value.str,
+    "key two is \"two\"", t);
+  assert_integer_object(2, value_to_object(pair2->value), t);
+
+  HashEntry *pair3 = &hash->entries[2];
+  assert_str_is("three", VALUE_AS_OBJ(pair3->key)->value.str,
+    "key three is \"three\"", t);
+  assert_integer_object(3, value_to_object(pair3->value), t);
+
+  HashEntry *pair4 = &hash->entries[3];
+  assert_integer_object(4, value_to_object(pair4->key), t);
+  assert_integer_object(4, value_to_object(pair4->value), t);
+
+  HashEntry *pair5 = &hash->entries[4];
+  assert_boolean_object(value_to_object(pair5->key), true, t);
+  assert_integer_object(5, value_to_object(pair5->value), t);
+
+  HashEntry *pair6 = &hash->entries[5];
+  assert_boolean_object(value_to_object(pair6->key), false, t);
+  assert_integer_object(6, value_to_object(pair6->value), t);
 }
 
 void test_hash_index_expressions(void) {
@@ -414,6 +414,14 @@ void test_hash_index_expressions(void) {
       "{false: 5}[false]",
       5,
     },
+    {
+      "{1: 1, 1: 2}[1]",
+      2,
+    },
+    {
+      "{\"a\": 1, \"b\": 2, \"c\": 3, \"d\": 4, \"e\": 5}[\"d\"]",
+      4,
+    },
   };
 
   for (int i = 0; i < LEN(tests); i++) {
@@ -1,149 +1,132 @@
+#include "lexer.h"
 #include <ctype.h>
 #include <stdbool.h>
-#include <stdlib.h>
 #include <string.h>
 #include "../token/token.h"
+#include "../utils/intern.h"
 
-#define MAX_SRC_LEN 4096
-#define MAX_STR_LEN 1024
-#define MAX_IDENTIFIER_LEN 100
-
-static char input[MAX_SRC_LEN];
-static int position = 0;
-static int read_position = 0;
-static int input_length = 0;
-static char ch;
 static bool is_letter(char);
 static bool is_number(char);
-static void read_char(void);
-static char peek_char(void);
-static void skip_whitespace(void);
-static char *read_identifier(void);
-static char *read_number();
-static char *char_to_str(char);
-static int lookup_ident(char *);
-static char *read_string(void);
-
-extern void lexer_push(char *pushed_src) {
-  int i, j;
-  int pushed_length = strlen(pushed_src);
-  for (i = input_length, j = 0; i < input_length + pushed_length; i++, j++)
-    input[i] = pushed_src[j];
-  input[i + 1] = '\0';
-  input_length += strlen(pushed_src);
-}
-
-extern void lexer_set(char *str) {
-  input_length = 0;
-  position = 0;
-  read_position = 0;
-  input[0] = '\0';
-  lexer_push(str);
-  read_char();
+static void read_char(Lexer *);
+static char peek_char(Lexer *);
+static void skip_whitespace(Lexer *);
+static Token *read_identifier(Lexer *);
+static char *read_number(Lexer *);
+static char *char_to_str(Lexer *, char);
+static Token *lookup_keyword(char *, size_t length);
+static char *read_string(Lexer *);
+static char *slice(Lexer *, size_t start);
+
+extern Lexer lexer_new(char *input, size_t length, Arena *arena) {
+  Lexer lexer = {.input = input, .length = length, .arena = arena};
+  read_char(&lexer);
+  return lexer;
 }
 
-extern Token *lexer_next_token() {
+extern Token *lexer_next(Lexer *lexer) {
   Token *tok;
-  skip_whitespace();
-  switch (ch) {
+  skip_whitespace(lexer);
+  switch (lexer->ch) {
     case '"':
-      tok = new_token(TOKEN_STRING, read_string());
+      tok = new_token(lexer->arena, TOKEN_STRING, read_string(lexer));
       break;
     case ':':
-      tok = new_token(TOKEN_COLON, ":");
+      tok = new_token(lexer->arena, TOKEN_COLON, ":");
       break;
     case ']':
-      tok = new_token(TOKEN_RIGHT_BRACKET, "]");
+      tok = new_token(lexer->arena, TOKEN_RIGHT_BRACKET, "]");
       break;
     case '[':
-      tok = new_token(TOKEN_LEFT_BRACKET, "[");
+      tok = new_token(lexer->arena, TOKEN_LEFT_BRACKET, "[");
       break;
     case '-':
-      tok = new_token(TOKEN_MINUS, "-");
+      tok = new_token(lexer->arena, TOKEN_MINUS, "-");
       break;
     case '/':
-      tok = new_token(TOKEN_SLASH, "/");
+      tok = new_token(lexer->arena, TOKEN_SLASH, "/");
       break;
     case '*':
-      tok = new_token(TOKEN_ASTERISK, "*");
+      tok = new_token(lexer->arena, TOKEN_ASTERISK, "*");
       break;
     case '<':
-      tok = new_token(TOKEN_LT, "<");
+      tok = new_token(lexer->arena, TOKEN_LT, "<");
       break;
     case '>':
-      tok = new_token(TOKEN_GT, ">");
+      tok = new_token(lexer->arena, TOKEN_GT, ">");
       break;
     case '=':
-      if (peek_char() == '=') {
-        tok = new_token(TOKEN_EQ, "==");
-        read_char();
+      if (peek_char(lexer) == '=') {
+        tok = new_token(lexer->arena, TOKEN_EQ, "==");
+        read_char(lexer);
       } else
-        tok = new_token(TOKEN_ASSIGN, "=");
+        tok = new_token(lexer->arena, TOKEN_ASSIGN, "=");
       break;
     case '!':
-      if (peek_char() == '=') {
-        tok = new_token(TOKEN_NOT_EQ, "!=");
-        read_char();
+      if (peek_char(lexer) == '=') {
+        tok = new_token(lexer->arena, TOKEN_NOT_EQ, "!=");
+        read_char(lexer);
       } else
-        tok = new_token(TOKEN_BANG, "!");
+        tok = new_token(lexer->arena, TOKEN_BANG, "!");
       break;
     case '+':
-      tok = new_token(TOKEN_PLUS, "+");
+      tok = new_token(lexer->arena, TOKEN_PLUS, "+");
       break;
     case '(':
-      tok = new_token(TOKEN_LEFT_PAREN, "(");
+      tok = new_token(lexer->arena, TOKEN_LEFT_PAREN, "(");
       break;
     case ')':
-      tok = new_token(TOKEN_RIGHT_PAREN, ")");
+      tok = new_token(lexer->arena, TOKEN_RIGHT_PAREN, ")");
       break;
     case '{':
-      tok = new_token(TOKEN_LEFT_BRACE, "{");
+      tok = new_token(lexer->arena, TOKEN_LEFT_BRACE, "{");
       break;
     case '}':
-      tok = new_token(TOKEN_RIGHT_BRACE, "}");
+      tok = new_token(lexer->arena, TOKEN_RIGHT_BRACE, "}");
       break;
     case ',':
-      tok = new_token(TOKEN_COMMA, ",");
+      tok = new_token(lexer->arena, TOKEN_COMMA, ",");
       break;
     case ';':
-      tok = new_token(TOKEN_SEMICOLON, ";");
+      tok = new_token(lexer->arena, TOKEN_SEMICOLON, ";");
       break;
     case 0:
-      tok = new_token(TOKEN_EOF, "");
+      tok = new_token(lexer->arena, TOKEN_EOF, "");
       break;
     default:
-      if (is_letter(ch)) {
-        char *ident = read_identifier();
-        return new_token(lookup_ident(ident), ident);
-      } else if (is_number(ch))
-        return new_token(TOKEN_INTEGER, read_number());
+      if (is_letter(lexer->ch))
+        return read_identifier(lexer);
+      else if (is_number(lexer->ch))
+        return new_token(lexer->arena, TOKEN_INTEGER, read_number(lexer));
       else
-        tok = new_token(TOKEN_ILLEGAL, char_to_str(ch));
+        tok = new_token(
+          lexer->arena, TOKEN_ILLEGAL, char_to_str(lexer, lexer->ch));
       break;
   }
 
-  read_char();
+  read_char(lexer);
   return tok;
 }
 
-static void read_char() {
-  if (read_position >= input_length)
-    ch = 0;
+static void read_char(Lexer *lexer) {
+  if (lexer->read_position >= lexer->length)
+    lexer->ch = 0;
   else
-    ch = input[read_position];
-  position = read_position;
-  read_position += 1;
+    lexer->ch = lexer->input[lexer->read_position];
+  lexer->position = lexer->read_position;
+  lexer->read_position += 1;
 }
 
-static char peek_char() {
-  if (read_position >= input_length)
+static char peek_char(Lexer *lexer) {
+  if (lexer->read_position >= lexer->length)
     return 0;
   else
-    return input[read_position];
+    return lexer->input[lexer->read_position];
 }
 
-static void skip_whitespace() {
-  while (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r') read_char();
+static void skip_whitespace(Lexer *lexer) {
+  while (lexer->ch == ' ' || lexer->ch == '\t' || lexer->ch == '\n' ||
+         lexer->ch == '\r')
+    read_char(lexer);
 }
 
 static bool is_number(char c) {
@@ -154,65 +137,67 @@ static bool is_letter(char c) {
   return c == '_' || isalpha(c);
 }
 
-static char *read_identifier() {
-  char *ident = malloc(MAX_IDENTIFIER_LEN);
-  char *loc = ident;
-  while (is_letter(ch)) {
-    *loc = ch;
-    loc += 1;
-    read_char();
-  }
-  *loc = '\0';
-  return ident;
+// keywords are shared tokens, identifiers get interned literals
+static Token *read_identifier(Lexer *lexer) {
+  size_t start = lexer->position;
+  while (is_letter(lexer->ch)) read_char(lexer);
+  char *ident = &lexer->input[start];
+  size_t length = lexer->position - start;
+  Token *keyword = lookup_keyword(ident, length);
+  if (keyword)
+    return keyword;
+  return new_token(lexer->arena, TOKEN_IDENTIFIER, intern_n(ident, length));
 }
 
-static int lookup_ident(char *ident) {
-  if (strcmp(ident, "let") == 0)
-    return TOKEN_LET;
-  if (strcmp(ident, "fn") == 0)
-    return TOKEN_FUNCTION;
-  if (strcmp(ident, "true") == 0)
-    return TOKEN_TRUE;
-  if (strcmp(ident, "false") == 0)
-    return TOKEN_FALSE;
-  if (strcmp(ident, "if") == 0)
-    return TOKEN_IF;
-  if (strcmp(ident, "else") == 0)
-    return TOKEN_ELSE;
-  if (strcmp(ident, "return") == 0)
-    return TOKEN_RETURN;
-  return TOKEN_IDENTIFIER;
+/**
+ * A perfect hash of the keywords, `(length + 2 * first + last) & 7`, which
+ * puts each in a slot of its own: an identifier is a keyword only if it's
+ * the one in its slot, so lookup is a hash and at most one compare. The
+ * slots were found by searching shifts of the first and last chars for
+ * a collision-free table; adding a keyword means searching again.
+ */
+static Token keywords[8] = {
+  [0] = {TOKEN_RETURN, "return"},
+  [1] = {TOKEN_TRUE, "true"},
+  [2] = {TOKEN_IF, "if"},
+  [3] = {TOKEN_ELSE, "else"},
+  [4] = {TOKEN_FUNCTION, "fn"},
+  [6] = {TOKEN_FALSE, "false"},
+  [7] = {TOKEN_LET, "let"},
+};
+
+static Token *lookup_keyword(char *ident, size_t length) {
+  size_t slot = (length + 2 * ident[0] + ident[length - 1]) & 7;
+  Token *keyword = &keywords[slot];
+  if (keyword->literal && strncmp(keyword->literal, ident, length) == 0 &&
+      keyword->literal[length] == '\0')
+    return keyword;
+  return NULL;
 }
 
-static char *read_number() {
-  char *num = malloc(MAX_IDENTIFIER_LEN);
-  char *current = num;
-  while (is_number(ch)) {
-    *current = ch;
-    current += 1;
-    read_char();
-  }
-  *current = '\0';
-  return num;
+static char *read_number(Lexer *lexer) {
+  size_t start = lexer->position;
+  while (is_number(lexer->ch)) read_char(lexer);
+  return slice(lexer, start);
 }
 
-static char *read_string(void) {
-  char *string = malloc(MAX_STR_LEN);
-  int pos = 0;
-  while (true) {
-    read_char();
-    if (ch == '"' || ch == 0) {
-      break;
-    }
-    string[pos] = ch;
-    pos += 1;
-  }
-  string[pos] = '\0';
-  return string;
+// leaves the lexer on the closing quote
+static char *read_string(Lexer *lexer) {
+  size_t start = lexer->position + 1;
+  do
+    read_char(lexer);
+  while (lexer->ch != '"' && lexer->ch != 0);
+  return slice(lexer, start);
+}
+
+// the input from `start` up to the current char, as a new string
+static char *slice(Lexer *lexer, size_t start) {
+  return arena_strndup(
+    lexer->arena, &lexer->input[start], lexer->position - start);
 }
 
-static char *char_to_str(char c) {
-  char *str = malloc(2);
+static char *char_to_str(Lexer *lexer, char c) {
+  char *str = arena_alloc(lexer->arena, 2);
   str[0] = c;
   str[1] = '\0';
   return str;
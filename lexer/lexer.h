@@ -1,10 +1,24 @@
 #ifndef __LEXER_H__
 #define __LEXER_H__
 
+#include <stddef.h>
 #include "../token/token.h"
 
-void lexer_push(char *pushed_src);
-void lexer_set(char *str);
-Token *lexer_next_token();
+typedef struct Lexer {
+  char *input;
+  size_t length;
+  size_t position;       // of `ch`
+  size_t read_position;  // of the char after `ch`
+  char ch;
+  Arena *arena;  // where tokens and their literals are allocated
+} Lexer;
+
+/**
+ * A lexer reading `length` bytes of `input` in place: the input is never
+ * copied and needn't be NUL-terminated (an mmap'd file, say), so it has to
+ * outlive the lexer. Tokens and their literals come from `arena`.
+ */
+Lexer lexer_new(char *input, size_t length, Arena *arena);
+Token *lexer_next(Lexer *lexer);
 
 #endif  // __LEXER_H__
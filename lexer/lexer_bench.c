@@ -0,0 +1,64 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "lexer.h"
+
+// lexes a generated multi-megabyte source file straight out of an mmap
+#define SOURCE_SIZE (8 * 1024 * 1024)
+
+static char *chunk =
+  "let fibonacci = fn(x) {\n"
+  "  if (x == 0) { return 0; }\n"
+  "  if (x < 2) { 1 } else { fibonacci(x - 1) + fibonacci(x - 2) }\n"
+  "};\n"
+  "let people = [{\"name\": \"Anna\", \"age\": 24}, {\"name\": \"Bob\"}];\n"
+  "let total = reduce(map(people, fn(p) { p[\"age\"] * 2 }), 0, add);\n"
+  "puts(!true != false, total / 3 > -1);\n";
+
+static void generate_source(char *path) {
+  FILE *file = fopen(path, "w");
+  if (!file) {
+    printf("can't write %s\n", path);
+    exit(EXIT_FAILURE);
+  }
+  size_t length = strlen(chunk);
+  for (size_t size = 0; size < SOURCE_SIZE; size += length)
+    fputs(chunk, file);
+  fclose(file);
+}
+
+int main(void) {
+  char path[] = "/tmp/monkey_lexer_bench_XXXXXX";
+  close(mkstemp(path));
+  generate_source(path);
+
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  fstat(fd, &st);
+  char *source = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (source == MAP_FAILED) {
+    printf("can't mmap %s\n", path);
+    return EXIT_FAILURE;
+  }
+
+  clock_t start = clock();
+  Arena *arena = arena_new();
+  Lexer lexer = lexer_new(source, st.st_size, arena);
+  long num_tokens = 0;
+  while (lexer_next(&lexer)->type != TOKEN_EOF) num_tokens++;
+  double duration = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  double megabytes = (double)st.st_size / (1024 * 1024);
+  printf("lexed %ld tokens from %.1f MB in %fs (%.1f MB/s)\n", num_tokens,
+    megabytes, duration, megabytes / duration);
+  arena_free(arena);
+  munmap(source, st.st_size);
+  remove(path);
+  return EXIT_SUCCESS;
+}
@@ -5,6 +5,7 @@
 #include <string.h>
 #include "../test/test.h"
 #include "../utils/colors.h"
+#include "../utils/intern.h"
 
 void assert_lexing(char *, Token[], int, char *);
 
@@ -115,6 +116,28 @@ void test_more_keywords() {
   assert_lexing(input, expected, 5, "more_keywords");
 }
 
+// identifiers a keyword lookup must reject: keywords with a char added,
+// dropped or changed, some of them hashing to a keyword's slot
+void test_near_miss_keywords() {
+  char *input = "lett fn_ iff retur truee le f elsee fals lex fm returns";
+  Token expected[] = {
+    {TOKEN_IDENTIFIER, "lett"},
+    {TOKEN_IDENTIFIER, "fn_"},
+    {TOKEN_IDENTIFIER, "iff"},
+    {TOKEN_IDENTIFIER, "retur"},
+    {TOKEN_IDENTIFIER, "truee"},
+    {TOKEN_IDENTIFIER, "le"},
+    {TOKEN_IDENTIFIER, "f"},
+    {TOKEN_IDENTIFIER, "elsee"},
+    {TOKEN_IDENTIFIER, "fals"},
+    {TOKEN_IDENTIFIER, "lex"},
+    {TOKEN_IDENTIFIER, "fm"},
+    {TOKEN_IDENTIFIER, "returns"},
+    {TOKEN_EOF, ""},
+  };
+  assert_lexing(input, expected, LEN(expected), "near_miss_keywords");
+}
+
 void test_two_char_tokens() {
   char *input = "== !=";
   Token expected[] = {
@@ -139,6 +162,81 @@ void test_next_token(void) {
   assert_lexing(input, expected, LEN(expected), "text_token");
 }
 
+void test_unterminated_buffer(void) {
+  char *t = "unterminated_buffer";
+  // only the first 7 bytes are lexed, so `;` and the rest are never read
+  char input[] = {'l', 'e', 't', ' ', 'x', ' ', '=', ';', 'y'};
+  Lexer lexer = lexer_new(input, 7, arena_new());
+  Token expected[] = {
+    {TOKEN_LET, "let"},
+    {TOKEN_IDENTIFIER, "x"},
+    {TOKEN_ASSIGN, "="},
+    {TOKEN_EOF, ""},
+  };
+  for (int i = 0; i < LEN(expected); i++) {
+    Token *actual = lexer_next(&lexer);
+    assert_int_is(expected[i].type, actual->type, "token type", t);
+    assert_str_is(expected[i].literal, actual->literal, "token literal", t);
+  }
+}
+
+void test_interned_identifiers(void) {
+  char *t = "interned_identifiers";
+  char name[] = "name";
+  char same[] = "name";
+  assert(intern(name) == intern(same), "equal strings intern alike", t);
+  assert(strcmp(intern(name), "name") == 0, "interned copy", t);
+  assert(intern("names") != intern(name), "different strings differ", t);
+
+  // no NUL anywhere, so only `length` bytes may be read
+  char unterminated[] = {'n', 'a', 'm', 'e', 's'};
+  assert(intern_n(unterminated, 4) == intern(name), "prefix interns alike", t);
+  assert(intern_n(unterminated, 5) == intern("names"), "whole buffer", t);
+
+  // names interned before the table grows keep their pointers
+  char *first = intern("first_name");
+  for (int i = 0; i < 1000; i++)
+    intern(si("name_%d", i));
+  assert(intern("first_name") == first, "stable across growth", t);
+
+  char input[] = "foo bar foo";
+  Lexer lexer = lexer_new(input, strlen(input), arena_new());
+  char *foo = lexer_next(&lexer)->literal;
+  char *bar = lexer_next(&lexer)->literal;
+  assert(lexer_next(&lexer)->literal == foo, "same identifier, same name", t);
+  assert(foo == intern("foo") && bar == intern("bar"), "lexed names", t);
+}
+
+void test_large_input(void) {
+  char *t = "large_input";
+  int num_statements = 10000;
+  char *statement = "let x = \"foo\";\n";
+  size_t length = strlen(statement) * num_statements;
+  char *input = malloc(length + 2000 + 1);
+  for (int i = 0; i < num_statements; i++)
+    strcpy(&input[i * strlen(statement)], statement);
+  // a string and an identifier longer than any fixed literal buffer
+  input[length] = '"';
+  memset(&input[length + 1], 's', 998);
+  input[length + 999] = '"';
+  memset(&input[length + 1000], 'i', 1000);
+  input[length + 2000] = '\0';
+
+  Lexer lexer = lexer_new(input, strlen(input), arena_new());
+  int num_lets = 0;
+  Token *tok;
+  for (int i = 0; i < num_statements * 5; i++)
+    num_lets += lexer_next(&lexer)->type == TOKEN_LET;
+  assert_int_is(num_statements, num_lets, "let statements", t);
+  tok = lexer_next(&lexer);
+  assert_int_is(TOKEN_STRING, tok->type, "long string", t);
+  assert_int_is(998, strlen(tok->literal), "long string length", t);
+  tok = lexer_next(&lexer);
+  assert_int_is(TOKEN_IDENTIFIER, tok->type, "long identifier", t);
+  assert_int_is(1000, strlen(tok->literal), "long identifier length", t);
+  assert_int_is(TOKEN_EOF, lexer_next(&lexer)->type, "eof", t);
+}
+
 int main(int argc, char **argv) {
   pass_argv(argc, argv);
   test_next_token();
@@ -148,7 +246,11 @@ int main(int argc, char **argv) {
   test_realistic_code();
   test_more_single_char_tokens();
   test_more_keywords();
+  test_near_miss_keywords();
   test_two_char_tokens();
+  test_unterminated_buffer();
+  test_interned_identifiers();
+  test_large_input();
   printf("\n");
   return 0;
 }
@@ -160,10 +262,10 @@ void assert_lexing(
   Token *actual;
   char msg[50];
 
-  lexer_set(input);
+  Lexer lexer = lexer_new(input, strlen(input), arena_new());
 
   for (i = 0; i < num_expected; i += 1) {
-    actual = lexer_next_token();
+    actual = lexer_next(&lexer);
     expected = expected_tokens[i];
     sprintf(msg, "Token type should be %s", token_type_name(expected.type));
     assert(actual->type == expected.type, msg, test_name);
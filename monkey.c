@@ -10,6 +10,10 @@ int main(int argc, char **argv) {
     run(argc, argv);
     exit(EXIT_SUCCESS);
   }
+  if (argv_idx("build", argc, argv) == 1) {
+    build(argc, argv);
+    exit(EXIT_SUCCESS);
+  }
 
   printf(COLOR_MAGENTA "\nWelcome to MONKEY\n" COLOR_RESET);
   printf(COLOR_GREY "Try out the language below...\n\n" COLOR_RESET);
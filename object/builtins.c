@@ -1,156 +1,125 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "../utils/list.h"
 #include "object.h"
 
-Object wrong_num_args_error(int got, int want);
-Object wrong_arg_type_error(char *fn, char *expected_type, Object arg);
+Value wrong_num_args_error(int got, int want);
+Value wrong_arg_type_error(char *fn, char *expected_type, Value arg);
 
-Object builtin_puts(List *args) {
-  for (List *cur = args; cur != NULL; cur = cur->next) {
-    Object *object = cur->item;
-    puts(object_inspect(*object));
-  }
-  return M_NULL;
+Value builtin_puts(Value *args, int num_args) {
+  for (int i = 0; i < num_args; i++)
+    puts(object_inspect(value_to_object(args[i])));
+  return VALUE_NULL;
 }
 
-Object builtin_len(List *args) {
-  if (list_count(args) != 1) {
-    return wrong_num_args_error(list_count(args), 1);
+Value builtin_len(Value *args, int num_args) {
+  if (num_args != 1) {
+    return wrong_num_args_error(num_args, 1);
   }
 
-  Object arg = *((Object *)args->item);
-  switch (arg.type) {
-    case STRING_OBJ:
-      return (Object){INTEGER_OBJ, {.i = strlen(arg.value.str)}};
-    case ARRAY_OBJ:
-      return (Object){INTEGER_OBJ, {.i = list_count(arg.value.list)}};
-    default: {
-      char *msg = malloc(100);
-      sprintf(msg, "argument to `len` not supported, got %s", object_type(arg));
-      Object err = {ERROR_OBJ, {.str = msg}};
-      return err;
-    }
-  }
+  Value arg = args[0];
+  if (VALUE_HAS_TYPE(arg, STRING_OBJ))
+    return VALUE_INT(strlen(VALUE_AS_OBJ(arg)->value.str));
+  if (VALUE_HAS_TYPE(arg, ARRAY_OBJ))
+    return VALUE_INT(VALUE_AS_OBJ(arg)->value.array->length);
+
+  Object *err = object_alloc(ERROR_OBJ);
+  err->value.str = malloc(100);
+  sprintf(err->value.str, "argument to `len` not supported, got %s",
+    value_type(arg));
+  return VALUE_OBJ(err);
 }
 
-Object builtin_first(List *args) {
-  if (list_count(args) != 1) {
-    return wrong_num_args_error(list_count(args), 1);
+Value builtin_first(Value *args, int num_args) {
+  if (num_args != 1) {
+    return wrong_num_args_error(num_args, 1);
   }
 
-  Object arg = *((Object *)args->item);
-  if (arg.type != ARRAY_OBJ) {
-    return wrong_arg_type_error("first", "ARRAY", arg);
+  if (!VALUE_HAS_TYPE(args[0], ARRAY_OBJ)) {
+    return wrong_arg_type_error("first", "ARRAY", args[0]);
   }
 
-  if (list_count(arg.value.list) > 0) {
-    Object *pi = arg.value.list->item;
-    return *pi;
+  Array *array = VALUE_AS_OBJ(args[0])->value.array;
+  if (array->length > 0) {
+    return array_get(array, 0);
   }
 
-  return M_NULL;
+  return VALUE_NULL;
 }
 
-Object builtin_last(List *args) {
-  if (list_count(args) != 1) {
-    return wrong_num_args_error(list_count(args), 1);
+Value builtin_last(Value *args, int num_args) {
+  if (num_args != 1) {
+    return wrong_num_args_error(num_args, 1);
   }
 
-  Object arg = *((Object *)args->item);
-  if (arg.type != ARRAY_OBJ) {
-    return wrong_arg_type_error("first", "ARRAY", arg);
+  if (!VALUE_HAS_TYPE(args[0], ARRAY_OBJ)) {
+    return wrong_arg_type_error("last", "ARRAY", args[0]);
   }
 
-  if (list_count(arg.value.list) == 0) {
-    return M_NULL;
+  Array *array = VALUE_AS_OBJ(args[0])->value.array;
+  if (array->length == 0) {
+    return VALUE_NULL;
   }
 
-  List *current = arg.value.list;
-  while (current != NULL && current->next != NULL) current = current->next;
-
-  Object *last = current->item;
-  return *last;
+  return array_get(array, array->length - 1);
 }
 
-Object builtin_rest(List *args) {
-  if (list_count(args) != 1) {
-    return wrong_num_args_error(list_count(args), 1);
+Value builtin_rest(Value *args, int num_args) {
+  if (num_args != 1) {
+    return wrong_num_args_error(num_args, 1);
   }
 
-  Object arg = *((Object *)args->item);
-  if (arg.type != ARRAY_OBJ) {
-    return wrong_arg_type_error("first", "ARRAY", arg);
+  if (!VALUE_HAS_TYPE(args[0], ARRAY_OBJ)) {
+    return wrong_arg_type_error("rest", "ARRAY", args[0]);
   }
 
-  if (list_count(arg.value.list) == 0) {
-    return M_NULL;
+  Array *array = VALUE_AS_OBJ(args[0])->value.array;
+  if (array->length == 0) {
+    return VALUE_NULL;
   }
 
-  List *current = arg.value.list->next;
-  List *rest = NULL;
-  while (current != NULL) {
-    Object *obj = current->item;
-    rest = list_append(rest, object_copy(*obj));
-    current = current->next;
-  }
-
-  Object new_array;
-  new_array.type = ARRAY_OBJ;
-  new_array.value.list = rest;
-  return new_array;
+  Object *new_array = object_alloc(ARRAY_OBJ);
+  new_array->value.array = array_rest(array);
+  return VALUE_OBJ(new_array);
 }
 
-Object builtin_push(List *args) {
-  if (list_count(args) != 2) {
-    return wrong_num_args_error(list_count(args), 2);
-  }
-
-  Object arr_obj = *((Object *)args->item);
-  if (arr_obj.type != ARRAY_OBJ) {
-    return wrong_arg_type_error("first", "ARRAY", arr_obj);
+Value builtin_push(Value *args, int num_args) {
+  if (num_args != 2) {
+    return wrong_num_args_error(num_args, 2);
   }
 
-  // copy the array
-  List *current = arr_obj.value.list;
-  List *new_list = NULL;
-  while (current != NULL) {
-    Object *obj = current->item;
-    new_list = list_append(new_list, object_copy(*obj));
-    current = current->next;
+  if (!VALUE_HAS_TYPE(args[0], ARRAY_OBJ)) {
+    return wrong_arg_type_error("push", "ARRAY", args[0]);
   }
 
-  // now push the new item
-  Object new_element = *((Object *)args->next->item);
-  new_list = list_append(new_list, object_copy(new_element));
-
-  Object new_arr_obj;
-  new_arr_obj.type = ARRAY_OBJ;
-  new_arr_obj.value.list = new_list;
-  return new_arr_obj;
+  Array *array = VALUE_AS_OBJ(args[0])->value.array;
+  Object *new_arr_obj = object_alloc(ARRAY_OBJ);
+  new_arr_obj->value.array = array_push(array, args[1]);
+  return VALUE_OBJ(new_arr_obj);
 }
 
 Object get_builtin(char *name) {
+  Object builtin = {.type = BUILT_IN_OBJ, .value = {0}};
   if (strcmp("len", name) == 0) {
-    return (Object){BUILT_IN_OBJ, {.builtin_fn = builtin_len}};
+    builtin.value.builtin_fn = builtin_len;
   } else if (strcmp("first", name) == 0) {
-    return (Object){BUILT_IN_OBJ, {.builtin_fn = builtin_first}};
+    builtin.value.builtin_fn = builtin_first;
   } else if (strcmp("rest", name) == 0) {
-    return (Object){BUILT_IN_OBJ, {.builtin_fn = builtin_rest}};
+    builtin.value.builtin_fn = builtin_rest;
   } else if (strcmp("push", name) == 0) {
-    return (Object){BUILT_IN_OBJ, {.builtin_fn = builtin_push}};
+    builtin.value.builtin_fn = builtin_push;
   } else if (strcmp("puts", name) == 0) {
-    return (Object){BUILT_IN_OBJ, {.builtin_fn = builtin_puts}};
+    builtin.value.builtin_fn = builtin_puts;
   } else if (strcmp("last", name) == 0) {
-    return (Object){BUILT_IN_OBJ, {.builtin_fn = builtin_last}};
+    builtin.value.builtin_fn = builtin_last;
+  } else {
+    return (Object){.type = NOT_FOUND_OBJ, .value = {.i = 0}};
   }
-  return (Object){NOT_FOUND_OBJ, {.i = 0}};
+  return builtin;
 }
 
 Object *get_builtin_by_index(BuiltinIndex index) {
-  Object *obj = malloc(sizeof(Object));
-  obj->type = BUILT_IN_OBJ;
+  Object *obj = object_alloc(BUILT_IN_OBJ);
   switch (index) {
     case BUILTIN_LEN:
       obj->value.builtin_fn = builtin_len;
@@ -177,17 +146,18 @@ Object *get_builtin_by_index(BuiltinIndex index) {
   return obj;
 }
 
-Object wrong_num_args_error(int got, int want) {
-  char *msg = malloc(100);
-  sprintf(msg, "wrong number of arguments. got=%d, want=%d", got, want);
-  Object err = {ERROR_OBJ, {.str = msg}};
-  return err;
+Value wrong_num_args_error(int got, int want) {
+  Object *err = object_alloc(ERROR_OBJ);
+  err->value.str = malloc(100);
+  sprintf(err->value.str, "wrong number of arguments. got=%d, want=%d", got,
+    want);
+  return VALUE_OBJ(err);
 }
 
-Object wrong_arg_type_error(char *fn, char *expected_type, Object arg) {
-  char *msg = malloc(100);
-  sprintf(msg, "argument to `%s` must be %s, got %s", fn, expected_type,
-    object_type(arg));
-  Object err = {ERROR_OBJ, {.str = msg}};
-  return err;
+Value wrong_arg_type_error(char *fn, char *expected_type, Value arg) {
+  Object *err = object_alloc(ERROR_OBJ);
+  err->value.str = malloc(100);
+  sprintf(err->value.str, "argument to `%s` must be %s, got %s", fn,
+    expected_type, value_type(arg));
+  return VALUE_OBJ(err);
 }
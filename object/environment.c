@@ -34,7 +34,7 @@ Object env_get(Env *env, char *name) {
   if (env->outer != NULL)
     return env_get(env->outer, name);
 
-  return (Object){NOT_FOUND_OBJ, {.i = 0}};
+  return (Object){.type = NOT_FOUND_OBJ, .value = {.i = 0}};
 }
 
 void env_set(Env *env, char *name, Object val) {
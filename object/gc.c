@@ -0,0 +1,171 @@
+#include <stdlib.h>
+#include <string.h>
+#include "object.h"
+
+#define HEAP_INITIAL_THRESHOLD (1024 * 1024)
+
+static Heap *active_heap = NULL;
+
+// marks from earlier collections are stale once the epoch moves on, so
+// objects no heap sweeps never need their marks cleared
+static uint32_t epoch = 0;
+
+void heap_init(Heap *heap) {
+  heap->objects = NULL;
+  heap->length = 0;
+  heap->capacity = 0;
+  heap->num_sized = 0;
+  heap->bytes = 0;
+  heap->next_collection = HEAP_INITIAL_THRESHOLD;
+  heap->gray = NULL;
+  heap->gray_capacity = 0;
+}
+
+void heap_activate(Heap *heap) {
+  active_heap = heap;
+}
+
+void heap_track(Object *object) {
+  Heap *heap = active_heap;
+  if (heap == NULL)
+    return;
+  if (heap->length == heap->capacity) {
+    heap->capacity = heap->capacity == 0 ? 256 : heap->capacity * 2;
+    heap->objects = realloc(heap->objects, heap->capacity * sizeof(Object *));
+  }
+  heap->objects[heap->length++] = object;
+}
+
+static long object_size(Object *object) {
+  long size = sizeof(Object);
+  switch (object->type) {
+    case STRING_OBJ:
+      return size + strlen(object->value.str) + 1;
+    case ARRAY_OBJ:
+      return size + sizeof(Array);
+    case ARRAY_NODE_OBJ:
+      return size + sizeof(ArrayNode);
+    case HASH_OBJ: {
+      Hash *hash = object->value.hash;
+      return size + sizeof(Hash) + hash->length * sizeof(HashEntry) +
+             hash->capacity * sizeof(int);
+    }
+    case CLOSURE_OBJ:
+      return size + sizeof(Closure) +
+             object->value.closure->num_free * sizeof(Value);
+    default:
+      return size;
+  }
+}
+
+bool heap_needs_collection(Heap *heap) {
+  // payloads are attached after object_alloc(), so size objects lazily
+  for (; heap->num_sized < heap->length; heap->num_sized++)
+    heap->bytes += object_size(heap->objects[heap->num_sized]);
+  return heap->bytes >= heap->next_collection;
+}
+
+void heap_begin_collection(void) {
+  epoch++;
+}
+
+static void gray_push(Heap *heap, int *length, Value value) {
+  if (!VALUE_IS_OBJ(value) || value == 0)  // unset globals are 0
+    return;
+  Object *object = VALUE_AS_OBJ(value);
+  if (object->marked == epoch)
+    return;
+  object->marked = epoch;
+  if (*length == heap->gray_capacity) {
+    heap->gray_capacity =
+      heap->gray_capacity == 0 ? 64 : heap->gray_capacity * 2;
+    heap->gray = realloc(heap->gray, heap->gray_capacity * sizeof(Object *));
+  }
+  heap->gray[(*length)++] = object;
+}
+
+void heap_mark(Heap *heap, Value value) {
+  int length = 0;
+  gray_push(heap, &length, value);
+  while (length > 0) {
+    Object *object = heap->gray[--length];
+    switch (object->type) {
+      case ARRAY_OBJ: {
+        Array *array = object->value.array;
+        if (array->root != NULL)
+          gray_push(heap, &length, VALUE_OBJ(array->root));
+        for (int i = 0; i < array->tail_length; i++)
+          gray_push(heap, &length, array->tail[i]);
+      } break;
+      case ARRAY_NODE_OBJ: {
+        ArrayNode *node = object->value.node;
+        for (int i = 0; i < ARRAY_NODE_WIDTH; i++)
+          gray_push(heap, &length, node->slots[i]);
+      } break;
+      case HASH_OBJ: {
+        Hash *hash = object->value.hash;
+        for (int i = 0; i < hash->length; i++) {
+          gray_push(heap, &length, hash->entries[i].key);
+          gray_push(heap, &length, hash->entries[i].value);
+        }
+      } break;
+      case CLOSURE_OBJ: {
+        Closure *closure = object->value.closure;
+        for (int i = 0; i < closure->num_free; i++)
+          gray_push(heap, &length, closure->free[i]);
+      } break;
+      case COMPILED_FUNCTION_OBJ: {
+        Object *cached = object->value.compiled_fn->closure;
+        if (cached != NULL)
+          gray_push(heap, &length, VALUE_OBJ(cached));
+      } break;
+      default:
+        break;
+    }
+  }
+}
+
+static void object_free(Object *object) {
+  switch (object->type) {
+    case STRING_OBJ:
+      free(object->value.str);
+      break;
+    case ARRAY_OBJ:
+      free(object->value.array);
+      break;
+    case ARRAY_NODE_OBJ:
+      free(object->value.node);
+      break;
+    case HASH_OBJ:
+      free(object->value.hash);
+      break;
+    case CLOSURE_OBJ:
+      free(object->value.closure);
+      break;
+    default:
+      break;
+  }
+  free(object);
+}
+
+long heap_sweep(Heap *heap) {
+  heap_needs_collection(heap);
+  long bytes_freed = 0;
+  int live = 0;
+  for (int i = 0; i < heap->length; i++) {
+    Object *object = heap->objects[i];
+    if (object->marked == epoch) {
+      heap->objects[live++] = object;
+    } else {
+      bytes_freed += object_size(object);
+      object_free(object);
+    }
+  }
+  heap->length = live;
+  heap->num_sized = live;
+  heap->bytes -= bytes_freed;
+  heap->next_collection = heap->bytes * 2;
+  if (heap->next_collection < HEAP_INITIAL_THRESHOLD)
+    heap->next_collection = HEAP_INITIAL_THRESHOLD;
+  return bytes_freed;
+}
@@ -5,12 +5,14 @@
 
 #define INSPECT_STR_LEN 1024
 char *function_inspect(Function *fn);
-char *array_inspect(List *elements);
-char *hash_inspect(List *pairs);
+char *array_inspect(Array *array);
+char *hash_inspect(Hash *hash);
 
-Object M_NULL = {NULL_OBJ, {0}};
-Object TRUE = {BOOLEAN_OBJ, {.b = true}};
-Object FALSE = {BOOLEAN_OBJ, {.b = false}};
+Object M_NULL = {.type = NULL_OBJ, .value = {0}};
+Object TRUE = {.type = BOOLEAN_OBJ, .value = {.b = true}};
+Object FALSE = {.type = BOOLEAN_OBJ, .value = {.b = false}};
+
+static long num_allocations[NUM_OBJECT_TYPES] = {0};
 
 char *object_inspect(const Object object) {
   char *inspect_str = malloc(INSPECT_STR_LEN);
@@ -28,11 +30,11 @@ char *object_inspect(const Object object) {
         object_inspect(*object.value.return_value));
       break;
     case ARRAY_OBJ:
-      return array_inspect(object.value.list);
+      return array_inspect(object.value.array);
     case FUNCTION_OBJ:
       return function_inspect(object.value.fn);
     case HASH_OBJ:
-      return hash_inspect(object.value.list);
+      return hash_inspect(object.value.hash);
     case NULL_OBJ:
       return "null";
     case BUILT_IN_OBJ:
@@ -76,6 +78,8 @@ char *object_type(const Object object) {
       return "COMPILED_FUNCTION_OBJ";
     case CLOSURE_OBJ:
       return "CLOSURE_OBJ";
+    case ARRAY_NODE_OBJ:
+      return "ARRAY_NODE";
     case ERROR_OBJ:
       return "ERROR";
   }
@@ -107,46 +111,40 @@ char *function_inspect(Function *fn) {
   return fn_inspect_str;
 }
 
-char *array_inspect(List *elements) {
+char *array_inspect(Array *array) {
   char *array_inspect_str = malloc(INSPECT_STR_LEN);
   array_inspect_str[0] = '[';
   array_inspect_str[1] = '\0';
-  int num_elements = list_count(elements);
-  List *current = elements;
-  for (int i = 0; i < num_elements; i++) {
-    Object *obj = current->item;
-    strcat(array_inspect_str, object_inspect(*obj));
-    if (i < num_elements - 1)
+  for (int i = 0; i < array->length; i++) {
+    Object element = value_to_object(array_get(array, i));
+    strcat(array_inspect_str, object_inspect(element));
+    if (i < array->length - 1)
       strcat(array_inspect_str, ", ");
-    current = current->next;
   }
   strcat(array_inspect_str, "]");
   return array_inspect_str;
 }
 
-char *hash_inspect(List *pairs) {
+char *hash_inspect(Hash *hash) {
   char *hash_str = malloc(INSPECT_STR_LEN);
-  strcat(hash_str, "{");
-  int num_elements = list_count(pairs);
-  List *current = pairs;
-  for (int i = 0; i < num_elements; i++) {
-    HashPair *pair = current->item;
-    strcat(hash_str, object_inspect(*pair->key));
+  hash_str[0] = '{';
+  hash_str[1] = '\0';
+  for (int i = 0; i < hash->length; i++) {
+    HashEntry *entry = &hash->entries[i];
+    strcat(hash_str, object_inspect(value_to_object(entry->key)));
     strcat(hash_str, ": ");
-    strcat(hash_str, object_inspect(*pair->value));
-    if (i < num_elements - 1)
+    strcat(hash_str, object_inspect(value_to_object(entry->value)));
+    if (i < hash->length - 1)
       strcat(hash_str, ", ");
-    current = current->next;
   }
   strcat(hash_str, "}");
   return hash_str;
 }
 
 Object *object_copy(const Object proto) {
-  Object *copy = malloc(sizeof(Object));
+  Object *copy = object_alloc(proto.type);
   if (copy == NULL)
     return NULL;
-  copy->type = proto.type;
   switch (proto.type) {
     case INTEGER_OBJ:
       copy->value.i = proto.value.i;
@@ -161,8 +159,10 @@ Object *object_copy(const Object proto) {
       copy->value.fn = proto.value.fn;
       break;
     case ARRAY_OBJ:
-    case HASH_OBJ: /* intentional fallthrough */
-      copy->value.list = proto.value.list;
+      copy->value.array = proto.value.array;
+      break;
+    case HASH_OBJ:
+      copy->value.hash = proto.value.hash;
       break;
     case NULL_OBJ:
       break;
@@ -177,26 +177,6 @@ Object *object_copy(const Object proto) {
   return copy;
 }
 
-char *object_hash(const Object object) {
-  char *hash;
-  switch (object.type) {
-    case STRING_OBJ:
-      hash = malloc(strlen(object.value.str) + 2);
-      sprintf(hash, "S=%s", object.value.str);
-      return hash;
-    case BOOLEAN_OBJ:
-      hash = malloc(8);
-      sprintf(hash, "B=%s", object.value.b ? "true" : "false");
-      return hash;
-    case INTEGER_OBJ:
-      hash = malloc(50);
-      sprintf(hash, "I=%d", object.value.i);
-      return hash;
-    default:
-      return NULL;
-  }
-}
-
 bool is_truthy(Object obj) {
   if (obj.type == NULL_OBJ)
     return false;
@@ -205,3 +185,359 @@ bool is_truthy(Object obj) {
   else
     return true;
 }
+
+Object *object_alloc(ObjectType type) {
+  Object *object = malloc(sizeof(Object));
+  if (object == NULL)
+    return NULL;
+  object->type = type;
+  object->marked = 0;
+  object->hash = 0;
+  num_allocations[type]++;
+  heap_track(object);
+  return object;
+}
+
+#define ARRAY_NODE_MASK (ARRAY_NODE_WIDTH - 1)
+
+static Object *array_node_new(void) {
+  Object *node = object_alloc(ARRAY_NODE_OBJ);
+  node->value.node = malloc(sizeof(ArrayNode));
+  for (int i = 0; i < ARRAY_NODE_WIDTH; i++)
+    node->value.node->slots[i] = VALUE_NULL;
+  return node;
+}
+
+static Object *array_node_copy(Object *node) {
+  Object *copy = object_alloc(ARRAY_NODE_OBJ);
+  copy->value.node = malloc(sizeof(ArrayNode));
+  *copy->value.node = *node->value.node;
+  return copy;
+}
+
+Array *array_new(void) {
+  Array *array = malloc(sizeof(Array));
+  array->length = 0;
+  array->offset = 0;
+  array->shift = ARRAY_NODE_BITS;
+  array->tail_length = 0;
+  array->root = NULL;
+  return array;
+}
+
+// builds the trie bottom up, in the same shape successive pushes would
+Array *array_from(Value *elements, int length) {
+  Array *array = array_new();
+  if (length == 0)
+    return array;
+  int tail_offset = ((length - 1) >> ARRAY_NODE_BITS) << ARRAY_NODE_BITS;
+  array->length = length;
+  array->tail_length = length - tail_offset;
+  memcpy(array->tail, &elements[tail_offset],
+    array->tail_length * sizeof(Value));
+
+  int num_nodes = tail_offset >> ARRAY_NODE_BITS;
+  if (num_nodes == 0)
+    return array;
+  Object **level = malloc(num_nodes * sizeof(Object *));
+  for (int i = 0; i < num_nodes; i++) {
+    level[i] = array_node_new();
+    memcpy(level[i]->value.node->slots, &elements[i << ARRAY_NODE_BITS],
+      sizeof(ArrayNode));
+  }
+  for (;; array->shift += ARRAY_NODE_BITS) {
+    int num_parents = (num_nodes + ARRAY_NODE_MASK) >> ARRAY_NODE_BITS;
+    for (int i = 0; i < num_parents; i++) {
+      Object *parent = array_node_new();
+      for (int j = 0; j < ARRAY_NODE_WIDTH; j++) {
+        int child = (i << ARRAY_NODE_BITS) + j;
+        if (child < num_nodes)
+          parent->value.node->slots[j] = VALUE_OBJ(level[child]);
+      }
+      level[i] = parent;
+    }
+    num_nodes = num_parents;
+    if (num_nodes == 1)
+      break;
+  }
+  array->root = level[0];
+  free(level);
+  return array;
+}
+
+Value array_get(Array *array, int index) {
+  int i = array->offset + index;
+  int tail_offset = array->offset + array->length - array->tail_length;
+  if (i >= tail_offset)
+    return array->tail[i - tail_offset];
+  Object *node = array->root;
+  for (int level = array->shift; level > 0; level -= ARRAY_NODE_BITS) {
+    Value child = node->value.node->slots[(i >> level) & ARRAY_NODE_MASK];
+    node = VALUE_AS_OBJ(child);
+  }
+  return node->value.node->slots[i & ARRAY_NODE_MASK];
+}
+
+static Object *array_new_path(int level, Object *node) {
+  if (level == 0)
+    return node;
+  Object *path = array_node_new();
+  path->value.node->slots[0] =
+    VALUE_OBJ(array_new_path(level - ARRAY_NODE_BITS, node));
+  return path;
+}
+
+// copies the path from `parent` down to where the leaf `tail` goes
+static Object *array_push_tail(
+  int count, int level, Object *parent, Object *tail) {
+  Object *copy = parent ? array_node_copy(parent) : array_node_new();
+  int index = ((count - 1) >> level) & ARRAY_NODE_MASK;
+  Object *inserted;
+  if (level == ARRAY_NODE_BITS) {
+    inserted = tail;
+  } else {
+    Value child = copy->value.node->slots[index];
+    inserted = child != VALUE_NULL
+                 ? array_push_tail(
+                     count, level - ARRAY_NODE_BITS, VALUE_AS_OBJ(child), tail)
+                 : array_new_path(level - ARRAY_NODE_BITS, tail);
+  }
+  copy->value.node->slots[index] = VALUE_OBJ(inserted);
+  return copy;
+}
+
+Array *array_push(Array *array, Value value) {
+  Array *pushed = malloc(sizeof(Array));
+  *pushed = *array;
+  pushed->length++;
+  if (array->tail_length < ARRAY_NODE_WIDTH) {
+    pushed->tail[pushed->tail_length++] = value;
+    return pushed;
+  }
+
+  // the tail is full, move it into the trie and start a new one
+  int count = array->offset + array->length;
+  Object *tail = array_node_new();
+  memcpy(tail->value.node->slots, array->tail, sizeof(ArrayNode));
+  bool root_full = (count >> ARRAY_NODE_BITS) > (1 << array->shift);
+  if (array->root != NULL && root_full) {
+    Object *root = array_node_new();
+    root->value.node->slots[0] = VALUE_OBJ(array->root);
+    root->value.node->slots[1] = VALUE_OBJ(array_new_path(array->shift, tail));
+    pushed->root = root;
+    pushed->shift += ARRAY_NODE_BITS;
+  } else {
+    pushed->root = array_push_tail(count, array->shift, array->root, tail);
+  }
+  pushed->tail[0] = value;
+  pushed->tail_length = 1;
+  return pushed;
+}
+
+Array *array_rest(Array *array) {
+  Array *rest = malloc(sizeof(Array));
+  *rest = *array;
+  rest->offset++;
+  rest->length--;
+  return rest;
+}
+
+// splitmix64 finalizer, spreads small keys over all 64 bits
+static uint64_t hash_mix(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+static uint64_t int_hash(Value key) {
+  uint32_t i = VALUE_AS_INT(key);
+  return hash_mix(((uint64_t)INTEGER_OBJ << 32) | i);
+}
+
+static uint64_t bool_hash(Value key) {
+  return hash_mix(((uint64_t)BOOLEAN_OBJ << 32) | (key == VALUE_TRUE));
+}
+
+static uint64_t string_hash(Value key) {
+  Object *string = VALUE_AS_OBJ(key);
+  if (string->hash != 0)
+    return string->hash;
+  uint64_t hash = 0xcbf29ce484222325ULL;  // FNV-1a
+  for (char *c = string->value.str; *c != '\0'; c++) {
+    hash ^= (unsigned char)*c;
+    hash *= 0x100000001b3ULL;
+  }
+  hash = hash_mix(((uint64_t)STRING_OBJ << 32) ^ hash);
+  string->hash = hash != 0 ? hash : 1;
+  return string->hash;
+}
+
+// integers and booleans are stored in the value itself
+static bool immediate_equals(Value a, Value b) {
+  return a == b;
+}
+
+static bool string_equals(Value a, Value b) {
+  if (a == b)
+    return true;
+  if (!VALUE_HAS_TYPE(b, STRING_OBJ))
+    return false;
+  return strcmp(VALUE_AS_OBJ(a)->value.str, VALUE_AS_OBJ(b)->value.str) == 0;
+}
+
+typedef struct HashType {
+  uint64_t (*hash)(Value key);
+  bool (*equals)(Value a, Value b);
+} HashType;
+
+static const HashType hash_types[NUM_OBJECT_TYPES] = {
+  [INTEGER_OBJ] = {int_hash, immediate_equals},
+  [BOOLEAN_OBJ] = {bool_hash, immediate_equals},
+  [STRING_OBJ] = {string_hash, string_equals},
+};
+
+static const HashType *hash_type_of(Value key) {
+  if (VALUE_IS_INT(key))
+    return &hash_types[INTEGER_OBJ];
+  if (VALUE_IS_BOOL(key))
+    return &hash_types[BOOLEAN_OBJ];
+  if (VALUE_IS_OBJ(key))
+    return &hash_types[VALUE_AS_OBJ(key)->type];
+  return &hash_types[NULL_OBJ];
+}
+
+bool object_hashable(Value key) {
+  return hash_type_of(key)->hash != NULL;
+}
+
+uint64_t object_hash(Value key) {
+  return hash_type_of(key)->hash(key);
+}
+
+bool object_equals(Value a, Value b) {
+  return hash_type_of(a)->equals(a, b);
+}
+
+Hash *hash_new(int num_entries) {
+  int capacity = 1;
+  while (capacity < num_entries * 2)
+    capacity <<= 1;
+  Hash *hash = malloc(sizeof(Hash) + num_entries * sizeof(HashEntry) +
+                      capacity * sizeof(int));
+  hash->length = 0;
+  hash->capacity = capacity;
+  hash->slots = (int *)&hash->entries[num_entries];
+  memset(hash->slots, -1, capacity * sizeof(int));
+  return hash;
+}
+
+// returns the slot holding `key`, or the empty slot where it would go
+static int *hash_find_slot(Hash *hash, Value key, uint64_t key_hash) {
+  int mask = hash->capacity - 1;
+  for (int i = key_hash & mask;; i = (i + 1) & mask) {
+    int *slot = &hash->slots[i];
+    if (*slot == -1)
+      return slot;
+    HashEntry *entry = &hash->entries[*slot];
+    if (entry->hash == key_hash && object_equals(entry->key, key))
+      return slot;
+  }
+}
+
+bool hash_put(Hash *hash, Value key, Value value) {
+  if (!object_hashable(key))
+    return false;
+  uint64_t key_hash = object_hash(key);
+  int *slot = hash_find_slot(hash, key, key_hash);
+  if (*slot == -1) {
+    *slot = hash->length++;
+    hash->entries[*slot] = (HashEntry){key_hash, key, value};
+  } else {
+    hash->entries[*slot].value = value;  // last duplicate key wins
+  }
+  return true;
+}
+
+HashEntry *hash_get(Hash *hash, Value key) {
+  int *slot = hash_find_slot(hash, key, object_hash(key));
+  return *slot == -1 ? NULL : &hash->entries[*slot];
+}
+
+long object_alloc_count(void) {
+  long total = 0;
+  for (int type = 0; type < NUM_OBJECT_TYPES; type++)
+    total += num_allocations[type];
+  return total;
+}
+
+long object_alloc_count_of(ObjectType type) {
+  return num_allocations[type];
+}
+
+Value value_from(Object *obj) {
+  switch (obj->type) {
+    case INTEGER_OBJ:
+      return VALUE_INT(obj->value.i);
+    case BOOLEAN_OBJ:
+      return VALUE_BOOL(obj->value.b);
+    case NULL_OBJ:
+      return VALUE_NULL;
+    default:
+      return VALUE_OBJ(obj);
+  }
+}
+
+Value value_from_copy(Object obj) {
+  switch (obj.type) {
+    case INTEGER_OBJ:
+    case BOOLEAN_OBJ:
+    case NULL_OBJ: /* intentional fallthrough */
+      return value_from(&obj);
+    default: {
+      Object *copy = object_alloc(obj.type);
+      copy->value = obj.value;
+      copy->hash = obj.hash;
+      return VALUE_OBJ(copy);
+    }
+  }
+}
+
+Object value_to_object(Value value) {
+  if (VALUE_IS_INT(value))
+    return (Object){.type = INTEGER_OBJ, .value = {.i = VALUE_AS_INT(value)}};
+  switch (value) {
+    case VALUE_TRUE:
+      return TRUE;
+    case VALUE_FALSE:
+      return FALSE;
+    case VALUE_NULL:
+      return M_NULL;
+    default:
+      return *VALUE_AS_OBJ(value);
+  }
+}
+
+Object *value_box(Value value) {
+  if (VALUE_IS_INT(value)) {
+    Object *boxed = object_alloc(INTEGER_OBJ);
+    boxed->value.i = VALUE_AS_INT(value);
+    return boxed;
+  }
+  switch (value) {
+    case VALUE_TRUE:
+      return &TRUE;
+    case VALUE_FALSE:
+      return &FALSE;
+    case VALUE_NULL:
+      return &M_NULL;
+    default:
+      return VALUE_AS_OBJ(value);
+  }
+}
+
+char *value_type(Value value) {
+  return object_type(value_to_object(value));
+}
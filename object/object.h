@@ -3,6 +3,7 @@
 
 #include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "../ast/ast.h"
 #include "../code/code.h"
 #include "../utils/list.h"
@@ -21,6 +22,8 @@ enum ObjectTypes {
   BUILT_IN_OBJ,
   NOT_FOUND_OBJ,
   CLOSURE_OBJ,
+  ARRAY_NODE_OBJ,
+  NUM_OBJECT_TYPES,
 };
 
 typedef int ObjectType;
@@ -40,12 +43,77 @@ typedef struct CompiledFunction {
   Instruct *instructions;
   int num_locals;
   int num_params;
+  struct Object *closure;  // shared by all closures capturing no variables
+  void *native;            // JIT-compiled code, NULL until first called
 } CompiledFunction;
 
 struct Closure;
 
+/**
+ * VM values are tagged machine words: integers, booleans and null are stored
+ * inline in the word itself, anything else is a pointer to a heap `Object`.
+ * Heap pointers are at least 8-byte aligned, so their low three bits are 0.
+ */
+typedef uintptr_t Value;
+
+#define VALUE_NULL ((Value)0x2)
+#define VALUE_FALSE ((Value)0x4)
+#define VALUE_TRUE ((Value)0x6)
+#define VALUE_IS_INT(v) (((v)&1) == 1)
+#define VALUE_IS_OBJ(v) (((v)&7) == 0)
+#define VALUE_IS_BOOL(v) ((v) == VALUE_TRUE || (v) == VALUE_FALSE)
+#define VALUE_INT(i) ((((Value)(intptr_t)(i)) << 1) | 1)
+#define VALUE_AS_INT(v) ((int)((intptr_t)(v) >> 1))
+#define VALUE_BOOL(b) ((b) ? VALUE_TRUE : VALUE_FALSE)
+#define VALUE_OBJ(obj) ((Value)(obj))
+#define VALUE_AS_OBJ(v) ((struct Object *)(v))
+#define VALUE_HAS_TYPE(v, t) (VALUE_IS_OBJ(v) && VALUE_AS_OBJ(v)->type == (t))
+#define VALUE_IS_TRUTHY(v) ((v) != VALUE_NULL && (v) != VALUE_FALSE)
+
+#define ARRAY_NODE_BITS 5
+#define ARRAY_NODE_WIDTH (1 << ARRAY_NODE_BITS)
+
+typedef struct ArrayNode {
+  Value slots[ARRAY_NODE_WIDTH];  // child ARRAY_NODE_OBJs, or leaf elements
+} ArrayNode;
+
+/**
+ * Arrays are persistent vectors: a 32-way trie of ARRAY_NODE_OBJs holding
+ * all but the last few elements, which live inline in `tail`. Arrays are
+ * never mutated, so `push` copies only the tail, or one path through the
+ * trie when the tail is full, and `rest` shares everything by dropping the
+ * first element through `offset`.
+ */
+typedef struct Array {
+  int length;  // elements visible from `offset`
+  int offset;  // elements dropped from the front
+  int shift;   // index bits consumed below the root
+  int tail_length;
+  struct Object *root;  // NULL until the first tail is full
+  Value tail[ARRAY_NODE_WIDTH];
+} Array;
+
+typedef struct HashEntry {
+  uint64_t hash;
+  Value key;
+  Value value;
+} HashEntry;
+
+/**
+ * Hashes are built once and never mutated, so a hash is a single allocation:
+ * its entries in insertion order, followed by an open-addressing index of
+ * `capacity` slots (a power of two) holding an entry index, or -1 if empty.
+ */
+typedef struct Hash {
+  int length;
+  int capacity;
+  int *slots;
+  HashEntry entries[];  // room for the number of entries given to hash_new()
+} Hash;
+
 typedef struct Object {
   ObjectType type;
+  uint32_t marked;  // epoch of the last collection that reached this object
   union {
     int i;
     bool b;
@@ -53,28 +121,28 @@ typedef struct Object {
     char *str;
     Function *fn;
     CompiledFunction *compiled_fn;
-    struct Object (*builtin_fn)(List *args);
-    List *list;  // List<Object> (for array elements) | List<HashPair>
+    Value (*builtin_fn)(Value *args, int num_args);
+    Array *array;
+    ArrayNode *node;
+    Hash *hash;
     struct Closure *closure;
   } value;
+  uint64_t hash;  // STRING_OBJ only: cached object_hash(), 0 until computed
 } Object;
 
 #define MAX_FREE_VARIABLES UCHAR_MAX + 1
 
 typedef struct Closure {
   CompiledFunction *fn;
-  Object *free[MAX_FREE_VARIABLES];
+  Object *object;  // the canonical CLOSURE_OBJ wrapping this closure
+  int num_free;
+  Value free[];  // sized to `num_free` when allocated
 } Closure;
 
 extern Object M_NULL;
 extern Object TRUE;
 extern Object FALSE;
 
-typedef struct HashPair {
-  Object *key;
-  Object *value;
-} HashPair;
-
 typedef struct Binding {
   char *name;
   Object value;
@@ -84,8 +152,59 @@ char *object_inspect(Object object);
 char *object_type(Object object);
 void object_print(Object object);
 Object *object_copy(const Object proto);
-char *object_hash(const Object object);
 bool is_truthy(Object obj);
+Object *object_alloc(ObjectType type);
+Array *array_new(void);
+Array *array_from(Value *elements, int length);
+Value array_get(Array *array, int index);
+Array *array_push(Array *array, Value value);
+Array *array_rest(Array *array);
+Hash *hash_new(int num_entries);
+bool hash_put(Hash *hash, Value key, Value value);
+HashEntry *hash_get(Hash *hash, Value key);
+
+/**
+ * Hash keys are compared by a numeric hash and an equality check chosen by
+ * the key's type; neither allocates. Only integers, booleans and strings are
+ * hashable, and a string's hash is cached on its object once computed.
+ */
+bool object_hashable(Value key);
+uint64_t object_hash(Value key);
+bool object_equals(Value a, Value b);
+long object_alloc_count(void);
+long object_alloc_count_of(ObjectType type);
+
+Value value_from(Object *obj);
+Value value_from_copy(Object obj);
+Object value_to_object(Value value);
+Object *value_box(Value value);
+char *value_type(Value value);
+
+/**
+ * Objects allocated while a heap is active belong to it, and are freed by
+ * heap_sweep() once a collection no longer reaches them. The heap's owner
+ * decides when to collect, and marks its own roots between
+ * heap_begin_collection() and heap_sweep(). Objects allocated with no active
+ * heap, like compiler constants, are never freed.
+ */
+typedef struct Heap {
+  Object **objects;
+  int length;
+  int capacity;
+  int num_sized;         // objects already counted in `bytes`
+  long bytes;            // approximate size of the objects and their payloads
+  long next_collection;  // collect once `bytes` reaches this
+  Object **gray;         // objects marked but not yet scanned
+  int gray_capacity;
+} Heap;
+
+void heap_init(Heap *heap);
+void heap_activate(Heap *heap);
+void heap_track(Object *object);
+bool heap_needs_collection(Heap *heap);
+void heap_begin_collection(void);
+void heap_mark(Heap *heap, Value value);
+long heap_sweep(Heap *heap);
 
 Env *env_new(void);
 Env *env_new_enclosed(Env *outer);
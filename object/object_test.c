@@ -12,34 +12,102 @@ void test_object_hash_equality(void) {
   Object diff1 = {.type = STRING_OBJ, .value = {.str = "Goat banjo"}};
   Object diff2 = {.type = STRING_OBJ, .value = {.str = "Goat banjo"}};
 
-  assert_str_is(
-    object_hash(hello1), object_hash(hello2), "same str content, same hash", t);
-  assert_str_is(
-    object_hash(diff1), object_hash(diff2), "same str content, same hash", t);
-  assert(strcmp(object_hash(diff1), object_hash(hello2)) != 0,
+  assert(object_hash(value_from(&hello1)) == object_hash(value_from(&hello2)),
+    "same str content, same hash", t);
+  assert(object_hash(value_from(&diff1)) == object_hash(value_from(&diff2)),
+    "same str content, same hash", t);
+  assert(object_hash(value_from(&diff1)) != object_hash(value_from(&hello2)),
     "different strings have different hashes", t);
+  assert(object_equals(value_from(&hello1), value_from(&hello2)),
+    "same str content, equal", t);
+  assert(!object_equals(value_from(&diff1), value_from(&hello2)),
+    "different strings not equal", t);
 }
 
 void test_object_hash_values(void) {
   char *t = "object_hash_values";
 
   Object hello = {.type = STRING_OBJ, .value = {.str = "hello"}};
-  assert_str_is("S=hello", object_hash(hello), "str val correct", t);
+  uint64_t hash = object_hash(value_from(&hello));
+  assert_int_is(true, hello.hash == hash, "str hash cached", t);
+  hello.value.str = "changed";
+  assert_int_is(true, object_hash(value_from(&hello)) == hash,
+    "cached str hash reused", t);
 
-  Object integer = {.type = INTEGER_OBJ, .value = {.i = 389}};
-  assert_str_is("I=389", object_hash(integer), "int val correct", t);
+  assert(object_hash(VALUE_INT(389)) == object_hash(VALUE_INT(389)),
+    "same int, same hash", t);
+  assert(object_hash(VALUE_INT(389)) != object_hash(VALUE_INT(390)),
+    "different ints have different hashes", t);
+  assert(object_hash(VALUE_INT(1)) != object_hash(VALUE_TRUE),
+    "int and bool hashes differ", t);
+  assert(object_hash(VALUE_TRUE) != object_hash(VALUE_FALSE),
+    "true and false hashes differ", t);
+  assert(!object_equals(VALUE_INT(1), VALUE_TRUE), "1 is not true", t);
+}
+
+void test_object_hashable(void) {
+  char *t = "object_hashable";
+  Object str = {.type = STRING_OBJ, .value = {.str = "key"}};
+  Object arr = {.type = ARRAY_OBJ, .value = {.array = array_new()}};
+
+  assert(object_hashable(value_from(&str)), "string is hashable", t);
+  assert(object_hashable(VALUE_INT(5)), "int is hashable", t);
+  assert(object_hashable(VALUE_FALSE), "bool is hashable", t);
+  assert(!object_hashable(VALUE_NULL), "null is not hashable", t);
+  assert(!object_hashable(value_from(&arr)), "array is not hashable", t);
+}
+
+void test_array_push_matches_from(void) {
+  char *t = "array_push_matches_from";
+  int sizes[] = {0, 1, 31, 32, 33, 1024, 1025, 1056, 33000};
+  Value elements[33000];
+  for (int i = 0; i < 33000; i++)
+    elements[i] = VALUE_INT(i);
+
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    int size = sizes[s];
+    Array *from = array_from(elements, size);
+    Array *pushed = array_new();
+    for (int i = 0; i < size; i++)
+      pushed = array_push(pushed, elements[i]);
+
+    bool same = from->length == size && pushed->length == size &&
+                from->shift == pushed->shift;
+    for (int i = 0; same && i < size; i++)
+      same = array_get(from, i) == elements[i] &&
+             array_get(pushed, i) == elements[i];
+    char msg[64];
+    sprintf(msg, "push and from agree for %d elements", size);
+    assert(same, msg, t);
+  }
+}
+
+void test_array_structural_sharing(void) {
+  char *t = "array_structural_sharing";
+  Value elements[] = {VALUE_INT(1), VALUE_INT(2), VALUE_INT(3)};
+  Array *array = array_from(elements, 3);
+  Array *four = array_push(array, VALUE_INT(4));
+  Array *five = array_push(array, VALUE_INT(5));
 
-  Object boolean = {.type = BOOLEAN_OBJ, .value = {.b = true}};
-  assert_str_is("B=true", object_hash(boolean), "bool val correct", t);
+  assert_int_is(3, array->length, "original length unchanged", t);
+  assert_int_is(4, VALUE_AS_INT(array_get(four, 3)), "pushed 4", t);
+  assert_int_is(5, VALUE_AS_INT(array_get(five, 3)), "pushed 5", t);
 
-  Object boolean = {.type = BOOLEAN_OBJ, .value = {.b = false}};
-  assert_str_is("B=false", object_hash(boolean), "bool val correct", t);
+  Array *rest = array_rest(array_rest(four));
+  assert_int_is(2, rest->length, "rest length", t);
+  assert_int_is(3, VALUE_AS_INT(array_get(rest, 0)), "rest first", t);
+  rest = array_push(rest, VALUE_INT(6));
+  assert_int_is(6, VALUE_AS_INT(array_get(rest, 2)), "push after rest", t);
+  assert_int_is(4, VALUE_AS_INT(array_get(four, 3)), "four unchanged", t);
 }
 
 int main(int argc, char **argv) {
   pass_argv(argc, argv);
   test_object_hash_equality();
   test_object_hash_values();
+  test_object_hashable();
+  test_array_push_matches_from();
+  test_array_structural_sharing();
   printf("\n");
   return 0;
 }
@@ -2,38 +2,38 @@
 #include <stdlib.h>
 #include "parser.h"
 
-Expression *parse_identifier() {
-  Expression *exp = malloc(sizeof(Expression));
-  Identifier *ident = malloc(sizeof(Identifier));
+Expression *parse_identifier(Parser *parser) {
+  Expression *exp = parser_alloc(parser, sizeof(Expression));
+  Identifier *ident = parser_alloc(parser, sizeof(Identifier));
   if (exp == NULL || ident == NULL)
     return NULL;
 
-  ident->token = parser_current_token();
-  ident->value = parser_current_token()->literal;
+  ident->token = parser_current_token(parser);
+  ident->value = parser_current_token(parser)->literal;
 
-  exp->token_literal = parser_current_token()->literal;
+  exp->token_literal = parser_current_token(parser)->literal;
   exp->type = EXPRESSION_IDENTIFIER;
   exp->node = ident;
   return exp;
 }
 
-Expression *parse_integer_literal() {
-  Expression *exp = malloc(sizeof(Expression));
-  IntegerLiteral *int_literal = malloc(sizeof(IntegerLiteral));
+Expression *parse_integer_literal(Parser *parser) {
+  Expression *exp = parser_alloc(parser, sizeof(Expression));
+  IntegerLiteral *int_literal = parser_alloc(parser, sizeof(IntegerLiteral));
   if (exp == NULL || int_literal == NULL)
     return NULL;
 
-  char *token_literal = parser_current_token()->literal;
+  char *token_literal = parser_current_token(parser)->literal;
   int value = atoi(token_literal);
   if (value == 0 && !str_is(token_literal, "0")) {
     char *err_msg_fmt = "could not parse %s as an integer";
     char err_msg[50];
     sprintf(err_msg, err_msg_fmt, token_literal);
-    parser_push_error(err_msg);
+    parser_push_error(parser, err_msg);
     return NULL;
   }
 
-  int_literal->token = parser_current_token();
+  int_literal->token = parser_current_token(parser);
   int_literal->value = value;
   exp->token_literal = token_literal;
   exp->type = EXPRESSION_INTEGER_LITERAL;
@@ -41,15 +41,15 @@ Expression *parse_integer_literal() {
   return exp;
 }
 
-Expression *parse_string_literal(void) {
-  Expression *exp = malloc(sizeof(Expression));
-  StringLiteral *str_literal = malloc(sizeof(StringLiteral));
+Expression *parse_string_literal(Parser *parser) {
+  Expression *exp = parser_alloc(parser, sizeof(Expression));
+  StringLiteral *str_literal = parser_alloc(parser, sizeof(StringLiteral));
   if (exp == NULL || str_literal == NULL)
     return NULL;
 
-  char *token_literal = parser_current_token()->literal;
-  char *value = parser_current_token()->literal;
-  str_literal->token = parser_current_token();
+  char *token_literal = parser_current_token(parser)->literal;
+  char *value = parser_current_token(parser)->literal;
+  str_literal->token = parser_current_token(parser);
   str_literal->value = value;
   exp->token_literal = token_literal;
   exp->type = EXPRESSION_STRING_LITERAL;
@@ -57,41 +57,43 @@ Expression *parse_string_literal(void) {
   return exp;
 }
 
-Expression *parse_hash_literal(void) {
-  Expression *exp = malloc(sizeof(Expression));
-  HashLiteralExpression *hash_lit = malloc(sizeof(HashLiteralExpression));
+Expression *parse_hash_literal(Parser *parser) {
+  Expression *exp = parser_alloc(parser, sizeof(Expression));
+  HashLiteralExpression *hash_lit =
+    parser_alloc(parser, sizeof(HashLiteralExpression));
   if (exp == NULL || hash_lit == NULL)
     return NULL;
 
-  hash_lit->token = parser_current_token();
-  exp->token_literal = parser_current_token()->literal;
+  hash_lit->token = parser_current_token(parser);
+  exp->token_literal = parser_current_token(parser)->literal;
   exp->type = EXPRESSION_HASH_LITERAL;
   exp->node = hash_lit;
   List *pairs = NULL;
+  List **tail = &pairs;
 
-  while (!parser_peek_token_is(TOKEN_RIGHT_BRACE)) {
-    parser_next_token();
-    Expression *key = parse_expression(PRECEDENCE_LOWEST);
+  while (!parser_peek_token_is(parser, TOKEN_RIGHT_BRACE)) {
+    parser_next_token(parser);
+    Expression *key = parse_expression(parser, PRECEDENCE_LOWEST);
 
-    if (!parser_expect_peek(TOKEN_COLON)) {
+    if (!parser_expect_peek(parser, TOKEN_COLON)) {
       return NULL;
     }
 
-    parser_next_token();
-    Expression *value = parse_expression(PRECEDENCE_LOWEST);
+    parser_next_token(parser);
+    Expression *value = parse_expression(parser, PRECEDENCE_LOWEST);
 
-    HashLiteralPair *pair = malloc(sizeof(HashLiteralPair));
+    HashLiteralPair *pair = parser_alloc(parser, sizeof(HashLiteralPair));
     pair->key = key;
     pair->value = value;
-    pairs = list_append(pairs, pair);
+    tail = list_arena_push(parser->arena, tail, pair);
 
-    if (!parser_peek_token_is(TOKEN_RIGHT_BRACE) &&
-        !parser_expect_peek(TOKEN_COMMA)) {
+    if (!parser_peek_token_is(parser, TOKEN_RIGHT_BRACE) &&
+        !parser_expect_peek(parser, TOKEN_COMMA)) {
       return NULL;
     }
   }
 
-  if (!parser_expect_peek(TOKEN_RIGHT_BRACE)) {
+  if (!parser_expect_peek(parser, TOKEN_RIGHT_BRACE)) {
     return NULL;
   }
 
@@ -99,15 +101,15 @@ Expression *parse_hash_literal(void) {
   return exp;
 }
 
-Expression *parse_boolean_literal() {
-  Expression *exp = malloc(sizeof(Expression));
-  BooleanLiteral *bool_literal = malloc(sizeof(BooleanLiteral));
+Expression *parse_boolean_literal(Parser *parser) {
+  Expression *exp = parser_alloc(parser, sizeof(Expression));
+  BooleanLiteral *bool_literal = parser_alloc(parser, sizeof(BooleanLiteral));
   if (exp == NULL || bool_literal == NULL)
     return NULL;
 
-  char *token_literal = parser_current_token()->literal;
-  int value = parser_current_token()->type == TOKEN_TRUE;
-  bool_literal->token = parser_current_token();
+  char *token_literal = parser_current_token(parser)->literal;
+  int value = parser_current_token(parser)->type == TOKEN_TRUE;
+  bool_literal->token = parser_current_token(parser);
   bool_literal->value = value;
   exp->token_literal = token_literal;
   exp->type = EXPRESSION_BOOLEAN_LITERAL;
@@ -115,62 +117,62 @@ Expression *parse_boolean_literal() {
   return exp;
 }
 
-Expression *parse_prefix_expression() {
-  Expression *exp = malloc(sizeof(Expression));
-  PrefixExpression *prefix = malloc(sizeof(PrefixExpression));
+Expression *parse_prefix_expression(Parser *parser) {
+  Expression *exp = parser_alloc(parser, sizeof(Expression));
+  PrefixExpression *prefix = parser_alloc(parser, sizeof(PrefixExpression));
   if (exp == NULL || prefix == NULL)
     return NULL;
 
-  Token *initial_token = parser_current_token();
+  Token *initial_token = parser_current_token(parser);
   prefix->token = initial_token;
   prefix->operator= initial_token->literal;
   exp->token_literal = initial_token->literal;
   exp->type = EXPRESSION_PREFIX;
   exp->node = prefix;
 
-  parser_next_token();
-  prefix->right = parse_expression(PRECEDENCE_PREFIX);
+  parser_next_token(parser);
+  prefix->right = parse_expression(parser, PRECEDENCE_PREFIX);
   return exp;
 }
 
-Expression *parse_call_expression(Expression *fn) {
-  Token *initial_token = parser_current_token();
-  Expression *exp = malloc(sizeof(Expression));
-  CallExpression *ce = malloc(sizeof(CallExpression));
+Expression *parse_call_expression(Parser *parser, Expression *fn) {
+  Token *initial_token = parser_current_token(parser);
+  Expression *exp = parser_alloc(parser, sizeof(Expression));
+  CallExpression *ce = parser_alloc(parser, sizeof(CallExpression));
   exp->token_literal = initial_token->literal;
   exp->type = EXPRESSION_CALL;
   exp->node = ce;
   ce->fn = fn;
   ce->token = initial_token;
-  ce->arguments = parse_expression_list(TOKEN_RIGHT_PAREN);
+  ce->arguments = parse_expression_list(parser, TOKEN_RIGHT_PAREN);
   return exp;
 }
 
-Expression *parse_array_literal(void) {
-  Token *initial_token = parser_current_token();
-  Expression *exp = malloc(sizeof(Expression));
-  ArrayLiteral *array_lit = malloc(sizeof(ArrayLiteral));
+Expression *parse_array_literal(Parser *parser) {
+  Token *initial_token = parser_current_token(parser);
+  Expression *exp = parser_alloc(parser, sizeof(Expression));
+  ArrayLiteral *array_lit = parser_alloc(parser, sizeof(ArrayLiteral));
   exp->token_literal = initial_token->literal;
   exp->type = EXPRESSION_ARRAY_LITERAL;
   exp->node = array_lit;
   array_lit->token = initial_token;
-  array_lit->elements = parse_expression_list(TOKEN_RIGHT_BRACKET);
+  array_lit->elements = parse_expression_list(parser, TOKEN_RIGHT_BRACKET);
   return exp;
 }
 
-Expression *parse_index_expression(Expression *left) {
-  Expression *exp = malloc(sizeof(Expression));
-  IndexExpression *ie = malloc(sizeof(IndexExpression));
+Expression *parse_index_expression(Parser *parser, Expression *left) {
+  Expression *exp = parser_alloc(parser, sizeof(Expression));
+  IndexExpression *ie = parser_alloc(parser, sizeof(IndexExpression));
   if (exp == NULL || ie == NULL)
     return NULL;
 
-  Token *initial_token = parser_current_token();
+  Token *initial_token = parser_current_token(parser);
   ie->token = initial_token;
   ie->left = left;
 
-  parser_next_token();
-  ie->index = parse_expression(PRECEDENCE_LOWEST);
-  if (!parser_expect_peek(TOKEN_RIGHT_BRACKET)) {
+  parser_next_token(parser);
+  ie->index = parse_expression(parser, PRECEDENCE_LOWEST);
+  if (!parser_expect_peek(parser, TOKEN_RIGHT_BRACKET)) {
     return NULL;
   }
 
@@ -180,61 +182,62 @@ Expression *parse_index_expression(Expression *left) {
   return exp;
 }
 
-Expression *parse_infix_expression(Expression *left) {
-  Expression *exp = malloc(sizeof(Expression));
-  InfixExpression *infix = malloc(sizeof(InfixExpression));
+Expression *parse_infix_expression(Parser *parser, Expression *left) {
+  Expression *exp = parser_alloc(parser, sizeof(Expression));
+  InfixExpression *infix = parser_alloc(parser, sizeof(InfixExpression));
   if (exp == NULL || infix == NULL)
     return NULL;
 
-  Token *initial_token = parser_current_token();
+  Token *initial_token = parser_current_token(parser);
   infix->token = initial_token;
   infix->operator= initial_token->literal;
   infix->left = left;
   exp->token_literal = initial_token->literal;
   exp->type = EXPRESSION_INFIX;
   exp->node = infix;
-  int precedence = parser_current_precedence();
-  parser_next_token();
-  infix->right = parse_expression(precedence);
+  int precedence = parser_current_precedence(parser);
+  parser_next_token(parser);
+  infix->right = parse_expression(parser, precedence);
   return exp;
 }
 
-Expression *parse_grouped_expression() {
-  parser_next_token();
-  Expression *exp = parse_expression(PRECEDENCE_LOWEST);
-  if (!parser_expect_peek(TOKEN_RIGHT_PAREN)) {
+Expression *parse_grouped_expression(Parser *parser) {
+  parser_next_token(parser);
+  Expression *exp = parse_expression(parser, PRECEDENCE_LOWEST);
+  if (!parser_expect_peek(parser, TOKEN_RIGHT_PAREN)) {
     return NULL;
   }
   return exp;
 }
 
-Expression *parse_if_expression() {
-  Token *initial_token = parser_current_token();
-  Expression *exp = malloc(sizeof(Expression));
-  IfExpression *if_exp = malloc(sizeof(IfExpression));
+Expression *parse_if_expression(Parser *parser) {
+  Token *initial_token = parser_current_token(parser);
+  Expression *exp = parser_alloc(parser, sizeof(Expression));
+  IfExpression *if_exp = parser_alloc(parser, sizeof(IfExpression));
   if (exp == NULL || if_exp == NULL)
     return NULL;
 
-  if (!parser_expect_peek(TOKEN_LEFT_PAREN))
+  if (!parser_expect_peek(parser, TOKEN_LEFT_PAREN))
     return NULL;
 
-  parser_next_token();
-  if_exp->condition = parse_expression(PRECEDENCE_LOWEST);
+  parser_next_token(parser);
+  if_exp->condition = parse_expression(parser, PRECEDENCE_LOWEST);
 
-  if (!parser_expect_peek(TOKEN_RIGHT_PAREN))
+  if (!parser_expect_peek(parser, TOKEN_RIGHT_PAREN))
     return NULL;
 
-  if (!parser_expect_peek(TOKEN_LEFT_BRACE))
+  if (!parser_expect_peek(parser, TOKEN_LEFT_BRACE))
     return NULL;
 
-  if_exp->consequence = parse_block_statement();
+  if_exp->consequence = parse_block_statement(parser);
+  if_exp->alternative = NULL;
 
-  if (parser_peek_token_is(TOKEN_ELSE)) {
-    parser_next_token();
-    if (!parser_expect_peek(TOKEN_LEFT_BRACE))
+  if (parser_peek_token_is(parser, TOKEN_ELSE)) {
+    parser_next_token(parser);
+    if (!parser_expect_peek(parser, TOKEN_LEFT_BRACE))
       return NULL;
 
-    if_exp->alternative = parse_block_statement();
+    if_exp->alternative = parse_block_statement(parser);
   }
 
   if_exp->token = initial_token;
@@ -244,22 +247,23 @@ Expression *parse_if_expression() {
   return exp;
 }
 
-Expression *parse_function_literal() {
-  Token *initial_token = parser_current_token();
-  Expression *exp = malloc(sizeof(Expression));
-  FunctionLiteral *fn = malloc(sizeof(FunctionLiteral));
+Expression *parse_function_literal(Parser *parser) {
+  Token *initial_token = parser_current_token(parser);
+  Expression *exp = parser_alloc(parser, sizeof(Expression));
+  FunctionLiteral *fn = parser_alloc(parser, sizeof(FunctionLiteral));
   if (exp == NULL || fn == NULL)
     return NULL;
+  fn->name = NULL;  // set by the enclosing let statement, if any
 
-  if (!parser_expect_peek(TOKEN_LEFT_PAREN))
+  if (!parser_expect_peek(parser, TOKEN_LEFT_PAREN))
     return NULL;
 
-  fn->parameters = parse_function_parameters();
+  fn->parameters = parse_function_parameters(parser);
 
-  if (!parser_expect_peek(TOKEN_LEFT_BRACE))
+  if (!parser_expect_peek(parser, TOKEN_LEFT_BRACE))
     return NULL;
 
-  fn->body = parse_block_statement();
+  fn->body = parse_block_statement(parser);
 
   fn->token = initial_token;
   exp->token_literal = initial_token->literal;
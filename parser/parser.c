@@ -8,155 +8,165 @@
 #include "../utils/colors.h"
 #include "../utils/list.h"
 
-static Token *current_token = NULL;
-static Token *peek_token = NULL;
-static Statement *parse_statement();
-static Statement *parse_let_statement();
-static Statement *parse_return_statement();
-static Statement *parse_expression_statement();
-static void clear_error_stack();
-static void no_prefix_parse_fn_error(int token_type);
+static Statement *parse_statement(Parser *parser);
+static Statement *parse_let_statement(Parser *parser);
+static Statement *parse_return_statement(Parser *parser);
+static Statement *parse_expression_statement(Parser *parser);
+static void no_prefix_parse_fn_error(Parser *parser, int token_type);
+
+Parser parser_new(char *input, size_t length) {
+  Arena *arena = arena_new();
+  Parser parser = {.lexer = lexer_new(input, length, arena), .arena = arena};
+  parser_next_token(&parser);
+  parser_next_token(&parser);
+  return parser;
+}
 
 Program *parse_program(char *input) {
-  clear_error_stack();
+  Parser parser = parser_new(input, strlen(input));
+  return parser_parse_program(&parser);
+}
 
-  Program *program = malloc(sizeof(Program));
+Program *parser_parse_program(Parser *parser) {
+  Program *program = parser_alloc(parser, sizeof(Program));
   if (program == NULL)
     return program;
 
-  // set up lexer & initial tokens
-  lexer_set(input);
-  parser_next_token();
-  parser_next_token();
-
   program->statements = NULL;
+  program->arena = parser->arena;
+  List **tail = &program->statements;
 
   Statement *statement;
-  for (; current_token->type != TOKEN_EOF;) {
-    statement = parse_statement();
+  for (; parser->current_token->type != TOKEN_EOF;) {
+    statement = parse_statement(parser);
     if (statement != NULL)
-      program->statements = list_append(program->statements, statement);
-    parser_next_token();
+      tail = list_arena_push(parser->arena, tail, statement);
+    parser_next_token(parser);
   }
   // TODO, setup program->token_literal (see top of p 44)
 
   return program;
 }
 
-BlockStatement *parse_block_statement() {
-  BlockStatement *block = malloc(sizeof(BlockStatement));
+BlockStatement *parse_block_statement(Parser *parser) {
+  BlockStatement *block = parser_alloc(parser, sizeof(BlockStatement));
   if (block == NULL)
     return NULL;
 
-  Token *initial_token = parser_current_token();  // `{`
+  Token *initial_token = parser_current_token(parser);  // `{`
   block->token = initial_token;
   block->statements = NULL;
-  parser_next_token();
+  List **tail = &block->statements;
+  parser_next_token(parser);
 
   Statement *statement;
-  for (; current_token->type != TOKEN_EOF &&
-         current_token->type != TOKEN_RIGHT_BRACE;) {
-    statement = parse_statement();
+  for (; parser->current_token->type != TOKEN_EOF &&
+         parser->current_token->type != TOKEN_RIGHT_BRACE;) {
+    statement = parse_statement(parser);
     if (statement != NULL)
-      block->statements = list_append(block->statements, statement);
-    parser_next_token();
+      tail = list_arena_push(parser->arena, tail, statement);
+    parser_next_token(parser);
   }
   return block;
 }
 
-List *parse_expression_list(int end_token_type) {
+List *parse_expression_list(Parser *parser, int end_token_type) {
   List *exprs = NULL;
+  List **tail = &exprs;
 
-  if (parser_peek_token_is(end_token_type)) {
-    parser_next_token();
+  if (parser_peek_token_is(parser, end_token_type)) {
+    parser_next_token(parser);
     return exprs;
   }
 
-  parser_next_token();
-  exprs = list_append(exprs, parse_expression(PRECEDENCE_LOWEST));
+  parser_next_token(parser);
+  tail = list_arena_push(
+    parser->arena, tail, parse_expression(parser, PRECEDENCE_LOWEST));
 
-  while (parser_peek_token_is(TOKEN_COMMA)) {
-    parser_next_token();
-    parser_next_token();
-    exprs = list_append(exprs, parse_expression(PRECEDENCE_LOWEST));
+  while (parser_peek_token_is(parser, TOKEN_COMMA)) {
+    parser_next_token(parser);
+    parser_next_token(parser);
+    tail = list_arena_push(
+      parser->arena, tail, parse_expression(parser, PRECEDENCE_LOWEST));
   }
 
-  if (!parser_expect_peek(end_token_type))
+  if (!parser_expect_peek(parser, end_token_type))
     return NULL;
 
   return exprs;
 }
 
-List *parse_function_parameters() {
+List *parse_function_parameters(Parser *parser) {
   List *identifiers = NULL;
-  if (parser_peek_token_is(TOKEN_RIGHT_PAREN)) {
-    parser_next_token();
+  List **tail = &identifiers;
+  if (parser_peek_token_is(parser, TOKEN_RIGHT_PAREN)) {
+    parser_next_token(parser);
     return identifiers;
   }
 
-  parser_next_token();
-  Identifier *ident = malloc(sizeof(Identifier));
-  ident->token = parser_current_token();
-  ident->value = parser_current_token()->literal;
-  identifiers = list_append(identifiers, ident);
-
-  while (parser_peek_token_is(TOKEN_COMMA)) {
-    parser_next_token();
-    parser_next_token();
-    ident = malloc(sizeof(Identifier));
-    ident->token = parser_current_token();
-    ident->value = parser_current_token()->literal;
-    identifiers = list_append(identifiers, ident);
+  parser_next_token(parser);
+  Identifier *ident = parser_alloc(parser, sizeof(Identifier));
+  ident->token = parser_current_token(parser);
+  ident->value = parser_current_token(parser)->literal;
+  tail = list_arena_push(parser->arena, tail, ident);
+
+  while (parser_peek_token_is(parser, TOKEN_COMMA)) {
+    parser_next_token(parser);
+    parser_next_token(parser);
+    ident = parser_alloc(parser, sizeof(Identifier));
+    ident->token = parser_current_token(parser);
+    ident->value = parser_current_token(parser)->literal;
+    tail = list_arena_push(parser->arena, tail, ident);
   }
 
-  if (!parser_expect_peek(TOKEN_RIGHT_PAREN))
+  if (!parser_expect_peek(parser, TOKEN_RIGHT_PAREN))
     return NULL;
 
   return identifiers;
 }
 
-Statement *parse_statement() {
-  if (current_token->type == TOKEN_LET)
-    return parse_let_statement();
-  if (current_token->type == TOKEN_RETURN)
-    return parse_return_statement();
-  return parse_expression_statement();
+Statement *parse_statement(Parser *parser) {
+  if (parser->current_token->type == TOKEN_LET)
+    return parse_let_statement(parser);
+  if (parser->current_token->type == TOKEN_RETURN)
+    return parse_return_statement(parser);
+  return parse_expression_statement(parser);
 }
 
-Expression *parse_expression(int precedence) {
-  PrefixParselet prefix = get_prefix_parselet(current_token->type);
+Expression *parse_expression(Parser *parser, int precedence) {
+  PrefixParselet prefix = get_prefix_parselet(parser->current_token->type);
   if (prefix == NULL) {
-    no_prefix_parse_fn_error(current_token->type);
+    no_prefix_parse_fn_error(parser, parser->current_token->type);
     return NULL;
   }
-  Expression *left_exp = prefix();
+  Expression *left_exp = prefix(parser);
 
-  for (; peek_token->type != TOKEN_SEMICOLON &&
-         precedence < parser_peek_precedence();) {
-    InfixParselet infix = get_infix_parselet(parser_peek_token()->type);
+  for (; parser->peek_token->type != TOKEN_SEMICOLON &&
+         precedence < parser_peek_precedence(parser);) {
+    InfixParselet infix = get_infix_parselet(parser_peek_token(parser)->type);
     if (infix == NULL)
       return left_exp;
 
-    parser_next_token();
-    left_exp = infix(left_exp);
+    parser_next_token(parser);
+    left_exp = infix(parser, left_exp);
   }
   return left_exp;
 }
 
-Statement *parse_expression_statement() {
-  Statement *statement = malloc(sizeof(Statement));
-  Token *initial_token = current_token;
+Statement *parse_expression_statement(Parser *parser) {
+  Statement *statement = parser_alloc(parser, sizeof(Statement));
+  Token *initial_token = parser->current_token;
   statement->token_literal = initial_token->literal;
   if (statement == NULL)
     return NULL;
 
   ExpressionStatement *expression_statement =
-    malloc(sizeof(ExpressionStatement));
+    parser_alloc(parser, sizeof(ExpressionStatement));
   if (expression_statement == NULL)
     return NULL;
 
-  expression_statement->token = current_token;
-  Expression *expression = parse_expression(PRECEDENCE_LOWEST);
+  expression_statement->token = parser->current_token;
+  Expression *expression = parse_expression(parser, PRECEDENCE_LOWEST);
   if (expression == NULL)
     return NULL;
 
@@ -164,16 +174,17 @@ Statement *parse_expression_statement() {
   statement->node = expression_statement;
   statement->type = STATEMENT_EXPRESSION;
 
-  if (peek_token->type == TOKEN_SEMICOLON)
-    parser_next_token();
+  if (parser->peek_token->type == TOKEN_SEMICOLON)
+    parser_next_token(parser);
 
   return statement;
 }
 
-Statement *parse_return_statement() {
-  Statement *statement = malloc(sizeof(Statement));
-  ReturnStatement *return_statement = malloc(sizeof(ReturnStatement));
-  Token *initial_token = current_token;
+Statement *parse_return_statement(Parser *parser) {
+  Statement *statement = parser_alloc(parser, sizeof(Statement));
+  ReturnStatement *return_statement =
+    parser_alloc(parser, sizeof(ReturnStatement));
+  Token *initial_token = parser->current_token;
   statement->token_literal = initial_token->literal;
   if (statement == NULL || return_statement == NULL)
     return NULL;
@@ -183,127 +194,123 @@ Statement *parse_return_statement() {
   statement->type = STATEMENT_RETURN;
 
   // move past return token
-  parser_next_token();
+  parser_next_token(parser);
 
-  return_statement->return_value = parse_expression(PRECEDENCE_LOWEST);
+  return_statement->return_value = parse_expression(parser, PRECEDENCE_LOWEST);
 
-  if (parser_peek_token_is(TOKEN_SEMICOLON))
-    parser_next_token();
+  if (parser_peek_token_is(parser, TOKEN_SEMICOLON))
+    parser_next_token(parser);
 
   return statement;
 }
 
-Statement *parse_let_statement() {
-  Statement *statement = malloc(sizeof(Statement));
-  Token *initial_token = current_token;
+Statement *parse_let_statement(Parser *parser) {
+  Statement *statement = parser_alloc(parser, sizeof(Statement));
+  Token *initial_token = parser->current_token;
   statement->token_literal = initial_token->literal;
   if (statement == NULL)
     return NULL;
 
-  if (!parser_expect_peek(TOKEN_IDENTIFIER))
+  if (!parser_expect_peek(parser, TOKEN_IDENTIFIER))
     return NULL;
 
-  LetStatement *let_statement = malloc(sizeof(LetStatement));
-  Identifier *name = malloc(sizeof(Identifier));
+  LetStatement *let_statement = parser_alloc(parser, sizeof(LetStatement));
+  Identifier *name = parser_alloc(parser, sizeof(Identifier));
   if (let_statement == NULL || name == NULL)
     return NULL;
 
-  name->token = current_token;
-  name->value = current_token->literal;
+  name->token = parser->current_token;
+  name->value = parser->current_token->literal;
   let_statement->token = initial_token;
   let_statement->name = name;
   statement->node = let_statement;
   statement->type = STATEMENT_LET;
 
-  if (!parser_expect_peek(TOKEN_ASSIGN))
+  if (!parser_expect_peek(parser, TOKEN_ASSIGN))
     return NULL;
 
-  parser_next_token();
-  let_statement->value = parse_expression(PRECEDENCE_LOWEST);
+  parser_next_token(parser);
+  let_statement->value = parse_expression(parser, PRECEDENCE_LOWEST);
   if (let_statement->value->type == EXPRESSION_FUNCTION_LITERAL) {
     FunctionLiteral *fn = let_statement->value->node;
     fn->name = let_statement->name->value;
   }
 
-  if (parser_peek_token_is(TOKEN_SEMICOLON))
-    parser_next_token();
+  if (parser_peek_token_is(parser, TOKEN_SEMICOLON))
+    parser_next_token(parser);
 
   return statement;
 }
 
-void parser_next_token() {
-  current_token = peek_token;
-  peek_token = lexer_next_token();
+void *parser_alloc(Parser *parser, size_t size) {
+  return arena_alloc(parser->arena, size);
+}
+
+void parser_next_token(Parser *parser) {
+  parser->current_token = parser->peek_token;
+  parser->peek_token = lexer_next(&parser->lexer);
 }
 
-bool parser_expect_peek(int token_type) {
-  if (peek_token->type == token_type) {
-    parser_next_token();
+bool parser_expect_peek(Parser *parser, int token_type) {
+  if (parser->peek_token->type == token_type) {
+    parser_next_token(parser);
     return true;
   }
 
   char msg[100];
   sprintf(msg, "expected next token to be %s, got %d instead\n",
-    token_type_name(token_type), peek_token->type);
-  parser_push_error(msg);
+    token_type_name(token_type), parser->peek_token->type);
+  parser_push_error(parser, msg);
   return false;
 }
 
-#define MAX_ERRORS 50
-static char *errors[MAX_ERRORS];
-static int error_index = 0;
-
-void parser_push_error(char *error_msg) {
-  if (error_index < MAX_ERRORS) {
-    errors[error_index] = strdup(error_msg);
-    error_index += 1;
+void parser_push_error(Parser *parser, char *error_msg) {
+  if (parser->num_errors < MAX_PARSER_ERRORS) {
+    parser->errors[parser->num_errors] = arena_strdup(parser->arena, error_msg);
+    parser->num_errors += 1;
   }
 }
 
-bool parser_has_error() {
-  return error_index > 0;
-}
-
-void parser_print_errors() {
-  for (int i = 0; i < error_index; i++)
-    printf(COLOR_RED "  -> PARSE ERROR! %s" COLOR_RESET, errors[i]);
+bool parser_has_error(Parser *parser) {
+  return parser->num_errors > 0;
 }
 
-int parser_num_errors() {
-  return error_index;
+void parser_print_errors(Parser *parser) {
+  for (int i = 0; i < parser->num_errors; i++)
+    printf(COLOR_RED "  -> PARSE ERROR! %s" COLOR_RESET, parser->errors[i]);
 }
 
-static void clear_error_stack() {
-  error_index = 0;
+int parser_num_errors(Parser *parser) {
+  return parser->num_errors;
 }
 
-Token *parser_current_token() {
-  return current_token;
+Token *parser_current_token(Parser *parser) {
+  return parser->current_token;
 }
 
-Token *parser_peek_token() {
-  return peek_token;
+Token *parser_peek_token(Parser *parser) {
+  return parser->peek_token;
 }
 
-static void no_prefix_parse_fn_error(int token_type) {
-  char *err = malloc(200);
+static void no_prefix_parse_fn_error(Parser *parser, int token_type) {
+  char *err = parser_alloc(parser, 200);
   sprintf(err, "no prefix parse function for token type `%s` found\n",
     token_type_name(token_type));
-  parser_push_error(err);
+  parser_push_error(parser, err);
 }
 
-int parser_peek_precedence() {
-  return token_precedence(parser_peek_token()->type);
+int parser_peek_precedence(Parser *parser) {
+  return token_precedence(parser_peek_token(parser)->type);
 }
 
-int parser_current_precedence() {
-  return token_precedence(parser_current_token()->type);
+int parser_current_precedence(Parser *parser) {
+  return token_precedence(parser_current_token(parser)->type);
 }
 
-bool parser_peek_token_is(int token_type) {
-  return peek_token->type == token_type;
+bool parser_peek_token_is(Parser *parser, int token_type) {
+  return parser->peek_token->type == token_type;
 }
 
-bool parser_current_token_is(int token_type) {
-  return current_token->type == token_type;
+bool parser_current_token_is(Parser *parser, int token_type) {
+  return parser->current_token->type == token_type;
 }
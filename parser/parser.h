@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include "../ast/ast.h"
+#include "../lexer/lexer.h"
 
 enum Precedence {
   PRECEDENCE_LOWEST,
@@ -32,25 +33,49 @@ enum ExpressionType {
 
 enum StatementType { STATEMENT_LET, STATEMENT_RETURN, STATEMENT_EXPRESSION };
 
+#define MAX_PARSER_ERRORS 50
+
+/**
+ * All of a parse's state, lexer included, so any number of programs can be
+ * parsed at once, each with a parser of its own (on its own thread, say).
+ * Everything a parse allocates comes from its arena, which the program
+ * keeps and `program_free()` releases.
+ */
+typedef struct Parser {
+  Lexer lexer;
+  Arena *arena;
+  Token *current_token;
+  Token *peek_token;
+  char *errors[MAX_PARSER_ERRORS];
+  int num_errors;
+} Parser;
+
+// a parser over `length` bytes of `input`, which it lexes in place
+Parser parser_new(char *input, size_t length);
+Program *parser_parse_program(Parser *parser);
+
+// parses a NUL-terminated program with a parser of its own, for callers
+// that don't look at parse errors
 Program *parse_program(char *input);
-Expression *parse_expression(int precedence);
-BlockStatement *parse_block_statement();
-List *parse_function_parameters();
-List *parse_expression_list(int end_token_type);
-void parser_next_token();
-void parser_push_error(char *error_msg);
-int parser_current_precedence();
-int parser_peek_precedence();
-bool parser_has_error();
-int parser_num_errors();
-void parser_print_errors();
-Token *parser_current_token();
-Token *parser_peek_token();
-bool parser_peek_token_is(int token_type);
-bool parser_current_token_is(int token_type);
-bool parser_expect_peek(int token_type);
-typedef Expression *(*PrefixParselet)(void);
-typedef Expression *(*InfixParselet)(Expression *);
+Expression *parse_expression(Parser *parser, int precedence);
+BlockStatement *parse_block_statement(Parser *parser);
+List *parse_function_parameters(Parser *parser);
+List *parse_expression_list(Parser *parser, int end_token_type);
+void *parser_alloc(Parser *parser, size_t size);
+void parser_next_token(Parser *parser);
+void parser_push_error(Parser *parser, char *error_msg);
+int parser_current_precedence(Parser *parser);
+int parser_peek_precedence(Parser *parser);
+bool parser_has_error(Parser *parser);
+int parser_num_errors(Parser *parser);
+void parser_print_errors(Parser *parser);
+Token *parser_current_token(Parser *parser);
+Token *parser_peek_token(Parser *parser);
+bool parser_peek_token_is(Parser *parser, int token_type);
+bool parser_current_token_is(Parser *parser, int token_type);
+bool parser_expect_peek(Parser *parser, int token_type);
+typedef Expression *(*PrefixParselet)(Parser *);
+typedef Expression *(*InfixParselet)(Parser *, Expression *);
 PrefixParselet get_prefix_parselet(int token_type);
 InfixParselet get_infix_parselet(int token_type);
 
@@ -0,0 +1,82 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "parser.h"
+
+// parses the same batch of programs split across 1 to MAX_THREADS threads,
+// then programs of copies of `program` from 1k up to MAX_STATEMENTS
+// statements, whose time per statement should stay flat
+#define NUM_PROGRAMS 20000
+#define MAX_THREADS 8
+#define STATEMENTS_PER_PROGRAM 4
+#define MAX_STATEMENTS 1000000
+
+static char *program =
+  "let fibonacci = fn(x) {\n"
+  "  if (x == 0) { return 0; }\n"
+  "  if (x < 2) { 1 } else { fibonacci(x - 1) + fibonacci(x - 2) }\n"
+  "};\n"
+  "let people = [{\"name\": \"Anna\", \"age\": 24}, {\"name\": \"Bob\"}];\n"
+  "let total = reduce(map(people, fn(p) { p[\"age\"] * 2 }), 0, add);\n"
+  "puts(!true != false, total / 3 > -1);\n";
+
+static void *parse_programs(void *arg) {
+  int num_programs = *(int *)arg;
+  size_t length = strlen(program);
+  for (int i = 0; i < num_programs; i++) {
+    Parser parser = parser_new(program, length);
+    program_free(parser_parse_program(&parser));
+  }
+  return NULL;
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// build with ARENA=false to compare against a malloc per allocation
+static void parse_large_program(int num_statements) {
+  int num_chunks = num_statements / STATEMENTS_PER_PROGRAM;
+  size_t chunk_length = strlen(program);
+  size_t length = chunk_length * num_chunks;
+  char *input = malloc(length + 1);
+  for (int i = 0; i < num_chunks; i++)
+    memcpy(&input[i * chunk_length], program, chunk_length);
+  input[length] = '\0';
+
+  double start = now();
+  Parser parser = parser_new(input, length);
+  Program *large = parser_parse_program(&parser);
+  double parsed = now();
+  long num_allocs = large->arena->num_allocs;
+  long num_mallocs = large->arena->num_mallocs;
+  program_free(large);
+  double freed = now();
+  printf("%d statements (%.1f MB): %ld allocations from %ld mallocs, "
+         "parsed in %fs (%.0fns/statement), freed in %fs\n",
+    num_statements, (double)length / (1024 * 1024), num_allocs, num_mallocs,
+    parsed - start, (parsed - start) * 1e9 / num_statements, freed - parsed);
+  free(input);
+}
+
+int main(void) {
+  for (int num_threads = 1; num_threads <= MAX_THREADS; num_threads *= 2) {
+    pthread_t threads[MAX_THREADS];
+    int per_thread = NUM_PROGRAMS / num_threads;
+    double start = now();
+    for (int i = 0; i < num_threads; i++)
+      pthread_create(&threads[i], NULL, parse_programs, &per_thread);
+    for (int i = 0; i < num_threads; i++) pthread_join(threads[i], NULL);
+    double duration = now() - start;
+    printf("%d thread(s): %d programs in %fs (%.0f programs/s)\n",
+      num_threads, NUM_PROGRAMS, duration, NUM_PROGRAMS / duration);
+  }
+  for (int num_statements = 1000; num_statements <= MAX_STATEMENTS;
+       num_statements *= 10)
+    parse_large_program(num_statements);
+  return EXIT_SUCCESS;
+}
@@ -1,4 +1,5 @@
 #include "parser.h"
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -31,7 +32,7 @@ static LitExpTest y = {LITERAL_TYPE_IDENT, "y", 0, ""};
 
 void assert_literal_expression(
   Expression *expr, LitExpTest *expected, char *test_name);
-void check_parser_errors(char *test_name);
+void check_parser_errors(Parser *parser, char *test_name);
 Program *assert_program(
   char *input, int expected_num_statements, char *test_name);
 void assert_let_statement(Statement *, char *identifier, char *test_name);
@@ -567,8 +568,66 @@ void test_parsing_hash_literals(void) {
   assert_integer_literal(pair3->value, 3, "3", t);
 }
 
+#define NUM_PARSER_THREADS 8
+#define PROGRAMS_PER_THREAD 50
+
+static char *concurrent_programs[] = {
+  "let add = fn(a, b) { a + b * 2 }; add(1, -2);",
+  "let f = fn(x, y) { x * (y - 1) }; f(!true, [1, 2 * 3][0]);",
+  "let = 5; let x 10;",
+  "return add(a + b + c * d / f + g, [x, y][1] > 5 == false);",
+  "let total = fn(xs) { len(xs) }; total([1, 2, 3]) < -4;",
+};
+
+typedef struct ParseJob {
+  int first;  // of the programs, parsed round-robin
+  char *strings[PROGRAMS_PER_THREAD];
+  int num_errors[PROGRAMS_PER_THREAD];
+} ParseJob;
+
+static void *parse_programs(void *arg) {
+  ParseJob *job = arg;
+  for (int i = 0; i < PROGRAMS_PER_THREAD; i++) {
+    char *input =
+      concurrent_programs[(job->first + i) % LEN(concurrent_programs)];
+    Parser parser = parser_new(input, strlen(input));
+    Program *program = parser_parse_program(&parser);
+    job->num_errors[i] = parser_num_errors(&parser);
+    // a program with errors has holes program_string() can't print
+    job->strings[i] = job->num_errors[i] ? "" : program_string(program);
+  }
+  return NULL;
+}
+
+void test_concurrent_parsing(void) {
+  char *t = "concurrent_parsing";
+  ParseJob expected = {.first = 0};
+  parse_programs(&expected);
+
+  pthread_t threads[NUM_PARSER_THREADS];
+  ParseJob jobs[NUM_PARSER_THREADS];
+  for (int i = 0; i < NUM_PARSER_THREADS; i++) {
+    jobs[i].first = i;
+    pthread_create(&threads[i], NULL, parse_programs, &jobs[i]);
+  }
+  int mismatches = 0;
+  for (int i = 0; i < NUM_PARSER_THREADS; i++) {
+    pthread_join(threads[i], NULL);
+    for (int j = 0; j < PROGRAMS_PER_THREAD; j++) {
+      int program = (i + j) % LEN(concurrent_programs);
+      mismatches +=
+        strcmp(jobs[i].strings[j], expected.strings[program]) != 0 ||
+        jobs[i].num_errors[j] != expected.num_errors[program];
+    }
+  }
+  assert_int_is(0, mismatches, "programs parsed differently", t);
+  assert(expected.num_errors[2] > 0, "errors are kept per parser", t);
+  assert_int_is(0, expected.num_errors[0], "no errors leak across", t);
+}
+
 int main(int argc, char **argv) {
   pass_argv(argc, argv);
+  test_concurrent_parsing();
   test_function_literal_with_name();
   test_parsing_hash_literals();
   test_parsing_hash_literals_with_expressions();
@@ -616,13 +675,13 @@ void assert_return_statement(Statement *stmt, char *test_name) {
     stmt->type == STATEMENT_RETURN, "statement TYPE is `return`", test_name);
 }
 
-void check_parser_errors(char *test_name) {
-  if (!parser_has_error())
+void check_parser_errors(Parser *parser, char *test_name) {
+  if (!parser_has_error(parser))
     return;
 
-  parser_print_errors();
+  parser_print_errors(parser);
   char msg[50];
-  sprintf(msg, "parser had %i errors\n", parser_num_errors());
+  sprintf(msg, "parser had %i errors\n", parser_num_errors(parser));
   fail(msg, test_name);
 }
 
@@ -687,12 +746,13 @@ void assert_infix_expression(Expression *expr, LitExpTest left, char *operand,
 
 Program *assert_program(
   char *input, int expected_num_statements, char *test_name) {
-  Program *program = parse_program(input);
+  Parser parser = parser_new(input, strlen(input));
+  Program *program = parser_parse_program(&parser);
 
   if (program == NULL)
-    fail("parse_program() returned NULL", test_name);
+    fail("parser_parse_program() returned NULL", test_name);
 
-  check_parser_errors(test_name);
+  check_parser_errors(&parser, test_name);
   assert_int_is(expected_num_statements, list_count(program->statements),
     si("program has %d statements", expected_num_statements), test_name);
 
@@ -0,0 +1,988 @@
+#include "reg_compiler.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../compiler/symbol_table.h"
+#include "../parser/parser.h"
+
+#define INITIAL_REG_INSTRUCTIONS 32
+#define DISCARD -1  // a destination for values nothing reads
+
+#define CHECK(expr)                 \
+  do {                              \
+    CompilerErr check_err = (expr); \
+    if (check_err)                  \
+      return check_err;             \
+  } while (0)
+
+typedef struct FarJump {
+  int pos;
+  int target;
+} FarJump;
+
+/**
+ * Per-function compilation state. Registers [0, num_named) hold the
+ * function's parameters and then its `let` bindings in definition order;
+ * temporaries are allocated above them, stack fashion, and released by
+ * resetting `free_reg` once the expression that needed them is compiled.
+ */
+typedef struct FnState {
+  struct FnState* outer;
+  RegIns* instructions;
+  int length;
+  int capacity;
+  int num_named;
+  int next_named;
+  int free_reg;
+  int num_regs;  // high-water mark of `free_reg`, the frame size
+  int* local_regs;  // symbol index -> register, for SCOPE_LOCAL symbols
+  int local_regs_capacity;
+  FarJump* far_jumps;  // jumps whose offset doesn't fit in `sx`
+  int num_far_jumps;
+} FnState;
+
+struct RegCompiler_t {
+  ConstantPool* constant_pool;
+  SymbolTable symbol_table;
+  FnState* fs;
+  Instruct* main;
+};
+
+static CompilerErr compile_statement(RegCompiler c, Statement* stmt);
+static CompilerErr compile_exp(RegCompiler c, Expression* exp, int dst);
+static CompilerErr compile_tail(RegCompiler c, Expression* exp);
+static CompilerErr compile_block(
+  RegCompiler c, BlockStatement* block, int dst);
+static CompilerErr compile_block_tail(RegCompiler c, BlockStatement* block);
+static int count_lets(List* statements);
+
+static char* names[NUM_REG_OPCODES] = {
+  [REG_LOADK] = "LoadK",
+  [REG_LOADNULL] = "LoadNull",
+  [REG_LOADTRUE] = "LoadTrue",
+  [REG_LOADFALSE] = "LoadFalse",
+  [REG_MOVE] = "Move",
+  [REG_GETGLOBAL] = "GetGlobal",
+  [REG_SETGLOBAL] = "SetGlobal",
+  [REG_GETFREE] = "GetFree",
+  [REG_GETBUILTIN] = "GetBuiltin",
+  [REG_CURRENTCLOSURE] = "CurrentClosure",
+  [REG_ADD] = "Add",
+  [REG_SUB] = "Sub",
+  [REG_MUL] = "Mul",
+  [REG_DIV] = "Div",
+  [REG_EQ] = "Eq",
+  [REG_NE] = "Ne",
+  [REG_GT] = "Gt",
+  [REG_NEG] = "Neg",
+  [REG_NOT] = "Not",
+  [REG_JMP] = "Jmp",
+  [REG_JMPLONG] = "JmpLong",
+  [REG_JMPIFNOT] = "JmpIfNot",
+  [REG_JMPIFNOTEQ] = "JmpIfNotEq",
+  [REG_JMPIFEQ] = "JmpIfEq",
+  [REG_JMPIFNOTGT] = "JmpIfNotGt",
+  [REG_CALL] = "Call",
+  [REG_TAILCALL] = "TailCall",
+  [REG_RETURN] = "Return",
+  [REG_RETURNNULL] = "ReturnNull",
+  [REG_CLOSURE] = "Closure",
+  [REG_ARRAY] = "Array",
+  [REG_ARRAYAPPEND] = "ArrayAppend",
+  [REG_HASH] = "Hash",
+  [REG_HASHADD] = "HashAdd",
+  [REG_INDEX] = "Index",
+};
+
+RegCompiler reg_compiler_new(void) {
+  RegCompiler c = malloc(sizeof(struct RegCompiler_t));
+  c->constant_pool = constant_pool_new();
+  c->symbol_table = symbol_table_new();
+  c->fs = NULL;
+  c->main = NULL;
+  symbol_table_define_builtins(c->symbol_table);
+  return c;
+}
+
+static void fn_state_init(FnState* fs, FnState* outer) {
+  memset(fs, 0, sizeof(FnState));
+  fs->outer = outer;
+  fs->capacity = INITIAL_REG_INSTRUCTIONS;
+  fs->instructions = malloc(sizeof(RegIns) * fs->capacity);
+}
+
+static bool is_jump(RegOpCode op) {
+  return op == REG_JMP || op == REG_JMPIFNOT || op == REG_JMPIFNOTEQ ||
+         op == REG_JMPIFEQ || op == REG_JMPIFNOTGT;
+}
+
+static bool fits_sx(int offset) {
+  return offset >= INT16_MIN && offset <= INT16_MAX;
+}
+
+// far unconditional jumps become a JmpLong in place; a far conditional one
+// branches over a Jmp to a JmpLong, so taking it costs one more dispatch
+static int expanded_length(RegOpCode op) {
+  return op == REG_JMP ? 1 : 3;
+}
+
+/**
+ * Rewrites the jumps that patch_jump found too far for `sx`. Expanding one
+ * shifts the instructions after it, which can push other jumps out of range
+ * in turn, so new positions are recomputed until no more jumps need it.
+ */
+static void relax_jumps(FnState* fs) {
+  if (fs->num_far_jumps == 0)
+    return;
+  int length = fs->length;
+  int* target = malloc(sizeof(int) * length);
+  bool* far = calloc(length, sizeof(bool));
+  int* new_pos = malloc(sizeof(int) * (length + 1));
+  for (int i = 0; i < length; i++)
+    if (is_jump(fs->instructions[i].op))
+      target[i] = i + 1 + fs->instructions[i].sx;
+  for (int i = 0; i < fs->num_far_jumps; i++) {
+    target[fs->far_jumps[i].pos] = fs->far_jumps[i].target;
+    far[fs->far_jumps[i].pos] = true;
+  }
+
+  for (bool changed = true; changed;) {
+    new_pos[0] = 0;
+    for (int i = 0; i < length; i++)
+      new_pos[i + 1] = new_pos[i] +
+                       (far[i] ? expanded_length(fs->instructions[i].op) : 1);
+    changed = false;
+    for (int i = 0; i < length; i++) {
+      if (is_jump(fs->instructions[i].op) && !far[i] &&
+          !fits_sx(new_pos[target[i]] - (new_pos[i] + 1))) {
+        far[i] = true;
+        changed = true;
+      }
+    }
+  }
+
+  RegIns* relaxed = malloc(sizeof(RegIns) * new_pos[length]);
+  for (int i = 0; i < length; i++) {
+    RegIns in = fs->instructions[i];
+    RegIns* out = &relaxed[new_pos[i]];
+    if (!is_jump(in.op)) {
+      *out = in;
+      continue;
+    }
+    int end = new_pos[i] + (far[i] ? expanded_length(in.op) : 1);
+    int offset = new_pos[target[i]] - end;
+    if (!far[i]) {
+      *out = in;
+      out->sx = offset;
+      continue;
+    }
+    if (in.op != REG_JMP) {
+      *out++ = (RegIns){.op = in.op, .a = in.a, .b = in.b, .c = in.c, .sx = 1};
+      *out++ = (RegIns){.op = REG_JMP, .sx = 1};
+    }
+    *out = (RegIns){.op = REG_JMPLONG,
+      .b = (uint32_t)offset & 0xffff,
+      .c = (uint32_t)offset >> 16};
+  }
+  free(fs->instructions);
+  fs->instructions = relaxed;
+  fs->length = new_pos[length];
+  free(target);
+  free(far);
+  free(new_pos);
+}
+
+static Instruct* fn_state_instructions(FnState* fs) {
+  relax_jumps(fs);
+  free(fs->far_jumps);
+  Instruct* instructions = malloc(sizeof(Instruct));
+  instructions->bytes = (Byte*)fs->instructions;
+  instructions->length = fs->length * sizeof(RegIns);
+  free(fs->local_regs);
+  return instructions;
+}
+
+static int emit_sx(
+  RegCompiler c, RegOpCode op, int a, int b, int cc, int sx) {
+  FnState* fs = c->fs;
+  if (fs->length == fs->capacity) {
+    fs->capacity *= 2;
+    fs->instructions =
+      realloc(fs->instructions, sizeof(RegIns) * fs->capacity);
+  }
+  fs->instructions[fs->length] =
+    (RegIns){.op = op, .a = a, .b = b, .c = cc, .sx = sx};
+  return fs->length++;
+}
+
+static int emit(RegCompiler c, RegOpCode op, int a, int b, int cc) {
+  return emit_sx(c, op, a, b, cc, 0);
+}
+
+// points the jump at `pos` to the next instruction to be emitted, leaving
+// it to relax_jumps if that's too far for `sx`
+static void patch_jump(RegCompiler c, int pos) {
+  FnState* fs = c->fs;
+  int offset = fs->length - (pos + 1);
+  if (fits_sx(offset)) {
+    fs->instructions[pos].sx = offset;
+    return;
+  }
+  fs->far_jumps =
+    realloc(fs->far_jumps, sizeof(FarJump) * (fs->num_far_jumps + 1));
+  fs->far_jumps[fs->num_far_jumps++] =
+    (FarJump){.pos = pos, .target = fs->length};
+}
+
+static CompilerErr alloc_reg(RegCompiler c, int* reg) {
+  FnState* fs = c->fs;
+  if (fs->free_reg >= MAX_REGISTERS)
+    return "too many registers";
+  *reg = fs->free_reg++;
+  if (fs->free_reg > fs->num_regs)
+    fs->num_regs = fs->free_reg;
+  return NULL;
+}
+
+static int local_reg(RegCompiler c, Symbol* symbol) {
+  return c->fs->local_regs[symbol->index];
+}
+
+static void bind_local(RegCompiler c, Symbol* symbol) {
+  FnState* fs = c->fs;
+  if (symbol->index >= fs->local_regs_capacity) {
+    fs->local_regs_capacity = (symbol->index + 1) * 2;
+    fs->local_regs =
+      realloc(fs->local_regs, sizeof(int) * fs->local_regs_capacity);
+  }
+  fs->local_regs[symbol->index] = fs->next_named++;
+}
+
+static CompilerErr add_constant(RegCompiler c, Object* obj, int* index) {
+  *index = constant_pool_add(c->constant_pool, obj);
+  return *index < 0 ? "too many constants" : NULL;
+}
+
+static bool is_constant_literal(Expression* exp) {
+  return exp->type == EXPRESSION_INTEGER_LITERAL ||
+         exp->type == EXPRESSION_STRING_LITERAL;
+}
+
+static CompilerErr literal_constant(
+  RegCompiler c, Expression* exp, int* index) {
+  Object* literal;
+  if (exp->type == EXPRESSION_INTEGER_LITERAL) {
+    literal = object_alloc(INTEGER_OBJ);
+    literal->value.i = ((IntegerLiteral*)exp->node)->value;
+  } else {
+    literal = object_alloc(STRING_OBJ);
+    literal->value.str = strdup(((StringLiteral*)exp->node)->value);
+  }
+  return add_constant(c, literal, index);
+}
+
+static CompilerErr resolve(
+  RegCompiler c, Identifier* ident, Symbol** symbol) {
+  *symbol = symbol_table_resolve(c->symbol_table, ident->value);
+  if (*symbol != NULL)
+    return NULL;
+  char* err = malloc(100);
+  sprintf(err, "undefined variable %s", ident->value);
+  return err;
+}
+
+static void load_symbol(RegCompiler c, Symbol* symbol, int dst) {
+  switch (symbol->scope) {
+    case SCOPE_GLOBAL:
+      emit(c, REG_GETGLOBAL, dst, symbol->index, 0);
+      return;
+    case SCOPE_LOCAL:
+      if (local_reg(c, symbol) != dst)
+        emit(c, REG_MOVE, dst, local_reg(c, symbol), 0);
+      return;
+    case SCOPE_BUILTIN:
+      emit(c, REG_GETBUILTIN, dst, symbol->index, 0);
+      return;
+    case SCOPE_FREE:
+      emit(c, REG_GETFREE, dst, symbol->index, 0);
+      return;
+    case SCOPE_FUNCTION:
+      emit(c, REG_CURRENTCLOSURE, dst, 0, 0);
+      return;
+  }
+}
+
+// a register holding the value of `exp`: a local's own register, or a
+// temporary the caller releases
+static CompilerErr compile_reg(RegCompiler c, Expression* exp, int* reg) {
+  if (exp->type == EXPRESSION_IDENTIFIER) {
+    Symbol* symbol;
+    CHECK(resolve(c, exp->node, &symbol));
+    if (symbol->scope == SCOPE_LOCAL) {
+      *reg = local_reg(c, symbol);
+      return NULL;
+    }
+  }
+  CHECK(alloc_reg(c, reg));
+  return compile_exp(c, exp, *reg);
+}
+
+// like compile_reg(), but int and string literals are used straight from
+// the constant pool
+static CompilerErr compile_rk(RegCompiler c, Expression* exp, int* rk) {
+  if (is_constant_literal(exp)) {
+    int index;
+    CHECK(literal_constant(c, exp, &index));
+    if (index <= REG_MAX_RK_CONSTANT) {
+      *rk = index | REG_CONSTANT;
+      return NULL;
+    }
+  }
+  return compile_reg(c, exp, rk);
+}
+
+static CompilerErr compile_infix(
+  RegCompiler c, InfixExpression* infix, int dst) {
+  RegOpCode op;
+  switch ((int)infix->operator[0]) {
+    case '+':
+      op = REG_ADD;
+      break;
+    case '-':
+      op = REG_SUB;
+      break;
+    case '*':
+      op = REG_MUL;
+      break;
+    case '/':
+      op = REG_DIV;
+      break;
+    case '=':
+      op = REG_EQ;
+      break;
+    case '!':
+      op = REG_NE;
+      break;
+    case '>':
+    case '<':
+      op = REG_GT;
+      break;
+    default: {
+      char* err = malloc(100);
+      sprintf(err, "unknown operator %s", infix->operator);
+      return err;
+    }
+  }
+  // `a < b` is `b > a`, evaluated right to left like the stack compiler does
+  bool swap = infix->operator[0] == '<';
+  int saved = c->fs->free_reg;
+  int left, right;
+  CHECK(compile_rk(c, swap ? infix->right : infix->left, &left));
+  CHECK(compile_rk(c, swap ? infix->left : infix->right, &right));
+  emit(c, op, dst, left, right);
+  c->fs->free_reg = saved;
+  return NULL;
+}
+
+// emits a jump taken when `condition` is falsy, to be patched by the caller
+static CompilerErr compile_condition(
+  RegCompiler c, Expression* condition, int* jump) {
+  int saved = c->fs->free_reg;
+  if (condition->type == EXPRESSION_INFIX) {
+    InfixExpression* infix = condition->node;
+    RegOpCode op = REG_JMPIFNOT;
+    if (strcmp(infix->operator, "==") == 0)
+      op = REG_JMPIFNOTEQ;
+    else if (strcmp(infix->operator, "!=") == 0)
+      op = REG_JMPIFEQ;
+    else if (strcmp(infix->operator, ">") == 0 ||
+             strcmp(infix->operator, "<") == 0)
+      op = REG_JMPIFNOTGT;
+    if (op != REG_JMPIFNOT) {
+      bool swap = infix->operator[0] == '<';
+      int left, right;
+      CHECK(compile_rk(c, swap ? infix->right : infix->left, &left));
+      CHECK(compile_rk(c, swap ? infix->left : infix->right, &right));
+      *jump = emit(c, op, 0, left, right);
+      c->fs->free_reg = saved;
+      return NULL;
+    }
+  }
+  int reg;
+  CHECK(compile_reg(c, condition, &reg));
+  *jump = emit(c, REG_JMPIFNOT, reg, 0, 0);
+  c->fs->free_reg = saved;
+  return NULL;
+}
+
+static bool ends_in_return(BlockStatement* block) {
+  List* last = block->statements;
+  while (last != NULL && last->next != NULL)
+    last = last->next;
+  return last != NULL && last->item != NULL &&
+         ((Statement*)last->item)->type == STATEMENT_RETURN;
+}
+
+static CompilerErr compile_if(RegCompiler c, IfExpression* if_exp, int dst) {
+  int jump_not_truthy;
+  CHECK(compile_condition(c, if_exp->condition, &jump_not_truthy));
+  CHECK(compile_block(c, if_exp->consequence, dst));
+  bool no_alternative = if_exp->alternative == NULL && dst == DISCARD;
+  int jump = -1;
+  if (!no_alternative && !ends_in_return(if_exp->consequence))
+    jump = emit(c, REG_JMP, 0, 0, 0);
+  patch_jump(c, jump_not_truthy);
+  if (if_exp->alternative != NULL)
+    CHECK(compile_block(c, if_exp->alternative, dst));
+  else if (dst != DISCARD)
+    emit(c, REG_LOADNULL, dst, 0, 0);
+  if (jump != -1)
+    patch_jump(c, jump);
+  return NULL;
+}
+
+// the callee and its arguments go in consecutive registers, and the result
+// lands where the callee was, so a call into the newest temporary needs no
+// move afterwards
+static CompilerErr compile_call(
+  RegCompiler c, CallExpression* call, int dst, bool tail) {
+  FnState* fs = c->fs;
+  int saved = fs->free_reg;
+  int callee = dst;
+  if (tail || dst != fs->free_reg - 1 || dst < fs->num_named)
+    CHECK(alloc_reg(c, &callee));
+  CHECK(compile_exp(c, call->fn, callee));
+  for (List* current = call->arguments; current != NULL;
+       current = current->next) {
+    int arg;
+    CHECK(alloc_reg(c, &arg));
+    CHECK(compile_exp(c, current->item, arg));
+  }
+  int num_args = list_count(call->arguments);
+  if (tail) {
+    // only builtins return here, closures replace the caller's frame
+    emit(c, REG_TAILCALL, callee, num_args, 0);
+    emit(c, REG_RETURN, 0, callee, 0);
+  } else {
+    emit(c, REG_CALL, callee, num_args, 0);
+    if (callee != dst)
+      emit(c, REG_MOVE, dst, callee, 0);
+  }
+  fs->free_reg = saved;
+  return NULL;
+}
+
+// the elements are evaluated into `count` consecutive temporaries
+static CompilerErr compile_window(
+  RegCompiler c, Expression** elements, int count, int* start) {
+  *start = c->fs->free_reg;
+  for (int i = 0; i < count; i++) {
+    int reg;
+    CHECK(alloc_reg(c, &reg));
+    CHECK(compile_exp(c, elements[i], reg));
+  }
+  return NULL;
+}
+
+// a literal longer than REG_LITERAL_CHUNK is started by `op` and continued
+// by `append`, a chunk at a time. It's built in a temporary and only moved
+// to `dst` when complete, as the elements may read `dst`
+static CompilerErr compile_literal(RegCompiler c, Expression** elements,
+  int count, RegOpCode op, RegOpCode append, int sx, int dst) {
+  int saved = c->fs->free_reg;
+  int target = dst;
+  if (count > REG_LITERAL_CHUNK)
+    CHECK(alloc_reg(c, &target));
+  int chunk_saved = c->fs->free_reg;
+  int i = 0;
+  do {
+    int length = count - i;
+    if (length > REG_LITERAL_CHUNK)
+      length = REG_LITERAL_CHUNK;
+    int start;
+    CHECK(compile_window(c, &elements[i], length, &start));
+    emit_sx(c, i == 0 ? op : append, target, start, length, sx);
+    c->fs->free_reg = chunk_saved;
+    i += length;
+  } while (i < count);
+  if (target != dst)
+    emit(c, REG_MOVE, dst, target, 0);
+  c->fs->free_reg = saved;
+  return NULL;
+}
+
+static CompilerErr compile_array(
+  RegCompiler c, ArrayLiteral* array, int dst) {
+  int count = list_count(array->elements);
+  Expression* elements[count > 0 ? count : 1];
+  List* current = array->elements;
+  for (int i = 0; i < count; i++, current = current->next)
+    elements[i] = current->item;
+  return compile_literal(
+    c, elements, count, REG_ARRAY, REG_ARRAYAPPEND, 0, dst);
+}
+
+static CompilerErr compile_hash(
+  RegCompiler c, HashLiteralExpression* hash, int dst) {
+  int count = list_count(hash->pairs) * 2;
+  if (count / 2 > INT16_MAX)
+    return "too many hash pairs";
+  Expression* elements[count > 0 ? count : 1];
+  List* current = hash->pairs;
+  for (int i = 0; i < count; i += 2, current = current->next) {
+    HashLiteralPair* pair = current->item;
+    elements[i] = pair->key;
+    elements[i + 1] = pair->value;
+  }
+  return compile_literal(
+    c, elements, count, REG_HASH, REG_HASHADD, count / 2, dst);
+}
+
+// the first register of `symbols` if they are locals in consecutive
+// registers, else -1
+static int consecutive_locals(RegCompiler c, Symbol** symbols, int length) {
+  for (int i = 0; i < length; i++)
+    if (symbols[i]->scope != SCOPE_LOCAL ||
+        local_reg(c, symbols[i]) != local_reg(c, symbols[0]) + i)
+      return -1;
+  return local_reg(c, symbols[0]);
+}
+
+static CompilerErr compile_function(
+  RegCompiler c, FunctionLiteral* fn_lit, int dst) {
+  FnState fs;
+  fn_state_init(&fs, c->fs);
+  c->fs = &fs;
+  c->symbol_table = symbol_table_new_enclosed(c->symbol_table);
+  if (fn_lit->name)
+    symbol_table_define_fn_name(c->symbol_table, fn_lit->name);
+  int num_params = list_count(fn_lit->parameters);
+  for (List* current = fn_lit->parameters; current != NULL;
+       current = current->next) {
+    Identifier* param = current->item;
+    bind_local(c, symbol_table_define(c->symbol_table, param->value));
+  }
+  fs.num_named = num_params + count_lets(fn_lit->body->statements);
+  if (fs.num_named > MAX_REGISTERS)
+    return "too many registers";
+  fs.free_reg = fs.num_regs = fs.num_named;
+  CHECK(compile_block_tail(c, fn_lit->body));
+
+  SymbolTable symbol_table = c->symbol_table;
+  Symbol** free_symbols = symbol_table_get_free(symbol_table);
+  int num_free = symbol_table_num_free(symbol_table);
+  c->symbol_table = symbol_table_outer(symbol_table);
+  c->fs = fs.outer;
+
+  CompiledFunction* compiled_fn = malloc(sizeof(CompiledFunction));
+  compiled_fn->instructions = fn_state_instructions(&fs);
+  compiled_fn->num_locals = fs.num_regs;
+  compiled_fn->num_params = num_params;
+  compiled_fn->closure = NULL;
+  compiled_fn->native = NULL;
+  Object* compiled_fn_obj = object_alloc(COMPILED_FUNCTION_OBJ);
+  compiled_fn_obj->value.compiled_fn = compiled_fn;
+  int constant_idx;
+  CHECK(add_constant(c, compiled_fn_obj, &constant_idx));
+
+  // the captured values are copied out of consecutive registers, which
+  // may already be the enclosing function's own locals
+  int saved = c->fs->free_reg;
+  int start = num_free > 0 ? consecutive_locals(c, free_symbols, num_free) : 0;
+  if (start == -1) {
+    start = c->fs->free_reg;
+    for (int i = 0; i < num_free; i++) {
+      int reg;
+      CHECK(alloc_reg(c, &reg));
+      load_symbol(c, free_symbols[i], reg);
+    }
+  }
+  emit_sx(c, REG_CLOSURE, dst, constant_idx, num_free, start);
+  c->fs->free_reg = saved;
+  return NULL;
+}
+
+static CompilerErr compile_exp(RegCompiler c, Expression* exp, int dst) {
+  switch (exp->type) {
+    case EXPRESSION_INTEGER_LITERAL:
+    case EXPRESSION_STRING_LITERAL: {
+      int index;
+      CHECK(literal_constant(c, exp, &index));
+      emit(c, REG_LOADK, dst, index, 0);
+      return NULL;
+    }
+
+    case EXPRESSION_BOOLEAN_LITERAL: {
+      bool value = ((BooleanLiteral*)exp->node)->value;
+      emit(c, value ? REG_LOADTRUE : REG_LOADFALSE, dst, 0, 0);
+      return NULL;
+    }
+
+    case EXPRESSION_IDENTIFIER: {
+      Symbol* symbol;
+      CHECK(resolve(c, exp->node, &symbol));
+      load_symbol(c, symbol, dst);
+      return NULL;
+    }
+
+    case EXPRESSION_INFIX:
+      return compile_infix(c, exp->node, dst);
+
+    case EXPRESSION_PREFIX: {
+      PrefixExpression* prefix = exp->node;
+      RegOpCode op;
+      if (prefix->operator[0] == '!') {
+        op = REG_NOT;
+      } else if (prefix->operator[0] == '-') {
+        op = REG_NEG;
+      } else {
+        char* err = malloc(100);
+        sprintf(err, "unknown operator %s", prefix->operator);
+        return err;
+      }
+      int saved = c->fs->free_reg;
+      int operand;
+      CHECK(compile_rk(c, prefix->right, &operand));
+      emit(c, op, dst, operand, 0);
+      c->fs->free_reg = saved;
+      return NULL;
+    }
+
+    case EXPRESSION_ARRAY_LITERAL:
+      return compile_array(c, exp->node, dst);
+
+    case EXPRESSION_HASH_LITERAL:
+      return compile_hash(c, exp->node, dst);
+
+    case EXPRESSION_INDEX: {
+      IndexExpression* index_exp = exp->node;
+      int saved = c->fs->free_reg;
+      int left, index;
+      CHECK(compile_reg(c, index_exp->left, &left));
+      CHECK(compile_rk(c, index_exp->index, &index));
+      emit(c, REG_INDEX, dst, left, index);
+      c->fs->free_reg = saved;
+      return NULL;
+    }
+
+    case EXPRESSION_FUNCTION_LITERAL:
+      return compile_function(c, exp->node, dst);
+
+    case EXPRESSION_CALL:
+      return compile_call(c, exp->node, dst, false);
+
+    case EXPRESSION_IF:
+      return compile_if(c, exp->node, dst);
+
+    default:
+      return "unknown expression type";
+  }
+}
+
+// compiles `exp` as the value returned by the current function: each branch
+// of an `if` returns on its own, and calls become tail calls
+static CompilerErr compile_tail(RegCompiler c, Expression* exp) {
+  if (exp->type == EXPRESSION_CALL)
+    return compile_call(c, exp->node, 0, true);
+
+  if (exp->type == EXPRESSION_IF) {
+    IfExpression* if_exp = exp->node;
+    int jump_not_truthy;
+    CHECK(compile_condition(c, if_exp->condition, &jump_not_truthy));
+    CHECK(compile_block_tail(c, if_exp->consequence));
+    patch_jump(c, jump_not_truthy);
+    if (if_exp->alternative == NULL) {
+      emit(c, REG_RETURNNULL, 0, 0, 0);
+      return NULL;
+    }
+    return compile_block_tail(c, if_exp->alternative);
+  }
+
+  int saved = c->fs->free_reg;
+  int value;
+  CHECK(compile_rk(c, exp, &value));
+  emit(c, REG_RETURN, 0, value, 0);
+  c->fs->free_reg = saved;
+  return NULL;
+}
+
+// statements whose value is unused; expression statements are evaluated for
+// their side effects into a temporary
+static CompilerErr compile_statement(RegCompiler c, Statement* stmt) {
+  switch (ast_statement_node_type(stmt)) {
+    case LET_STATEMENT_NODE: {
+      LetStatement* let_stmt = stmt->node;
+      Symbol* symbol =
+        symbol_table_define(c->symbol_table, let_stmt->name->value);
+      if (symbol->scope == SCOPE_LOCAL) {
+        bind_local(c, symbol);
+        return compile_exp(c, let_stmt->value, local_reg(c, symbol));
+      }
+      int saved = c->fs->free_reg;
+      int value;
+      CHECK(compile_rk(c, let_stmt->value, &value));
+      emit(c, REG_SETGLOBAL, 0, value, symbol->index);
+      c->fs->free_reg = saved;
+      return NULL;
+    }
+
+    case RETURN_STATEMENT_NODE:
+      return compile_tail(c, ((ReturnStatement*)stmt->node)->return_value);
+
+    default: {
+      Expression* exp = ((ExpressionStatement*)stmt->node)->expression;
+      if (exp->type == EXPRESSION_IF)
+        return compile_if(c, exp->node, DISCARD);
+      int saved = c->fs->free_reg;
+      int reg;
+      CHECK(alloc_reg(c, &reg));
+      CHECK(compile_exp(c, exp, reg));
+      c->fs->free_reg = saved;
+      return NULL;
+    }
+  }
+}
+
+// a block's value is its last expression statement's, or null
+static CompilerErr compile_block(
+  RegCompiler c, BlockStatement* block, int dst) {
+  Statement* last = NULL;
+  for (List* current = block->statements; current != NULL;
+       current = current->next) {
+    Statement* stmt = current->item;
+    if (stmt == NULL)
+      continue;
+    if (current->next == NULL && stmt->type == STATEMENT_EXPRESSION &&
+        dst != DISCARD) {
+      ExpressionStatement* exp_stmt = stmt->node;
+      return compile_exp(c, exp_stmt->expression, dst);
+    }
+    CHECK(compile_statement(c, stmt));
+    last = stmt;
+  }
+  if (dst != DISCARD && (last == NULL || last->type != STATEMENT_RETURN))
+    emit(c, REG_LOADNULL, dst, 0, 0);
+  return NULL;
+}
+
+static CompilerErr compile_block_tail(RegCompiler c, BlockStatement* block) {
+  Statement* last = NULL;
+  for (List* current = block->statements; current != NULL;
+       current = current->next) {
+    Statement* stmt = current->item;
+    if (stmt == NULL)
+      continue;
+    if (current->next == NULL && stmt->type == STATEMENT_EXPRESSION) {
+      ExpressionStatement* exp_stmt = stmt->node;
+      return compile_tail(c, exp_stmt->expression);
+    }
+    CHECK(compile_statement(c, stmt));
+    last = stmt;
+  }
+  if (last == NULL || last->type != STATEMENT_RETURN)
+    emit(c, REG_RETURNNULL, 0, 0, 0);
+  return NULL;
+}
+
+// top-level expression statements all leave their value in register 0,
+// which the program returns when it runs off the end
+CompilerErr reg_compile(RegCompiler c, Program* program) {
+  FnState fs;
+  fn_state_init(&fs, NULL);
+  c->fs = &fs;
+  int result_reg;
+  alloc_reg(c, &result_reg);
+  for (List* current = program->statements; current != NULL;
+       current = current->next) {
+    Statement* stmt = current->item;
+    if (stmt == NULL)
+      continue;
+    if (stmt->type == STATEMENT_EXPRESSION) {
+      ExpressionStatement* exp_stmt = stmt->node;
+      CHECK(compile_exp(c, exp_stmt->expression, result_reg));
+    } else {
+      CHECK(compile_statement(c, stmt));
+    }
+  }
+  emit(c, REG_RETURN, 0, result_reg, 0);
+  c->main = fn_state_instructions(&fs);
+  c->fs = NULL;
+  return NULL;
+}
+
+Bytecode* reg_compiler_bytecode(RegCompiler c) {
+  Bytecode* bytecode = malloc(sizeof(Bytecode));
+  bytecode->constants = c->constant_pool;
+  bytecode->instructions = c->main;
+  return bytecode;
+}
+
+static int count_lets_in(Expression* exp);
+
+static int count_lets_in_block(BlockStatement* block) {
+  return block == NULL ? 0 : count_lets(block->statements);
+}
+
+static int count_lets_in_list(List* expressions) {
+  int count = 0;
+  for (List* current = expressions; current != NULL; current = current->next)
+    count += count_lets_in(current->item);
+  return count;
+}
+
+// `let`s inside blocks still bind in the enclosing function, so every one
+// reachable without crossing into another function literal needs a register
+static int count_lets_in(Expression* exp) {
+  switch (exp->type) {
+    case EXPRESSION_INFIX: {
+      InfixExpression* infix = exp->node;
+      return count_lets_in(infix->left) + count_lets_in(infix->right);
+    }
+    case EXPRESSION_PREFIX:
+      return count_lets_in(((PrefixExpression*)exp->node)->right);
+    case EXPRESSION_IF: {
+      IfExpression* if_exp = exp->node;
+      return count_lets_in(if_exp->condition) +
+             count_lets_in_block(if_exp->consequence) +
+             count_lets_in_block(if_exp->alternative);
+    }
+    case EXPRESSION_CALL: {
+      CallExpression* call = exp->node;
+      return count_lets_in(call->fn) + count_lets_in_list(call->arguments);
+    }
+    case EXPRESSION_ARRAY_LITERAL:
+      return count_lets_in_list(((ArrayLiteral*)exp->node)->elements);
+    case EXPRESSION_HASH_LITERAL: {
+      int count = 0;
+      List* pairs = ((HashLiteralExpression*)exp->node)->pairs;
+      for (List* current = pairs; current != NULL; current = current->next) {
+        HashLiteralPair* pair = current->item;
+        count += count_lets_in(pair->key) + count_lets_in(pair->value);
+      }
+      return count;
+    }
+    case EXPRESSION_INDEX: {
+      IndexExpression* index_exp = exp->node;
+      return count_lets_in(index_exp->left) + count_lets_in(index_exp->index);
+    }
+    default:
+      return 0;
+  }
+}
+
+static int count_lets(List* statements) {
+  int count = 0;
+  for (List* current = statements; current != NULL; current = current->next) {
+    Statement* stmt = current->item;
+    if (stmt == NULL)
+      continue;
+    switch (stmt->type) {
+      case STATEMENT_LET:
+        count += 1 + count_lets_in(((LetStatement*)stmt->node)->value);
+        break;
+      case STATEMENT_RETURN:
+        count += count_lets_in(((ReturnStatement*)stmt->node)->return_value);
+        break;
+      default:
+        count +=
+          count_lets_in(((ExpressionStatement*)stmt->node)->expression);
+    }
+  }
+  return count;
+}
+
+char* reg_opcode_name(RegOpCode op) {
+  return op < NUM_REG_OPCODES ? names[op] : "Unknown";
+}
+
+static int rk_str(char* str, int rk) {
+  if (rk & REG_CONSTANT)
+    return sprintf(str, " K%d", rk & ~REG_CONSTANT);
+  return sprintf(str, " R%d", rk);
+}
+
+char* reg_instructions_str(Instruct* instructions) {
+  RegIns* ins = (RegIns*)instructions->bytes;
+  int length = instructions->length / sizeof(RegIns);
+  char* str = malloc(64 * length + 1);
+  int pos = 0;
+  str[0] = '\0';
+  for (int i = 0; i < length; i++) {
+    RegIns in = ins[i];
+    pos += sprintf(&str[pos], "%04d %s", i, reg_opcode_name(in.op));
+    switch (in.op) {
+      case REG_LOADK:
+        pos += sprintf(&str[pos], " R%d K%d", in.a, in.b);
+        break;
+      case REG_LOADNULL:
+      case REG_LOADTRUE:
+      case REG_LOADFALSE:
+      case REG_CURRENTCLOSURE:
+        pos += sprintf(&str[pos], " R%d", in.a);
+        break;
+      case REG_MOVE:
+      case REG_ARRAY:
+      case REG_ARRAYAPPEND:
+      case REG_HASHADD:
+        pos += sprintf(&str[pos], " R%d R%d", in.a, in.b);
+        if (in.op != REG_MOVE)
+          pos += sprintf(&str[pos], " %d", in.c);
+        break;
+      case REG_HASH:
+        pos += sprintf(&str[pos], " R%d R%d %d %d", in.a, in.b, in.c, in.sx);
+        break;
+      case REG_GETGLOBAL:
+      case REG_GETFREE:
+      case REG_GETBUILTIN:
+      case REG_CALL:
+      case REG_TAILCALL:
+        pos += sprintf(&str[pos], " R%d %d", in.a, in.b);
+        break;
+      case REG_SETGLOBAL:
+        pos += rk_str(&str[pos], in.b);
+        pos += sprintf(&str[pos], " %d", in.c);
+        break;
+      case REG_NEG:
+      case REG_NOT:
+        pos += sprintf(&str[pos], " R%d", in.a);
+        pos += rk_str(&str[pos], in.b);
+        break;
+      case REG_RETURN:
+        pos += rk_str(&str[pos], in.b);
+        break;
+      case REG_JMP:
+        pos += sprintf(&str[pos], " %d", i + 1 + in.sx);
+        break;
+      case REG_JMPLONG:
+        pos += sprintf(&str[pos], " %d", i + 1 + REG_LONG_OFFSET(&in));
+        break;
+      case REG_JMPIFNOT:
+        pos += sprintf(&str[pos], " R%d %d", in.a, i + 1 + in.sx);
+        break;
+      case REG_JMPIFNOTEQ:
+      case REG_JMPIFEQ:
+      case REG_JMPIFNOTGT:
+        pos += rk_str(&str[pos], in.b);
+        pos += rk_str(&str[pos], in.c);
+        pos += sprintf(&str[pos], " %d", i + 1 + in.sx);
+        break;
+      case REG_CLOSURE:
+        pos += sprintf(&str[pos], " R%d K%d %d R%d", in.a, in.b, in.c, in.sx);
+        break;
+      case REG_RETURNNULL:
+        break;
+      case REG_INDEX:
+        pos += sprintf(&str[pos], " R%d R%d", in.a, in.b);
+        pos += rk_str(&str[pos], in.c);
+        break;
+      default:  // binary operators
+        pos += sprintf(&str[pos], " R%d", in.a);
+        pos += rk_str(&str[pos], in.b);
+        pos += rk_str(&str[pos], in.c);
+    }
+    str[pos++] = '\n';
+    str[pos] = '\0';
+  }
+  return str;
+}
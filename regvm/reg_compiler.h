@@ -0,0 +1,95 @@
+#ifndef __REG_COMPILER_H__
+#define __REG_COMPILER_H__
+
+#include <stdint.h>
+#include "../ast/ast.h"
+#include "../compiler/compiler.h"
+
+// registers are addressed by a one-byte operand
+#define MAX_REGISTERS 256
+
+// array and hash literals are built from windows of at most this many
+// temporaries, so their size isn't bound by the number of registers
+#define REG_LITERAL_CHUNK 64
+
+// set on a `b` or `c` operand that names a constant instead of a register
+#define REG_CONSTANT 0x8000
+#define REG_MAX_RK_CONSTANT (REG_CONSTANT - 1)
+
+/**
+ * Register machine instructions, the alternative to the stack VM's opcodes
+ * run by `monkey run -r`. Each instruction names where its operands live
+ * and where its result goes, so locals are read in place rather than
+ * pushed, and a value is never popped just to be dropped. In the comments
+ * below R(x) is register x of the current frame, K(x) constant x, and RK(x)
+ * either one, a constant when x has the REG_CONSTANT bit set.
+ */
+enum RegOpCodes {
+  REG_LOADK,            // R(a) = K(b)
+  REG_LOADNULL,         // R(a) = null
+  REG_LOADTRUE,         // R(a) = true
+  REG_LOADFALSE,        // R(a) = false
+  REG_MOVE,             // R(a) = R(b)
+  REG_GETGLOBAL,        // R(a) = global b
+  REG_SETGLOBAL,        // global c = RK(b)
+  REG_GETFREE,          // R(a) = free variable b of the current closure
+  REG_GETBUILTIN,       // R(a) = builtin b
+  REG_CURRENTCLOSURE,   // R(a) = the current closure
+  REG_ADD,              // R(a) = RK(b) + RK(c)
+  REG_SUB,              // R(a) = RK(b) - RK(c)
+  REG_MUL,              // R(a) = RK(b) * RK(c)
+  REG_DIV,              // R(a) = RK(b) / RK(c)
+  REG_EQ,               // R(a) = RK(b) == RK(c)
+  REG_NE,               // R(a) = RK(b) != RK(c)
+  REG_GT,               // R(a) = RK(b) > RK(c)
+  REG_NEG,              // R(a) = -RK(b)
+  REG_NOT,              // R(a) = !RK(b)
+  REG_JMP,              // ip += sx
+  REG_JMPLONG,          // ip += b | c << 16, for offsets sx can't hold
+  REG_JMPIFNOT,         // if !R(a) then ip += sx
+  REG_JMPIFNOTEQ,       // if !(RK(b) == RK(c)) then ip += sx
+  REG_JMPIFEQ,          // if !(RK(b) != RK(c)) then ip += sx
+  REG_JMPIFNOTGT,       // if !(RK(b) > RK(c)) then ip += sx
+  REG_CALL,             // R(a) = R(a)(R(a + 1), ..., R(a + b))
+  REG_TAILCALL,         // return R(a)(R(a + 1), ..., R(a + b))
+  REG_RETURN,           // return RK(b)
+  REG_RETURNNULL,       // return null
+  REG_CLOSURE,          // R(a) = closure of K(b) over R(sx)...R(sx + c - 1)
+  REG_ARRAY,            // R(a) = [R(b), ..., R(b + c - 1)]
+  REG_ARRAYAPPEND,      // R(a) = [...R(a), R(b), ..., R(b + c - 1)]
+  REG_HASH,             // R(a) = {R(b): R(b + 1), ...} from c registers,
+                        // with room for sx pairs in all
+  REG_HASHADD,          // R(a) += {R(b): R(b + 1), ...} from c registers
+  REG_INDEX,            // R(a) = R(b)[RK(c)]
+  NUM_REG_OPCODES,
+};
+
+typedef uint8_t RegOpCode;
+
+// fixed width, so jumps count instructions rather than bytes
+typedef struct RegIns {
+  RegOpCode op;
+  uint8_t a;
+  uint16_t b;
+  uint16_t c;
+  int16_t sx;  // jump offset from the next instruction, or a register
+} RegIns;
+
+#define REG_LONG_OFFSET(ins) ((int32_t)((ins)->b | (uint32_t)(ins)->c << 16))
+
+// incomplete declaration for encapsulation
+typedef struct RegCompiler_t* RegCompiler;
+
+/**
+ * Compiles a program to register machine code. The result reuses the stack
+ * compiler's containers: instruction arrays are stored as the bytes of an
+ * `Instruct`, and every function literal is a COMPILED_FUNCTION_OBJ in the
+ * constant pool whose `num_locals` is the number of registers it uses.
+ */
+RegCompiler reg_compiler_new(void);
+CompilerErr reg_compile(RegCompiler c, Program* program);
+Bytecode* reg_compiler_bytecode(RegCompiler c);
+char* reg_opcode_name(RegOpCode op);
+char* reg_instructions_str(Instruct* instructions);
+
+#endif  // __REG_COMPILER_H__
@@ -0,0 +1,621 @@
+#include "reg_vm.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "reg_compiler.h"
+
+#define MAX_FRAMES 1024
+#define REGISTER_FILE_SIZE (MAX_FRAMES * 64)
+
+#define SET_ERR(fmt, ...)             \
+  do {                                \
+    err = malloc(500 * sizeof(char)); \
+    sprintf(err, fmt, __VA_ARGS__);   \
+  } while (0)
+
+typedef struct RegFrame {
+  Closure* cl;
+  RegIns* ip;
+  int base;  // the frame's register 0, the callee sits just below it
+} RegFrame;
+
+struct RegVm_t {
+  Value* constants;
+  int num_constants;
+  Value* globals;
+  int num_globals;  // globals at or past this index are unset
+  RegFrame frames[MAX_FRAMES];
+  int frames_index;
+  Heap heap;
+  VmStats stats;
+  Value registers[REGISTER_FILE_SIZE];
+};
+
+static VmErr run(RegVm vm);
+static VmErr call_value(RegVm vm, int callee, int num_args);
+static VmErr tail_call_value(RegVm vm, int callee, int num_args);
+static VmErr binary_operation(
+  RegOpCode op, Value left, Value right, Value* out);
+static VmErr comparison(RegOpCode op, Value left, Value right, Value* out);
+static VmErr index_value(Value left, Value index, Value* out);
+static VmErr build_hash(Value* elements, int length, int room, Value* out);
+static VmErr add_pairs(Hash* hash, Value* elements, int length);
+static VmErr make_closure(
+  Value constant, int num_free, Value* free, Value* out);
+static Closure* new_closure(CompiledFunction* fn, int num_free);
+static void collect_garbage(RegVm vm);
+
+static VmErr err = NULL;
+
+RegVm reg_vm_new(Bytecode* bytecode) {
+  struct RegVm_t* vm = malloc(sizeof(struct RegVm_t));
+  ConstantPool* pool = bytecode->constants;
+  vm->constants = malloc(sizeof(Value) * (pool->length + 1));
+  for (int i = 0; i < pool->length; i++)
+    vm->constants[i] = value_from(pool->constants[i]);
+  vm->num_constants = pool->length;
+  vm->globals = calloc(GLOBALS_SIZE, sizeof(Value));
+  vm->num_globals = 0;
+  vm->stats = (VmStats){0};
+  heap_init(&vm->heap);
+
+  // the top-level code may address any register, its result goes below it
+  CompiledFunction* main_fn = malloc(sizeof(CompiledFunction));
+  main_fn->instructions = bytecode->instructions;
+  main_fn->num_locals = MAX_REGISTERS;
+  main_fn->num_params = 0;
+  main_fn->closure = NULL;
+  main_fn->native = NULL;
+  Closure* main_closure = new_closure(main_fn, 0);
+  vm->registers[0] = VALUE_OBJ(main_closure->object);
+  for (int i = 1; i <= MAX_REGISTERS; i++)
+    vm->registers[i] = VALUE_NULL;
+  vm->frames[0] = (RegFrame){
+    .cl = main_closure,
+    .ip = (RegIns*)main_fn->instructions->bytes,
+    .base = 1,
+  };
+  vm->frames_index = 1;
+  return vm;
+}
+
+VmErr reg_vm_run(RegVm vm) {
+  long allocations[NUM_OBJECT_TYPES];
+  for (int type = 0; type < NUM_OBJECT_TYPES; type++)
+    allocations[type] = object_alloc_count_of(type);
+  heap_activate(&vm->heap);
+  VmErr run_err = run(vm);
+  heap_activate(NULL);
+  for (int type = 0; type < NUM_OBJECT_TYPES; type++) {
+    long allocated = object_alloc_count_of(type) - allocations[type];
+    vm->stats.allocations_by_type[type] += allocated;
+    vm->stats.allocations += allocated;
+  }
+  return run_err;
+}
+
+VmStats reg_vm_stats(RegVm vm) {
+  return vm->stats;
+}
+
+// the value returned by the top-level code: its last expression statement's
+Object* reg_vm_result(RegVm vm) {
+  return value_box(vm->registers[0]);
+}
+
+#if defined(__GNUC__) && !defined(MONKEY_SWITCH_DISPATCH)
+#define COMPUTED_GOTO
+#endif
+
+#ifdef MONKEY_PROFILE
+#define PROFILE_DISPATCH() vm->stats.dispatches++
+#else
+#define PROFILE_DISPATCH()
+#endif
+
+// every function ends in a return, so there is no end of code to check for
+#ifdef COMPUTED_GOTO
+#pragma GCC diagnostic ignored "-Wpedantic"
+#define TARGET(op) L_##op:
+#define DISPATCH()                 \
+  do {                             \
+    ins = ip++;                    \
+    PROFILE_DISPATCH();            \
+    goto* dispatch_table[ins->op]; \
+  } while (0)
+#else
+#define TARGET(op) case op:
+#define DISPATCH() continue
+#endif
+
+#define SAVE_FRAME() frame->ip = ip
+#define LOAD_FRAME()                           \
+  do {                                         \
+    frame = &vm->frames[vm->frames_index - 1]; \
+    ip = frame->ip;                            \
+    regs = &vm->registers[frame->base];        \
+  } while (0)
+
+#define RK(x) ((x)&REG_CONSTANT ? k[(x) & ~REG_CONSTANT] : regs[x])
+
+// only called right after an instruction's result is stored, when every
+// live value is reachable from the registers, globals, frames or constants
+#define COLLECT_GARBAGE()                 \
+  do {                                    \
+    if (heap_needs_collection(&vm->heap)) \
+      collect_garbage(vm);                \
+  } while (0)
+
+// both operands are ints iff the int tag survives and-ing them together
+#define BOTH_INTS(left, right) VALUE_IS_INT((left) & (right))
+
+#define CHECK(expr) \
+  do {              \
+    err = (expr);   \
+    if (err)        \
+      return err;   \
+  } while (0)
+
+static VmErr run(RegVm vm) {
+  RegFrame* frame;
+  RegIns* ip;
+  RegIns* ins;
+  Value* regs;
+  Value* k = vm->constants;
+  LOAD_FRAME();
+
+#ifdef COMPUTED_GOTO
+  static void* dispatch_table[] = {
+    [REG_LOADK] = &&L_REG_LOADK,
+    [REG_LOADNULL] = &&L_REG_LOADNULL,
+    [REG_LOADTRUE] = &&L_REG_LOADTRUE,
+    [REG_LOADFALSE] = &&L_REG_LOADFALSE,
+    [REG_MOVE] = &&L_REG_MOVE,
+    [REG_GETGLOBAL] = &&L_REG_GETGLOBAL,
+    [REG_SETGLOBAL] = &&L_REG_SETGLOBAL,
+    [REG_GETFREE] = &&L_REG_GETFREE,
+    [REG_GETBUILTIN] = &&L_REG_GETBUILTIN,
+    [REG_CURRENTCLOSURE] = &&L_REG_CURRENTCLOSURE,
+    [REG_ADD] = &&L_REG_ADD,
+    [REG_SUB] = &&L_REG_SUB,
+    [REG_MUL] = &&L_REG_MUL,
+    [REG_DIV] = &&L_REG_DIV,
+    [REG_EQ] = &&L_REG_EQ,
+    [REG_NE] = &&L_REG_NE,
+    [REG_GT] = &&L_REG_GT,
+    [REG_NEG] = &&L_REG_NEG,
+    [REG_NOT] = &&L_REG_NOT,
+    [REG_JMP] = &&L_REG_JMP,
+    [REG_JMPLONG] = &&L_REG_JMPLONG,
+    [REG_JMPIFNOT] = &&L_REG_JMPIFNOT,
+    [REG_JMPIFNOTEQ] = &&L_REG_JMPIFNOTEQ,
+    [REG_JMPIFEQ] = &&L_REG_JMPIFEQ,
+    [REG_JMPIFNOTGT] = &&L_REG_JMPIFNOTGT,
+    [REG_CALL] = &&L_REG_CALL,
+    [REG_TAILCALL] = &&L_REG_TAILCALL,
+    [REG_RETURN] = &&L_REG_RETURN,
+    [REG_RETURNNULL] = &&L_REG_RETURNNULL,
+    [REG_CLOSURE] = &&L_REG_CLOSURE,
+    [REG_ARRAY] = &&L_REG_ARRAY,
+    [REG_ARRAYAPPEND] = &&L_REG_ARRAYAPPEND,
+    [REG_HASH] = &&L_REG_HASH,
+    [REG_HASHADD] = &&L_REG_HASHADD,
+    [REG_INDEX] = &&L_REG_INDEX,
+  };
+  DISPATCH();
+#else
+  for (;;) {
+    ins = ip++;
+    PROFILE_DISPATCH();
+    switch (ins->op) {
+#endif
+
+  TARGET(REG_LOADK) {
+    regs[ins->a] = k[ins->b];
+  }
+  DISPATCH();
+
+  TARGET(REG_LOADNULL) {
+    regs[ins->a] = VALUE_NULL;
+  }
+  DISPATCH();
+
+  TARGET(REG_LOADTRUE) {
+    regs[ins->a] = VALUE_TRUE;
+  }
+  DISPATCH();
+
+  TARGET(REG_LOADFALSE) {
+    regs[ins->a] = VALUE_FALSE;
+  }
+  DISPATCH();
+
+  TARGET(REG_MOVE) {
+    regs[ins->a] = regs[ins->b];
+  }
+  DISPATCH();
+
+  TARGET(REG_GETGLOBAL) {
+    regs[ins->a] = vm->globals[ins->b];
+  }
+  DISPATCH();
+
+  TARGET(REG_SETGLOBAL) {
+    vm->globals[ins->c] = RK(ins->b);
+    if (ins->c >= vm->num_globals)
+      vm->num_globals = ins->c + 1;
+  }
+  DISPATCH();
+
+  TARGET(REG_GETFREE) {
+    regs[ins->a] = frame->cl->free[ins->b];
+  }
+  DISPATCH();
+
+  TARGET(REG_GETBUILTIN) {
+    regs[ins->a] = VALUE_OBJ(get_builtin_by_index(ins->b));
+    COLLECT_GARBAGE();
+  }
+  DISPATCH();
+
+  TARGET(REG_CURRENTCLOSURE) {
+    regs[ins->a] = VALUE_OBJ(frame->cl->object);
+  }
+  DISPATCH();
+
+// ints inline, everything else (and every error) through the helper
+#define BINARY_OPERATION(opcode, helper, int_result)       \
+  TARGET(opcode) {                                         \
+    Value left = RK(ins->b), right = RK(ins->c);           \
+    if (BOTH_INTS(left, right) &&                          \
+        (opcode != REG_DIV || right != VALUE_INT(0))) {    \
+      int l = VALUE_AS_INT(left), r = VALUE_AS_INT(right); \
+      regs[ins->a] = (int_result);                         \
+    } else {                                               \
+      CHECK(helper(ins->op, left, right, &regs[ins->a]));  \
+      COLLECT_GARBAGE();                                   \
+    }                                                      \
+  }                                                        \
+  DISPATCH();
+
+  BINARY_OPERATION(REG_ADD, binary_operation, VALUE_INT(l + r))
+  BINARY_OPERATION(REG_SUB, binary_operation, VALUE_INT(l - r))
+  BINARY_OPERATION(REG_MUL, binary_operation, VALUE_INT(l * r))
+  BINARY_OPERATION(REG_DIV, binary_operation, VALUE_INT(l / r))
+  BINARY_OPERATION(REG_EQ, comparison, VALUE_BOOL(l == r))
+  BINARY_OPERATION(REG_NE, comparison, VALUE_BOOL(l != r))
+  BINARY_OPERATION(REG_GT, comparison, VALUE_BOOL(l > r))
+
+// a comparison whose result only decides a jump
+#define COMPARE_AND_JUMP(opcode, compare_op, int_result)     \
+  TARGET(opcode) {                                           \
+    Value left = RK(ins->b), right = RK(ins->c);             \
+    bool result;                                             \
+    if (BOTH_INTS(left, right)) {                            \
+      int l = VALUE_AS_INT(left), r = VALUE_AS_INT(right);   \
+      result = (int_result);                                 \
+    } else {                                                 \
+      Value compared;                                        \
+      CHECK(comparison(compare_op, left, right, &compared)); \
+      result = compared == VALUE_TRUE;                       \
+    }                                                        \
+    if (!result)                                             \
+      ip += ins->sx;                                         \
+  }                                                          \
+  DISPATCH();
+
+  COMPARE_AND_JUMP(REG_JMPIFNOTEQ, REG_EQ, l == r)
+  COMPARE_AND_JUMP(REG_JMPIFEQ, REG_NE, l != r)
+  COMPARE_AND_JUMP(REG_JMPIFNOTGT, REG_GT, l > r)
+
+  TARGET(REG_NEG) {
+    Value operand = RK(ins->b);
+    if (!VALUE_IS_INT(operand)) {
+      SET_ERR("unsupported type for negation: %s", value_type(operand));
+      return err;
+    }
+    regs[ins->a] = VALUE_INT(-VALUE_AS_INT(operand));
+  }
+  DISPATCH();
+
+  TARGET(REG_NOT) {
+    Value operand = RK(ins->b);
+    regs[ins->a] = VALUE_BOOL(!VALUE_IS_TRUTHY(operand));
+  }
+  DISPATCH();
+
+  TARGET(REG_JMP) {
+    ip += ins->sx;
+  }
+  DISPATCH();
+
+  TARGET(REG_JMPLONG) {
+    ip += REG_LONG_OFFSET(ins);
+  }
+  DISPATCH();
+
+  TARGET(REG_JMPIFNOT) {
+    Value condition = regs[ins->a];
+    if (!VALUE_IS_TRUTHY(condition))
+      ip += ins->sx;
+  }
+  DISPATCH();
+
+  TARGET(REG_CALL) {
+    SAVE_FRAME();
+    CHECK(call_value(vm, frame->base + ins->a, ins->b));
+    LOAD_FRAME();
+    COLLECT_GARBAGE();
+  }
+  DISPATCH();
+
+  TARGET(REG_TAILCALL) {
+    SAVE_FRAME();
+    CHECK(tail_call_value(vm, frame->base + ins->a, ins->b));
+    LOAD_FRAME();
+    COLLECT_GARBAGE();
+  }
+  DISPATCH();
+
+  TARGET(REG_RETURN) {
+    regs[-1] = RK(ins->b);
+    if (--vm->frames_index == 0)
+      goto done;
+    LOAD_FRAME();
+  }
+  DISPATCH();
+
+  TARGET(REG_RETURNNULL) {
+    regs[-1] = VALUE_NULL;
+    if (--vm->frames_index == 0)
+      goto done;
+    LOAD_FRAME();
+  }
+  DISPATCH();
+
+  TARGET(REG_CLOSURE) {
+    CHECK(make_closure(k[ins->b], ins->c, &regs[ins->sx], &regs[ins->a]));
+    COLLECT_GARBAGE();
+  }
+  DISPATCH();
+
+  TARGET(REG_ARRAY) {
+    Object* array = object_alloc(ARRAY_OBJ);
+    array->value.array = array_from(&regs[ins->b], ins->c);
+    regs[ins->a] = VALUE_OBJ(array);
+    COLLECT_GARBAGE();
+  }
+  DISPATCH();
+
+  // the array being built by a long literal isn't shared yet, so the
+  // intermediate versions are dropped as it grows
+  TARGET(REG_ARRAYAPPEND) {
+    Object* array = VALUE_AS_OBJ(regs[ins->a]);
+    for (int i = 0; i < ins->c; i++) {
+      Array* pushed = array_push(array->value.array, regs[ins->b + i]);
+      free(array->value.array);
+      array->value.array = pushed;
+    }
+    COLLECT_GARBAGE();
+  }
+  DISPATCH();
+
+  TARGET(REG_HASH) {
+    CHECK(build_hash(&regs[ins->b], ins->c, ins->sx, &regs[ins->a]));
+    COLLECT_GARBAGE();
+  }
+  DISPATCH();
+
+  TARGET(REG_HASHADD) {
+    CHECK(add_pairs(
+      VALUE_AS_OBJ(regs[ins->a])->value.hash, &regs[ins->b], ins->c));
+  }
+  DISPATCH();
+
+  TARGET(REG_INDEX) {
+    CHECK(index_value(regs[ins->b], RK(ins->c), &regs[ins->a]));
+  }
+  DISPATCH();
+
+#ifndef COMPUTED_GOTO
+      default:
+        SET_ERR("unknown opcode: %d", ins->op);
+        return err;
+    }
+  }
+#endif
+
+done:
+  return NULL;
+}
+
+// `callee` is an index into the register file, with the arguments after it
+static VmErr call_value(RegVm vm, int callee, int num_args) {
+  Value fn = vm->registers[callee];
+  if (VALUE_HAS_TYPE(fn, BUILT_IN_OBJ)) {
+    Value* args = &vm->registers[callee + 1];
+    Value result = (VALUE_AS_OBJ(fn)->value.builtin_fn)(args, num_args);
+    if (VALUE_HAS_TYPE(result, ERROR_OBJ))
+      return VALUE_AS_OBJ(result)->value.str;
+    vm->registers[callee] = result;
+    return NULL;
+  }
+  if (!VALUE_HAS_TYPE(fn, CLOSURE_OBJ))
+    return "calling non-function and non-built-in";
+
+  Closure* closure = VALUE_AS_OBJ(fn)->value.closure;
+  if (num_args != closure->fn->num_params) {
+    SET_ERR("wrong number of arguments: want=%d, got=%d",
+      closure->fn->num_params, num_args);
+    return err;
+  }
+  int base = callee + 1;
+  int num_regs = closure->fn->num_locals;
+  if (vm->frames_index >= MAX_FRAMES || base + num_regs > REGISTER_FILE_SIZE)
+    return "stack overflow";
+  // clear stale values from registers past the arguments, the collector
+  // scans them
+  for (int i = base + num_args; i < base + num_regs; i++)
+    vm->registers[i] = VALUE_NULL;
+  vm->frames[vm->frames_index++] = (RegFrame){
+    .cl = closure,
+    .ip = (RegIns*)closure->fn->instructions->bytes,
+    .base = base,
+  };
+  return NULL;
+}
+
+// a closure called in tail position takes over the caller's frame: it and
+// its arguments are moved down over the caller's callee register. Builtins
+// are called normally, and the caller returns their result next
+static VmErr tail_call_value(RegVm vm, int callee, int num_args) {
+  if (!VALUE_HAS_TYPE(vm->registers[callee], CLOSURE_OBJ))
+    return call_value(vm, callee, num_args);
+  int caller_slot = vm->frames[vm->frames_index - 1].base - 1;
+  memmove(&vm->registers[caller_slot], &vm->registers[callee],
+    sizeof(Value) * (num_args + 1));
+  vm->frames_index--;
+  return call_value(vm, caller_slot, num_args);
+}
+
+static VmErr binary_operation(
+  RegOpCode op, Value left, Value right, Value* out) {
+  if (op == REG_ADD && VALUE_HAS_TYPE(left, STRING_OBJ) &&
+      VALUE_HAS_TYPE(right, STRING_OBJ)) {
+    char* l = VALUE_AS_OBJ(left)->value.str;
+    char* r = VALUE_AS_OBJ(right)->value.str;
+    char* combined = malloc(strlen(l) + strlen(r) + 1);
+    sprintf(combined, "%s%s", l, r);
+    Object* object = object_alloc(STRING_OBJ);
+    object->value.str = combined;
+    *out = VALUE_OBJ(object);
+    return NULL;
+  }
+  if (VALUE_HAS_TYPE(left, STRING_OBJ) && VALUE_HAS_TYPE(right, STRING_OBJ)) {
+    SET_ERR("unknown string operator: %s", reg_opcode_name(op));
+    return err;
+  }
+  if (op == REG_DIV && BOTH_INTS(left, right))
+    return "division by zero";
+  SET_ERR("unsupported types for binary operation: %s %s", value_type(left),
+    value_type(right));
+  return err;
+}
+
+// ints are compared by the caller, booleans compare by identity
+static VmErr comparison(RegOpCode op, Value left, Value right, Value* out) {
+  if (!VALUE_IS_BOOL(left) && !VALUE_IS_BOOL(right)) {
+    SET_ERR("unsupported types for comparison operation: %s %s",
+      value_type(left), value_type(right));
+    return err;
+  }
+  switch (op) {
+    case REG_EQ:
+      *out = VALUE_BOOL(left == right);
+      return NULL;
+    case REG_NE:
+      *out = VALUE_BOOL(left != right);
+      return NULL;
+    default:
+      SET_ERR("unknown operator: %s, (%s %s)", reg_opcode_name(op),
+        value_type(left), value_type(right));
+      return err;
+  }
+}
+
+static VmErr index_value(Value left, Value index, Value* out) {
+  if (VALUE_HAS_TYPE(left, ARRAY_OBJ) && VALUE_IS_INT(index)) {
+    Array* array = VALUE_AS_OBJ(left)->value.array;
+    int i = VALUE_AS_INT(index);
+    *out = i < 0 || i >= array->length ? VALUE_NULL : array_get(array, i);
+    return NULL;
+  }
+  if (VALUE_HAS_TYPE(left, HASH_OBJ)) {
+    if (!object_hashable(index)) {
+      SET_ERR("unusable as hash key: %s", value_type(index));
+      return err;
+    }
+    HashEntry* entry = hash_get(VALUE_AS_OBJ(left)->value.hash, index);
+    *out = entry ? entry->value : VALUE_NULL;
+    return NULL;
+  }
+  SET_ERR("index operator not supported: %s", value_type(left));
+  return err;
+}
+
+// `room` is the number of pairs of the whole literal, whose later chunks
+// are added by `add_pairs()`
+static VmErr build_hash(Value* elements, int length, int room, Value* out) {
+  Hash* entries = hash_new(room);
+  VmErr pairs_err = add_pairs(entries, elements, length);
+  if (pairs_err)
+    return pairs_err;
+  Object* hash = object_alloc(HASH_OBJ);
+  hash->value.hash = entries;
+  *out = VALUE_OBJ(hash);
+  return NULL;
+}
+
+static VmErr add_pairs(Hash* hash, Value* elements, int length) {
+  for (int i = 0; i < length; i += 2) {
+    if (!hash_put(hash, elements[i], elements[i + 1])) {
+      SET_ERR("unusable as hash key: %s", value_type(elements[i]));
+      return err;
+    }
+  }
+  return NULL;
+}
+
+static VmErr make_closure(
+  Value constant, int num_free, Value* free, Value* out) {
+  if (!VALUE_HAS_TYPE(constant, COMPILED_FUNCTION_OBJ)) {
+    SET_ERR("not a function: %s", value_type(constant));
+    return err;
+  }
+  CompiledFunction* fn = VALUE_AS_OBJ(constant)->value.compiled_fn;
+  if (num_free == 0 && fn->closure != NULL) {
+    *out = VALUE_OBJ(fn->closure);
+    return NULL;
+  }
+  Closure* closure = new_closure(fn, num_free);
+  memcpy(closure->free, free, sizeof(Value) * num_free);
+  if (num_free == 0)
+    fn->closure = closure->object;
+  *out = VALUE_OBJ(closure->object);
+  return NULL;
+}
+
+static Closure* new_closure(CompiledFunction* fn, int num_free) {
+  Closure* closure = malloc(sizeof(Closure) + num_free * sizeof(Value));
+  closure->fn = fn;
+  closure->num_free = num_free;
+  closure->object = object_alloc(CLOSURE_OBJ);
+  closure->object->value.closure = closure;
+  return closure;
+}
+
+// frames overlap, so the registers in use are everything up to the end of
+// the frame reaching furthest
+static void collect_garbage(RegVm vm) {
+  clock_t start = clock();
+  heap_begin_collection();
+  int top = 0;
+  for (int i = 0; i < vm->frames_index; i++) {
+    RegFrame* frame = &vm->frames[i];
+    int end = frame->base + frame->cl->fn->num_locals;
+    if (end > top)
+      top = end;
+    heap_mark(&vm->heap, VALUE_OBJ(frame->cl->object));
+  }
+  for (int i = 0; i < top; i++)
+    heap_mark(&vm->heap, vm->registers[i]);
+  for (int i = 0; i < vm->num_globals; i++)
+    heap_mark(&vm->heap, vm->globals[i]);
+  for (int i = 0; i < vm->num_constants; i++)
+    heap_mark(&vm->heap, vm->constants[i]);
+  vm->stats.bytes_freed += heap_sweep(&vm->heap);
+  vm->stats.collections++;
+  vm->stats.gc_pause_time += (double)(clock() - start) / CLOCKS_PER_SEC;
+}
@@ -0,0 +1,22 @@
+#ifndef __REG_VM_H__
+#define __REG_VM_H__
+
+#include "../compiler/compiler.h"
+#include "../object/object.h"
+#include "../vm/vm.h"
+
+// incomplete declaration for encapsulation
+typedef struct RegVm_t* RegVm;
+
+/**
+ * Executes register machine code from `reg_compiler_bytecode()`. Frames
+ * are windows onto one shared register file: a callee's registers start
+ * just past the caller's register holding it, so arguments are passed in
+ * place and the result is written back over the callee.
+ */
+RegVm reg_vm_new(Bytecode* bytecode);
+VmErr reg_vm_run(RegVm vm);
+VmStats reg_vm_stats(RegVm vm);
+Object* reg_vm_result(RegVm vm);
+
+#endif  // __REG_VM_H__
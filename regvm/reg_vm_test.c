@@ -0,0 +1,218 @@
+#include "reg_vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../parser/parser.h"
+#include "../test/test.h"
+#include "reg_compiler.h"
+
+typedef struct RegVmTest {
+  char* input;
+  char* expected;  // the inspected result, or the expected VM error
+} RegVmTest;
+
+// the register counterpart of test/compile.c's compile_source
+static Bytecode* reg_compile_source(char* input, const char* t) {
+  Program* program = parse_program(input);
+  RegCompiler compiler = reg_compiler_new();
+  CompilerErr err = reg_compile(compiler, program);
+  if (err)
+    fail(ss("compiler error: %s", err), t);
+  program_free(program);
+  return reg_compiler_bytecode(compiler);
+}
+
+static void run_reg_vm_tests(int len, RegVmTest tests[len], const char* t) {
+  for (int i = 0; i < len; i++) {
+    RegVm vm = reg_vm_new(reg_compile_source(tests[i].input, t));
+    char* input = ss("input=`%s`", tests[i].input);
+    VmErr err = reg_vm_run(vm);
+    if (err)
+      assert_str_is(tests[i].expected, err, input, t);
+    else
+      assert_str_is(tests[i].expected,
+        object_inspect(*reg_vm_result(vm)), input, t);
+  }
+}
+
+void test_expressions(void) {
+  RegVmTest tests[] = {
+    {"1 + 2 * 3", "7"},
+    {"(5 + 10 / 3) * -2", "-16"},
+    {"1 < 2", "true"},
+    {"!(1 > 2) == true", "true"},
+    {"true != false", "true"},
+    {"!5", "false"},
+    {"\"mon\" + \"key\"", "monkey"},
+    {"let a = 1; let b = a + 1; a + b", "3"},
+    {"if (1 > 2) { 10 }", "null"},
+    {"if (false) { 10 } else { let x = 20; x }", "20"},
+    {"[1, 2 * 2, 3 + 3][1]", "4"},
+    {"{1: 2, \"a\": 3}[\"a\"]", "3"},
+    {"[1, 2, 3][99]", "null"},
+    {"len(push([1], 2)) + first([7]) + last([1, 8])", "17"},
+    {"", "null"},
+  };
+  run_reg_vm_tests(LEN(tests), tests, __func__);
+}
+
+void test_functions(void) {
+  RegVmTest tests[] = {
+    {"let f = fn(a, b) { let c = a * b; c + 1 }; f(3, 4)", "13"},
+    {"let f = fn() { }; f()", "null"},
+    {"let f = fn(x) { return x; 99 }; f(5)", "5"},
+    {"let f = fn(x) { if (x) { return 1; } 2 }; [f(true), f(false)]",
+      "[1, 2]"},
+    {"let newAdder = fn(a, b) { fn(c) { a + b + c } }; newAdder(1, 2)(8)",
+      "11"},
+    {"let f = fn(a) { fn(b) { fn(c) { a + b + c } } }; f(1)(2)(3)", "6"},
+    {"let fib = fn(x) {"
+     "  if (x < 2) { x } else { fib(x - 1) + fib(x - 2) }"
+     "}; fib(15)",
+      "610"},
+    {"let wrapper = fn() {"
+     "  let inner = fn(x) { if (x == 0) { 0 } else { inner(x - 1) } };"
+     "  inner(3)"
+     "}; wrapper()",
+      "0"},
+    {"let count = fn(n, acc) {"
+     "  if (n == 0) { acc } else { count(n - 1, acc + 1) }"
+     "}; count(1000000, 0)",
+      "1000000"},
+    {"let f = fn(a) { len(a) }; f([1, 2, 3]) + 1", "4"},
+    {"let g = fn(x) { x * 2 }; let f = fn(a) { [g(a), g(a + 1)] }; f(1)",
+      "[2, 4]"},
+  };
+  run_reg_vm_tests(LEN(tests), tests, __func__);
+}
+
+void test_errors(void) {
+  RegVmTest tests[] = {
+    {"1 + true", "unsupported types for binary operation: INTEGER BOOLEAN"},
+    {"-\"a\"", "unsupported type for negation: STRING"},
+    {"let f = fn(a) { a }; f()", "wrong number of arguments: want=1, got=0"},
+    {"1(2)", "calling non-function and non-built-in"},
+    {"{[1]: 2}", "unusable as hash key: ARRAY"},
+    {"len(1)", "argument to `len` not supported, got INTEGER"},
+    {"let f = fn(x) { 1 + f(x - 1) }; f(5000)", "stack overflow"},
+  };
+  run_reg_vm_tests(LEN(tests), tests, __func__);
+}
+
+// locals are operands in place, and comparisons jump directly
+void test_register_code(void) {
+  char* t = "register_code";
+  Bytecode* bytecode = reg_compile_source(
+    "let fib = fn(x) {"
+    "  if (x == 0) { return 0; }"
+    "  if (x == 1) { return 1; }"
+    "  fib(x - 1) + fib(x - 2)"
+    "};",
+    t);
+  Object* fn = bytecode->constants->constants[bytecode->constants->length - 1];
+  assert_str_is(
+    "0000 JmpIfNotEq R0 K0 2\n"
+    "0001 Return K0\n"
+    "0002 JmpIfNotEq R0 K1 4\n"
+    "0003 Return K1\n"
+    "0004 CurrentClosure R2\n"
+    "0005 Sub R3 R0 K1\n"
+    "0006 Call R2 1\n"
+    "0007 CurrentClosure R3\n"
+    "0008 Sub R4 R0 K2\n"
+    "0009 Call R3 1\n"
+    "0010 Add R1 R2 R3\n"
+    "0011 Return R1\n",
+    reg_instructions_str(fn->value.compiled_fn->instructions),
+    "fib instructions", t);
+}
+
+void test_garbage_collection(void) {
+  char* t = "garbage_collection";
+  RegVm vm = reg_vm_new(reg_compile_source(
+    "let keep = [1, 2, 3];"
+    "let newAdder = fn(x) { fn(y) { x + y } };"
+    "let addThree = newAdder(keep[2]);"
+    "let build = fn(arr, n) {"
+    "  if (n == 0) { arr } else { build(push(arr, n), n - 1) }"
+    "};"
+    "let loop = fn(i, acc) {"
+    "  if (i == 0) { acc } else { loop(i - 1, acc + len(build([], 100))) }"
+    "};"
+    "loop(200, 0) + addThree(first(keep))",
+    t));
+  assert(reg_vm_run(vm) == NULL, "ran without error", t);
+  assert_integer_object(20004, *reg_vm_result(vm), t);
+  VmStats stats = reg_vm_stats(vm);
+  assert(stats.collections > 0, "collected garbage", t);
+  assert(stats.bytes_freed > 0, "freed garbage", t);
+}
+
+// longer than the 256 registers a frame can address, so they're built in
+// chunks (too long for `ss()`, so the inputs are built by hand)
+void test_large_literals(void) {
+  char* t = "large_literals";
+  int length = 300;
+  char* elements = malloc(length * 12 + 1);
+  char* pairs = malloc(length * 24 + 1);
+  int elements_pos = 0, pairs_pos = 0;
+  for (int i = 0; i < length; i++) {
+    elements_pos += sprintf(&elements[elements_pos], "%s%d", i ? ", " : "", i);
+    pairs_pos +=
+      sprintf(&pairs[pairs_pos], "%s%d: %d", i ? ", " : "", i, i * 2);
+  }
+  char* formats[][2] = {
+    {"let a = [%s]; len(a) + a[299] + a[64]", "663"},
+    {"let f = fn() { let a = [%s]; len(a) }; f()", "300"},
+    {"let h = {%s}; h[299] + h[0] + h[150]", "898"},
+    {"len([[%s], [%s]][1])", "300"},
+  };
+  char* input = malloc(strlen(pairs) * 2 + 100);
+  for (int i = 0; i < LEN(formats); i++) {
+    char* literal = i == 2 ? pairs : elements;
+    sprintf(input, formats[i][0], literal, literal);
+    RegVm vm = reg_vm_new(reg_compile_source(input, t));
+    VmErr err = reg_vm_run(vm);
+    assert_str_is(formats[i][1],
+      err ? err : object_inspect(*reg_vm_result(vm)), formats[i][0], t);
+  }
+}
+
+// blocks longer than a 16-bit jump offset, through every kind of jump
+void test_long_jumps(void) {
+  char* t = "long_jumps";
+  int length = 40000;
+  char* block = malloc(length * 7 + 1);
+  for (int i = 0; i < length; i++)
+    sprintf(&block[i * 7], "x + 1; ");
+  char* formats[][2] = {
+    {"let x = 1; if (x == 1) { %s 1 } else { %s 2 }", "1"},
+    {"let x = 2; if (x == 1) { %s 1 } else { %s 2 }", "2"},
+    {"let x = 2; if (x != 1) { %s 1 } else { %s 2 }", "1"},
+    {"let x = 0; if (x > 0) { %s 1 } else { %s 2 }", "2"},
+    {"let x = 1; if (!(x > 1)) { %s 1 } else { %s 2 }", "1"},
+    {"let f = fn(x) { if (x < 3) { %s 1 } else { %s 2 } }; f(1)", "1"},
+    {"let f = fn(x) { if (!x) { %s 1 }; %s 2 }; f(5)", "2"},
+  };
+  char* input = malloc(strlen(block) * 2 + 100);
+  for (int i = 0; i < LEN(formats); i++) {
+    sprintf(input, formats[i][0], block, block);
+    RegVm vm = reg_vm_new(reg_compile_source(input, t));
+    VmErr err = reg_vm_run(vm);
+    assert_str_is(formats[i][1],
+      err ? err : object_inspect(*reg_vm_result(vm)), formats[i][0], t);
+  }
+}
+
+int main(int argc, char** argv) {
+  pass_argv(argc, argv);
+  test_expressions();
+  test_functions();
+  test_errors();
+  test_register_code();
+  test_garbage_collection();
+  test_large_literals();
+  test_long_jumps();
+  printf("\n");
+  return 0;
+}
@@ -21,10 +21,8 @@ void repl_start(void) {
   char *err = NULL;
   Bytecode *bytecode = NULL;
 
-  ConstantPool *constant_pool = malloc(sizeof(ConstantPool));
-  constant_pool->length = 0;
-  constant_pool->constants = malloc(sizeof(Object) * MAX_CONSTANTS);
-  Object **globals = calloc(GLOBALS_SIZE, sizeof(Object *));
+  ConstantPool *constant_pool = constant_pool_new();
+  Value *globals = calloc(GLOBALS_SIZE, sizeof(Value));
   SymbolTable symbol_table = symbol_table_new();
   symbol_table_define_builtins(symbol_table);
   Vm vm;
@@ -38,13 +36,16 @@ void repl_start(void) {
     }
 
     if (num_chars > 1) {
-      Program *program = parse_program(buffer);
-      if (parser_num_errors() > 0) {
-        parser_print_errors();
+      Parser parser = parser_new(buffer, num_chars);
+      Program *program = parser_parse_program(&parser);
+      if (parser_num_errors(&parser) > 0) {
+        parser_print_errors(&parser);
+        program_free(program);
         continue;
       }
       Compiler compiler = compiler_new_with_state(symbol_table, constant_pool);
       err = compile(compiler, program, PROGRAM_NODE);
+      program_free(program);
       if (err) {
         printf("Whoops! Compilation failed:\n %s\n", err);
         continue;
@@ -75,9 +76,11 @@ void repl_start_eval(void) {
     printf(COLOR_CYAN ">> " COLOR_RESET);
     num_chars = getline(&buffer, &bufsize, stdin);
     if (num_chars > 1) {
-      Program *program = parse_program(buffer);
-      if (parser_num_errors() > 0) {
-        parser_print_errors();
+      Parser parser = parser_new(buffer, num_chars);
+      Program *program = parser_parse_program(&parser);
+      if (parser_num_errors(&parser) > 0) {
+        parser_print_errors(&parser);
+        program_free(program);
         continue;
       }
       Object evaluated = eval(program, PROGRAM_NODE, env);
@@ -98,12 +101,15 @@ void repl_start_parsed_string(void) {
     printf(COLOR_CYAN ">> " COLOR_RESET);
     num_chars = getline(&buffer, &bufsize, stdin);
     if (num_chars > 1) {
-      Program *program = parse_program(buffer);
-      if (parser_num_errors() > 0) {
-        parser_print_errors();
+      Parser parser = parser_new(buffer, num_chars);
+      Program *program = parser_parse_program(&parser);
+      if (parser_num_errors(&parser) > 0) {
+        parser_print_errors(&parser);
+        program_free(program);
         continue;
       }
       printf("%s\n", program_string(program));
+      program_free(program);
     }
   } while (num_chars != EOF);
   printf("\n");
@@ -119,10 +125,12 @@ void repl_start_tokens(void) {
     printf(COLOR_CYAN ">> " COLOR_RESET);
     num_chars = getline(&buffer, &bufsize, stdin);
     if (num_chars > 1) {
-      lexer_set(buffer);
-      for (tok = lexer_next_token(); tok->type != TOKEN_EOF;
-           tok = lexer_next_token())
+      Arena *arena = arena_new();
+      Lexer lexer = lexer_new(buffer, num_chars, arena);
+      for (tok = lexer_next(&lexer); tok->type != TOKEN_EOF;
+           tok = lexer_next(&lexer))
         print_token(tok);
+      arena_free(arena);
       printf("\n");
     }
   } while (num_chars != EOF);
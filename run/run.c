@@ -1,16 +1,23 @@
 #include <dirent.h>
+#include <errno.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <time.h>
+#include "../aot/aot.h"
 #include "../code/code.h"
+#include "../compiler/cache.h"
 #include "../compiler/compiler.h"
+#include "../compiler/optimizer.h"
 #include "../compiler/symbol_table.h"
 #include "../evaluator/evaluator.h"
 #include "../lexer/lexer.h"
 #include "../object/object.h"
 #include "../parser/parser.h"
+#include "../regvm/reg_compiler.h"
+#include "../regvm/reg_vm.h"
 #include "../token/token.h"
 #include "../utils/argv.h"
 #include "../utils/colors.h"
@@ -19,56 +26,169 @@
 typedef struct {
   Object object;
   double duration;
+  double startup;
+  bool compiled;
+  int bytes_saved;
+  VmStats stats;
 } ExecResult;
 
-static ExecResult exec(char* input, bool compile);
-static ExecResult exec_compile(Program* program);
-static ExecResult exec_interpret(Program* program);
-static char* input_from_file(int argc, char** argv);
+static Program* parse(char* input);
+static Bytecode* compile_input(char* input, char* filename);
+static ExecResult exec_compile(
+  char* input, char* filename, bool optimize, bool jit);
+static ExecResult exec_registers(char* input);
+static ExecResult exec_interpret(char* input);
+static char* get_filename(int argc, char** argv);
+static char* input_from_file(char* filename);
+static void print_vm_stats(VmStats stats);
+static void print_opcode_profile(VmStats stats);
 
 void run(int argc, char** argv) {
   bool measure = argv_has_flag('m', argc, argv);
-  bool compile = argv_has_flag('i', argc, argv);
+  bool compile = !argv_has_flag('i', argc, argv);
+  bool optimize = argv_has_flag('O', argc, argv);
+  bool registers = argv_has_flag('r', argc, argv);
+  bool jit = argv_has_flag('j', argc, argv);
 
   char* input = "";
+  char* filename = NULL;
   int eval_flag_index = argv_idx("-e", argc, argv);
   if (eval_flag_index != -1) {
     input = argv[eval_flag_index + 1];
   } else {
-    input = input_from_file(argc, argv);
+    filename = get_filename(argc, argv);
+    input = input_from_file(filename);
   }
 
-  ExecResult result = exec(input, compile);
+  ExecResult result =
+    !compile    ? exec_interpret(input)
+    : registers ? exec_registers(input)
+                : exec_compile(input, filename, optimize, jit);
   printf("%s\n", object_inspect(result.object));
   if (measure) {
+    printf("startup time: %f\n", result.startup);
     printf("execution time: %f\n", result.duration);
+    if (result.compiled && optimize && !registers)
+      printf("optimizer bytes saved: %d\n", result.bytes_saved);
+    if (result.compiled)
+      print_vm_stats(result.stats);
   }
 }
 
-static ExecResult exec(char* input, bool compile) {
-  Program* program = parse_program(input);
-  if (parser_num_errors() > 0) {
-    parser_print_errors();
+// `monkey build foo.mky` translates the (optimized) program to C in
+// `foo.c`, then builds that into the executable `foo`
+void build(int argc, char** argv) {
+  char* filename = get_filename(argc, argv);
+  Bytecode* bytecode = compile_input(input_from_file(filename), filename);
+  optimize_bytecode(bytecode);
+
+  char* exe_path = strndup(filename, strlen(filename) - strlen(".mky"));
+  char* c_path = malloc(strlen(exe_path) + strlen(".c") + 1);
+  sprintf(c_path, "%s.c", exe_path);
+  FILE* out = fopen(c_path, "w");
+  if (!out) {
+    printf("build error: can't write %s\n", c_path);
+    exit(EXIT_FAILURE);
+  }
+  AotErr err = aot_emit_c(out, bytecode);
+  fclose(out);
+  if (!err)
+    err = aot_build(c_path, exe_path);
+  if (err) {
+    printf("build error: %s\n", err);
     exit(EXIT_FAILURE);
   }
+  printf("built %s\n", exe_path);
+}
 
-  if (compile) {
-    return exec_compile(program);
-  } else {
-    return exec_interpret(program);
+#define NUM_TOP_PAIRS 10
+
+// the most frequent pairs of consecutive opcodes, candidates for fusing
+static void print_opcode_profile(VmStats stats) {
+  long* pairs = stats.opcode_pairs;
+  for (int n = 0; n < NUM_TOP_PAIRS; n++) {
+    int top = 0;
+    for (int i = 1; i < NUM_OPCODES * NUM_OPCODES; i++)
+      if (pairs[i] > pairs[top])
+        top = i;
+    if (pairs[top] == 0)
+      break;
+    Definition* first = code_opcode_lookup(top / NUM_OPCODES);
+    Definition* second = code_opcode_lookup(top % NUM_OPCODES);
+    printf("  %s %s: %ld\n", first->name, second->name, pairs[top]);
+    pairs[top] = 0;
   }
 }
 
-static ExecResult exec_compile(Program* program) {
-  clock_t start, end;
+static void print_vm_stats(VmStats stats) {
+  printf("allocations: %ld\n", stats.allocations);
+  for (int type = 0; type < NUM_OBJECT_TYPES; type++) {
+    if (stats.allocations_by_type[type] > 0) {
+      Object object = {.type = type};
+      printf("  %s: %ld\n", object_type(object),
+        stats.allocations_by_type[type]);
+    }
+  }
+  printf("collections: %ld\n", stats.collections);
+  printf("bytes freed: %ld\n", stats.bytes_freed);
+  printf("gc pause time: %f\n", stats.gc_pause_time);
+  printf("quickenings: %ld\n", stats.quickenings);
+  printf("dequickenings: %ld\n", stats.dequickenings);
+  if (stats.jit_compiled > 0)
+    printf("jit compiled functions: %ld\n", stats.jit_compiled);
+  if (stats.dispatches > 0)
+    printf("dispatches: %ld\n", stats.dispatches);
+  if (stats.opcode_pairs)
+    print_opcode_profile(stats);
+}
+
+static Program* parse(char* input) {
+  Parser parser = parser_new(input, strlen(input));
+  Program* program = parser_parse_program(&parser);
+  if (parser_num_errors(&parser) > 0) {
+    parser_print_errors(&parser);
+    exit(EXIT_FAILURE);
+  }
+  return program;
+}
+
+// files are compiled once, later runs load `foo.mkyc` if `foo.mky` is
+// unchanged
+static Bytecode* compile_input(char* input, char* filename) {
+  char* cache_path = filename ? bytecode_cache_path(filename) : NULL;
+  if (cache_path) {
+    Bytecode* cached = bytecode_cache_read(cache_path, input);
+    if (cached)
+      return cached;
+  }
+
   Compiler compiler = compiler_new();
+  Program* program = parse(input);
   char* compiler_err = compile(compiler, program, PROGRAM_NODE);
   if (compiler_err) {
     printf("compiler error: %s\n", compiler_err);
     exit(EXIT_FAILURE);
   }
+  program_free(program);
+  Bytecode* bytecode = compiler_bytecode(compiler);
+  if (cache_path)
+    bytecode_cache_write(cache_path, bytecode, input);
+  return bytecode;
+}
 
-  Vm vm = vm_new(compiler_bytecode(compiler));
+// the cache holds unoptimized bytecode, so `-O` doesn't change what's cached
+static ExecResult exec_compile(
+  char* input, char* filename, bool optimize, bool jit) {
+  clock_t start, end;
+  start = clock();
+  Bytecode* bytecode = compile_input(input, filename);
+  int bytes_saved = optimize ? optimize_bytecode(bytecode) : 0;
+  end = clock();
+  double startup = ((double)(end - start)) / CLOCKS_PER_SEC;
+
+  Vm vm = vm_new(bytecode);
+  if (jit && !vm_use_jit(vm))
+    printf("warning: no JIT on this platform, interpreting\n");
   start = clock();
   char* vm_err = vm_run(vm);
   end = clock();
@@ -79,20 +199,65 @@ static ExecResult exec_compile(Program* program) {
 
   ExecResult result;
   result.duration = ((double)(end - start)) / CLOCKS_PER_SEC;
+  result.startup = startup;
   result.object = *vm_last_popped(vm);
+  result.compiled = true;
+  result.bytes_saved = bytes_saved;
+  result.stats = vm_stats(vm);
+  return result;
+}
+
+// the register backend compiles from source every run, neither the cache
+// nor the optimizer know its instructions
+static ExecResult exec_registers(char* input) {
+  clock_t start, end;
+  start = clock();
+  RegCompiler compiler = reg_compiler_new();
+  Program* program = parse(input);
+  char* compiler_err = reg_compile(compiler, program);
+  if (compiler_err) {
+    printf("compiler error: %s\n", compiler_err);
+    exit(EXIT_FAILURE);
+  }
+  program_free(program);
+  end = clock();
+  double startup = ((double)(end - start)) / CLOCKS_PER_SEC;
+
+  RegVm vm = reg_vm_new(reg_compiler_bytecode(compiler));
+  start = clock();
+  char* vm_err = reg_vm_run(vm);
+  end = clock();
+  if (vm_err) {
+    printf("vm error: %s\n", vm_err);
+    exit(EXIT_FAILURE);
+  }
+
+  ExecResult result = {0};
+  result.duration = ((double)(end - start)) / CLOCKS_PER_SEC;
+  result.startup = startup;
+  result.object = *reg_vm_result(vm);
+  result.compiled = true;
+  result.stats = reg_vm_stats(vm);
   return result;
 }
 
-static ExecResult exec_interpret(Program* program) {
+static ExecResult exec_interpret(char* input) {
   clock_t start, end;
+  start = clock();
+  Program* program = parse(input);
+  end = clock();
+  double startup = ((double)(end - start)) / CLOCKS_PER_SEC;
+
   Env* env = env_new();
   start = clock();
   Object evaluated = eval(program, PROGRAM_NODE, env);
   end = clock();
 
-  ExecResult result;
+  ExecResult result = {0};
   result.duration = ((double)(end - start)) / CLOCKS_PER_SEC;
+  result.startup = startup;
   result.object = evaluated;
+  result.compiled = false;
   return result;
 }
 
@@ -111,33 +276,24 @@ static char* get_filename(int argc, char** argv) {
   exit(EXIT_FAILURE);
 }
 
-#define MAX_LINE 512
-#define MAX_NUM_LINES 1024
-
-static char* input_from_file(int argc, char** argv) {
-  char* filename = get_filename(argc, argv);
-  if (!filename)
-    return NULL;
-
+// the whole file, however large, as a NUL-terminated string; exits if it
+// can't be read
+static char* input_from_file(char* filename) {
   FILE* file = fopen(filename, "r");
-  if (!file)
-    return NULL;
-
-  int len = 0;
-  char line[MAX_LINE];
-  char* code = malloc(MAX_LINE * MAX_NUM_LINES);
-  for (;;) {
-    if (fgets(line, MAX_LINE, file) == NULL)
-      break;
-    len += strlen(line);
-    if (len > MAX_LINE * MAX_NUM_LINES) {
-      printf(COLOR_RED
-        "error: input exceeded max permitted size of %d" COLOR_RESET,
-        MAX_LINE * MAX_NUM_LINES);
-      exit(EXIT_FAILURE);
-    }
-    strcat(code, line);
+  struct stat st;
+  bool readable = file && fstat(fileno(file), &st) == 0;
+  if (readable && S_ISDIR(st.st_mode)) {
+    readable = false;
+    errno = EISDIR;
+  }
+  if (!readable) {
+    printf(COLOR_RED "error: can't read %s: %s" COLOR_RESET "\n", filename,
+      strerror(errno));
+    exit(EXIT_FAILURE);
   }
 
+  char* code = malloc(st.st_size + 1);
+  code[fread(code, 1, st.st_size, file)] = '\0';
+  fclose(file);
   return code;
 }
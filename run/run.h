@@ -2,5 +2,6 @@
 #define __RUN_H__
 
 void run(int argc, char** argv);
+void build(int argc, char** argv);
 
 #endif  // __RUN_H__
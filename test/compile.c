@@ -0,0 +1,13 @@
+#include "compile.h"
+#include "../parser/parser.h"
+#include "test.h"
+
+Bytecode *compile_source(char *source, const char *test_name) {
+  Program *program = parse_program(source);
+  Compiler compiler = compiler_new();
+  char *err = compile(compiler, program, PROGRAM_NODE);
+  if (err)
+    fail(ss("compiler error: %s", err), test_name);
+  program_free(program);
+  return compiler_bytecode(compiler);
+}
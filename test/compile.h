@@ -0,0 +1,13 @@
+#ifndef __TEST_COMPILE_H__
+#define __TEST_COMPILE_H__
+
+#include "../compiler/compiler.h"
+
+/**
+ * Parses and compiles `source` for the stack VM, failing `test_name` on a
+ * compiler error. Shared by the suites that test what's done with compiled
+ * bytecode.
+ */
+Bytecode *compile_source(char *source, const char *test_name);
+
+#endif  // __TEST_COMPILE_H__
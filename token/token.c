@@ -5,8 +5,8 @@
 #include <string.h>
 #include "../utils/colors.h"
 
-Token *new_token(int type, char *literal) {
-  Token *token = malloc(sizeof(Token));
+Token *new_token(Arena *arena, int type, char *literal) {
+  Token *token = arena_alloc(arena, sizeof(Token));
   token->type = type;
   token->literal = literal;
   return token;
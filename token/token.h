@@ -2,13 +2,14 @@
 #define __TOKEN_H__
 
 #include <stdbool.h>
+#include "../utils/arena.h"
 
 typedef struct Token {
   int type;
   char *literal;
 } Token;
 
-Token *new_token(int type, char *literal);
+Token *new_token(Arena *arena, int type, char *literal);
 void print_token(Token *tok);
 bool str_is(char *, char *);
 bool token_prop_is(char *, char *);
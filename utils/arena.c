@@ -0,0 +1,68 @@
+#include "./arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BLOCK_SIZE (64 * 1024)
+#define ALIGNMENT 16
+
+// the header is padded to ALIGNMENT, so `bytes` is as aligned as malloc's
+struct ArenaBlock {
+  ArenaBlock *next;
+  size_t size;
+  char bytes[];
+};
+
+static void new_block(Arena *arena, size_t size) {
+  ArenaBlock *block = malloc(sizeof(ArenaBlock) + size);
+  block->next = arena->blocks;
+  block->size = size;
+  arena->blocks = block;
+  arena->next = block->bytes;
+  arena->end = block->bytes + size;
+  arena->num_mallocs++;
+}
+
+Arena *arena_new(void) {
+  Arena *arena = malloc(sizeof(Arena));
+  arena->blocks = NULL;
+  arena->next = arena->end = NULL;
+  arena->num_allocs = 0;
+  arena->num_mallocs = 1;
+  return arena;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+  size = (size + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1);
+  arena->num_allocs++;
+#ifdef MONKEY_NO_ARENA
+  // a block per allocation, still chained so `arena_free()` frees it
+  new_block(arena, size);
+#else
+  if (size > (size_t)(arena->end - arena->next))
+    new_block(arena, size > BLOCK_SIZE ? size : BLOCK_SIZE);
+#endif
+  void *allocation = arena->next;
+  arena->next += size;
+  return allocation;
+}
+
+char *arena_strndup(Arena *arena, char *str, size_t length) {
+  char *copy = arena_alloc(arena, length + 1);
+  memcpy(copy, str, length);
+  copy[length] = '\0';
+  return copy;
+}
+
+char *arena_strdup(Arena *arena, char *str) {
+  return arena_strndup(arena, str, strlen(str));
+}
+
+void arena_free(Arena *arena) {
+  ArenaBlock *block = arena->blocks;
+  while (block) {
+    ArenaBlock *next = block->next;
+    free(block);
+    block = next;
+  }
+  free(arena);
+}
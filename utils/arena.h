@@ -0,0 +1,30 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+
+typedef struct ArenaBlock ArenaBlock;
+
+/**
+ * A bump allocator: allocations are carved out of large blocks and can't be
+ * freed one by one, only all at once by `arena_free()`. A parse allocates
+ * its tokens, literals, AST nodes and list cells from one.
+ *
+ * Built with ARENA=false (MONKEY_NO_ARENA), every allocation is a malloc of
+ * its own instead, to compare against.
+ */
+typedef struct Arena {
+  ArenaBlock *blocks;
+  char *next;  // free space left in the newest block
+  char *end;
+  long num_allocs;
+  long num_mallocs;
+} Arena;
+
+Arena *arena_new(void);
+void *arena_alloc(Arena *arena, size_t size);
+char *arena_strndup(Arena *arena, char *str, size_t length);
+char *arena_strdup(Arena *arena, char *str);
+void arena_free(Arena *arena);
+
+#endif  // __ARENA_H__
@@ -0,0 +1,104 @@
+#include "./intern.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "./arena.h"
+
+#define INITIAL_CAPACITY 256  // a power of 2
+
+// open addressing, NULL for an empty slot
+typedef struct Table {
+  size_t capacity;
+  _Atomic(char *) names[];
+} Table;
+
+/**
+ * Names already interned are found without taking the lock: a slot is only
+ * ever filled once, after its name is written, and a grown table is
+ * published whole, so a reader sees either a complete name or an empty
+ * slot. Only a miss takes the lock, to look again and insert. Outgrown
+ * tables are kept, as a reader may still be probing one.
+ */
+static _Atomic(Table *) current;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t num_names;  // guarded by `lock`
+static Arena *arena;      // where the names live, never freed
+
+// FNV-1a
+static uint32_t hash_name(char *str, size_t length) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (unsigned char)str[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+// the slot holding `str`, or the empty slot where it would go
+static _Atomic(char *) *find_slot(Table *table, char *str, size_t length) {
+  size_t mask = table->capacity - 1;
+  size_t slot = hash_name(str, length) & mask;
+  for (;; slot = (slot + 1) & mask) {
+    char *name =
+      atomic_load_explicit(&table->names[slot], memory_order_acquire);
+    if (name == NULL ||
+        (strncmp(name, str, length) == 0 && name[length] == '\0'))
+      return &table->names[slot];
+  }
+}
+
+static Table *new_table(size_t capacity) {
+  Table *table = calloc(1, sizeof(Table) + capacity * sizeof(char *));
+  table->capacity = capacity;
+  return table;
+}
+
+static Table *grow(Table *table) {
+  Table *grown = new_table(table->capacity * 2);
+  for (size_t i = 0; i < table->capacity; i++) {
+    char *name = atomic_load_explicit(&table->names[i], memory_order_relaxed);
+    if (name != NULL)
+      atomic_store_explicit(find_slot(grown, name, strlen(name)), name,
+        memory_order_relaxed);
+  }
+  atomic_store_explicit(&current, grown, memory_order_release);
+  return grown;
+}
+
+char *intern_n(char *str, size_t length) {
+  Table *table = atomic_load_explicit(&current, memory_order_acquire);
+  if (table != NULL) {
+    char *name = atomic_load_explicit(
+      find_slot(table, str, length), memory_order_acquire);
+    if (name != NULL)
+      return name;
+  }
+
+  pthread_mutex_lock(&lock);
+  table = atomic_load_explicit(&current, memory_order_relaxed);
+  if (table == NULL) {
+    table = new_table(INITIAL_CAPACITY);
+    arena = arena_new();
+    atomic_store_explicit(&current, table, memory_order_release);
+  }
+  _Atomic(char *) *slot = find_slot(table, str, length);
+  char *name = atomic_load_explicit(slot, memory_order_relaxed);
+  if (name == NULL) {
+    // kept at most half full, so probes stay short
+    if ((num_names + 1) * 2 > table->capacity) {
+      table = grow(table);
+      slot = find_slot(table, str, length);
+    }
+    name = arena_strndup(arena, str, length);
+    atomic_store_explicit(slot, name, memory_order_release);
+    num_names++;
+  }
+  pthread_mutex_unlock(&lock);
+  return name;
+}
+
+char *intern(char *str) {
+  return intern_n(str, strlen(str));
+}
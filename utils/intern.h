@@ -0,0 +1,16 @@
+#ifndef __INTERN_H__
+#define __INTERN_H__
+
+#include <stddef.h>
+
+/**
+ * The canonical copy of a name: every identifier the lexer reads and every
+ * name the symbol table holds is interned, so two names are equal exactly
+ * when their pointers are. Each distinct name is allocated once and lives
+ * for the rest of the process; the table is shared by concurrent parses.
+ */
+char *intern(char *str);
+// the same, for `length` bytes of `str` that needn't be NUL-terminated
+char *intern_n(char *str, size_t length);
+
+#endif  // __INTERN_H__
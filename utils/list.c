@@ -17,6 +17,14 @@ List *list_append(List *list, void *item) {
   return list;
 }
 
+List **list_arena_push(Arena *arena, List **tail, void *item) {
+  List *node = arena_alloc(arena, sizeof(List));
+  node->item = item;
+  node->next = NULL;
+  *tail = node;
+  return &node->next;
+}
+
 int list_count(List *list) {
   int num_items;
   List *current = list;
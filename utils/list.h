@@ -1,6 +1,8 @@
 #ifndef __LIST_H__
 #define __LIST_H__
 
+#include "./arena.h"
+
 typedef struct List {
   void *item;
   struct List *next;
@@ -10,6 +12,10 @@ typedef char *(*StrHandler)(void *);
 
 int list_count(List *list);
 List *list_append(List *list, void *item);
+// appends in constant time: `tail` is where the new cell goes (the list's
+// head if it's empty, else the last cell's `next`) and the new cell's `next`
+// is returned, for the following push. The cell is allocated from `arena`.
+List **list_arena_push(Arena *arena, List **tail, void *item);
 void list_strcat_each(List *list, char *target_str, StrHandler handler);
 void list_str_join(
   List *list, char *delim, char *target_str, StrHandler handler);
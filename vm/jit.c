@@ -0,0 +1,777 @@
+#include "vm_internal.h"
+
+#ifdef JIT_SUPPORTED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "../code/code.h"
+
+// native code is written as data, then called through a function pointer
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+/**
+ * A baseline template JIT: the first time a function is called its bytecode
+ * is translated, one instruction at a time, into x86-64 machine code. The
+ * generated code works on the VM's own stack and frames, so whatever isn't
+ * inlined calls back into the runtime helpers in vm.c: int arithmetic,
+ * comparisons, locals, globals and jumps run natively, while strings,
+ * arrays, hashes, calls, closures and errors go through the VM.
+ *
+ * While native code runs these callee-saved registers, preserved across
+ * helper calls, hold the VM state:
+ *
+ *   rbx  the Vm
+ *   r12  &vm->stack[bp], the current frame's locals
+ *   r13  &vm->stack[sp], written back to `vm->sp` around each helper call
+ *   r14  vm->constants
+ *   r15  the current frame's Closure
+ */
+
+enum Registers {
+  RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+  R8, R9, R10, R11, R12, R13, R14, R15,
+};
+
+#define VM RBX
+#define LOCALS R12
+#define SP R13
+#define CONSTANTS R14
+#define CLOSURE R15
+#define NO_INDEX RSP  // encodes "no index register" in a SIB byte
+
+enum ConditionCodes {
+  CC_E = 0x4,
+  CC_NE = 0x5,
+  CC_GE = 0xd,
+  CC_LE = 0xe,
+  CC_G = 0xf,
+};
+
+// opcodes of `op r/m, reg` arithmetic, and the /digit of `op r/m, imm32`
+enum AluOps { ALU_ADD = 0x01, ALU_AND = 0x21, ALU_SUB = 0x29, ALU_CMP = 0x39 };
+enum AluImmOps { IMM_ADD = 0, IMM_OR = 1, IMM_CMP = 7 };
+
+typedef VmErr (*NativeFn)(Vm vm);
+
+typedef struct Fixup {
+  int at;  // offset of a rel32 operand
+  int label;
+} Fixup;
+
+typedef struct Assembler {
+  Byte* code;
+  int length;
+  int capacity;
+  // native offsets, -1 until bound; the first labels are the function's
+  // bytecode positions, the rest are allocated by `new_label()`
+  int* labels;
+  int num_labels;
+  int labels_capacity;
+  Fixup* fixups;
+  int num_fixups;
+  int fixups_capacity;
+} Assembler;
+
+static void emit_byte(Assembler* a, int byte) {
+  if (a->length == a->capacity) {
+    a->capacity *= 2;
+    a->code = realloc(a->code, a->capacity);
+  }
+  a->code[a->length++] = byte;
+}
+
+static void emit_int32(Assembler* a, int32_t value) {
+  for (int i = 0; i < 4; i++)
+    emit_byte(a, (value >> (8 * i)) & 0xff);
+}
+
+static void emit_int64(Assembler* a, int64_t value) {
+  for (int i = 0; i < 8; i++)
+    emit_byte(a, (value >> (8 * i)) & 0xff);
+}
+
+static int new_label(Assembler* a) {
+  if (a->num_labels == a->labels_capacity) {
+    a->labels_capacity = a->labels_capacity ? 2 * a->labels_capacity : 64;
+    a->labels = realloc(a->labels, a->labels_capacity * sizeof(int));
+  }
+  a->labels[a->num_labels] = -1;
+  return a->num_labels++;
+}
+
+static void bind(Assembler* a, int label) {
+  a->labels[label] = a->length;
+}
+
+// a jump's rel32 is filled in once every label is bound
+static void emit_label_ref(Assembler* a, int label) {
+  if (a->num_fixups == a->fixups_capacity) {
+    a->fixups_capacity = a->fixups_capacity ? 2 * a->fixups_capacity : 64;
+    a->fixups = realloc(a->fixups, a->fixups_capacity * sizeof(Fixup));
+  }
+  a->fixups[a->num_fixups++] = (Fixup){.at = a->length, .label = label};
+  emit_int32(a, 0);
+}
+
+static void emit_rex(Assembler* a, bool wide, int reg, int index, int base) {
+  int rex = 0x40 | wide << 3 | (reg >> 3) << 2 | (index >> 3) << 1 |
+            (base >> 3);
+  if (rex != 0x40)
+    emit_byte(a, rex);
+}
+
+static void emit_opcode(Assembler* a, int op) {
+  if (op > 0xff)
+    emit_byte(a, op >> 8);
+  emit_byte(a, op & 0xff);
+}
+
+// `op reg, [base + index * 8 + disp]`, always with a 32-bit displacement
+static void emit_op_mem(Assembler* a, bool wide, int op, int reg, int base,
+  int index, int32_t disp) {
+  emit_rex(a, wide, reg, index, base);
+  emit_opcode(a, op);
+  if (index == NO_INDEX && (base & 7) != RSP) {
+    emit_byte(a, 0x80 | (reg & 7) << 3 | (base & 7));
+  } else {
+    emit_byte(a, 0x80 | (reg & 7) << 3 | RSP);
+    emit_byte(a, (index == NO_INDEX ? 0 : 3) << 6 | (index & 7) << 3 |
+                   (base & 7));
+  }
+  emit_int32(a, disp);
+}
+
+// `op reg, rm` between two registers
+static void emit_op_reg(Assembler* a, bool wide, int op, int reg, int rm) {
+  emit_rex(a, wide, reg, NO_INDEX, rm);
+  emit_opcode(a, op);
+  emit_byte(a, 0xc0 | (reg & 7) << 3 | (rm & 7));
+}
+
+static void emit_load(Assembler* a, int dst, int base, int32_t disp) {
+  emit_op_mem(a, true, 0x8b, dst, base, NO_INDEX, disp);
+}
+
+static void emit_store(Assembler* a, int base, int32_t disp, int src) {
+  emit_op_mem(a, true, 0x89, src, base, NO_INDEX, disp);
+}
+
+static void emit_store_imm(Assembler* a, int base, int32_t disp, int32_t imm) {
+  emit_op_mem(a, true, 0xc7, 0, base, NO_INDEX, disp);
+  emit_int32(a, imm);
+}
+
+// movsxd, sign-extending an int field of a struct
+static void emit_load_int(Assembler* a, int dst, int base, int32_t disp) {
+  emit_op_mem(a, true, 0x63, dst, base, NO_INDEX, disp);
+}
+
+static void emit_store_int(Assembler* a, int base, int32_t disp, int src) {
+  emit_op_mem(a, false, 0x89, src, base, NO_INDEX, disp);
+}
+
+static void emit_mov(Assembler* a, int dst, int src) {
+  emit_op_reg(a, true, 0x89, src, dst);
+}
+
+static void emit_mov_imm32(Assembler* a, int dst, int32_t imm) {
+  emit_rex(a, false, 0, NO_INDEX, dst);
+  emit_byte(a, 0xb8 + (dst & 7));
+  emit_int32(a, imm);
+}
+
+static void emit_mov_imm64(Assembler* a, int dst, int64_t imm) {
+  emit_rex(a, true, 0, NO_INDEX, dst);
+  emit_byte(a, 0xb8 + (dst & 7));
+  emit_int64(a, imm);
+}
+
+static void emit_alu(Assembler* a, bool wide, int op, int dst, int src) {
+  emit_op_reg(a, wide, op, src, dst);
+}
+
+static void emit_alu_imm(Assembler* a, int op, int dst, int32_t imm) {
+  emit_op_reg(a, true, 0x81, op, dst);
+  emit_int32(a, imm);
+}
+
+static void emit_jump(Assembler* a, int label) {
+  emit_byte(a, 0xe9);
+  emit_label_ref(a, label);
+}
+
+static void emit_jump_if(Assembler* a, int cc, int label) {
+  emit_byte(a, 0x0f);
+  emit_byte(a, 0x80 | cc);
+  emit_label_ref(a, label);
+}
+
+static void emit_push_reg(Assembler* a, int reg) {
+  emit_rex(a, false, 0, NO_INDEX, reg);
+  emit_byte(a, 0x50 + (reg & 7));
+}
+
+static void emit_pop_reg(Assembler* a, int reg) {
+  emit_rex(a, false, 0, NO_INDEX, reg);
+  emit_byte(a, 0x58 + (reg & 7));
+}
+
+// pushes a value onto the VM stack, which is known to have room for it
+static void emit_push(Assembler* a, int src) {
+  emit_store(a, SP, 0, src);
+  emit_alu_imm(a, IMM_ADD, SP, sizeof(Value));
+}
+
+// vm->sp = (r13 - vm->stack) / sizeof(Value)
+static void emit_sync_sp(Assembler* a) {
+  emit_op_mem(a, true, 0x8d, RAX, VM, NO_INDEX, offsetof(struct Vm_t, stack));
+  emit_mov(a, RCX, SP);
+  emit_alu(a, true, ALU_SUB, RCX, RAX);
+  emit_op_reg(a, true, 0xc1, 7, RCX);  // sar rcx, 3
+  emit_byte(a, 3);
+  emit_store_int(a, VM, offsetof(struct Vm_t, sp), RCX);
+}
+
+static void emit_reload_sp(Assembler* a) {
+  emit_load_int(a, RCX, VM, offsetof(struct Vm_t, sp));
+  emit_op_mem(a, true, 0x8d, SP, VM, RCX, offsetof(struct Vm_t, stack));
+}
+
+// restores the caller's registers, ahead of a return or a tail jump
+static void emit_epilogue(Assembler* a) {
+  emit_alu_imm(a, IMM_ADD, RSP, 16);
+  emit_pop_reg(a, R15);
+  emit_pop_reg(a, R14);
+  emit_pop_reg(a, R13);
+  emit_pop_reg(a, R12);
+  emit_pop_reg(a, RBX);
+}
+
+// calls `helper(vm, arg1, arg2)` with the stack pointer written back, and
+// leaves the function with the helper's error if it returns one
+static void emit_helper_call(
+  Assembler* a, int64_t helper, int arg1, int arg2, int exit) {
+  emit_sync_sp(a);
+  emit_mov(a, RDI, VM);
+  emit_mov_imm32(a, RSI, arg1);
+  emit_mov_imm32(a, RDX, arg2);
+  emit_mov_imm64(a, RAX, helper);
+  emit_op_reg(a, false, 0xff, 2, RAX);  // call rax
+  emit_alu(a, true, 0x85, RAX, RAX);    // test rax, rax
+  emit_jump_if(a, CC_NE, exit);
+  emit_reload_sp(a);
+}
+
+// rax, rcx = the top two values of the stack, jumping to `slow` unless
+// both are ints
+static void emit_int_operands(Assembler* a, int slow) {
+  emit_load(a, RAX, SP, -2 * (int)sizeof(Value));
+  emit_load(a, RCX, SP, -(int)sizeof(Value));
+  emit_op_reg(a, false, 0x89, RAX, RDX);  // mov edx, eax
+  emit_alu(a, false, ALU_AND, RDX, RCX);
+  emit_op_reg(a, false, 0xf7, 0, RDX);  // test edx, 1
+  emit_int32(a, 1);
+  emit_jump_if(a, CC_E, slow);
+}
+
+// rax = VALUE_INT(VALUE_AS_INT(rax) op VALUE_AS_INT(rcx)), with the
+// operation done on 32-bit ints to wrap like the VM's
+static void emit_int_arithmetic(Assembler* a, OpCode op) {
+  emit_op_reg(a, true, 0xc1, 7, RAX);  // sar rax, 1
+  emit_byte(a, 1);
+  emit_op_reg(a, true, 0xc1, 7, RCX);
+  emit_byte(a, 1);
+  if (op == OP_ADD)
+    emit_alu(a, false, ALU_ADD, RAX, RCX);
+  else if (op == OP_SUB)
+    emit_alu(a, false, ALU_SUB, RAX, RCX);
+  else
+    emit_op_reg(a, false, 0x0faf, RAX, RCX);  // imul eax, ecx
+  emit_op_reg(a, true, 0x63, RAX, RAX);       // movsxd rax, eax
+  emit_alu(a, true, ALU_ADD, RAX, RAX);
+  emit_alu_imm(a, IMM_OR, RAX, 1);
+}
+
+static OpCode generic_opcode(OpCode op) {
+  switch (op) {
+    case OP_ADD_INT:
+    case OP_ADD_LOCAL_CONSTANT:
+      return OP_ADD;
+    case OP_SUB_INT:
+    case OP_SUB_LOCAL_CONSTANT:
+      return OP_SUB;
+    case OP_MUL_INT:
+      return OP_MUL;
+    case OP_DIV_INT:
+      return OP_DIV;
+    case OP_EQUAL_INT:
+    case OP_JUMP_IF_NOT_EQUAL:
+      return OP_EQUAL;
+    case OP_NOT_EQUAL_INT:
+    case OP_JUMP_IF_EQUAL:
+      return OP_NOT_EQUAL;
+    case OP_GREATER_THAN_INT:
+    case OP_JUMP_IF_NOT_GREATER:
+      return OP_GREATER_THAN;
+    default:
+      return op;
+  }
+}
+
+#define COLLECT_GARBAGE()                  \
+  do {                                     \
+    if (heap_needs_collection(&vm->heap))  \
+      collect_garbage(vm);                 \
+  } while (0)
+
+#define CHECK(expr)  \
+  do {               \
+    err = (expr);    \
+    if (err)         \
+      return err;    \
+  } while (0)
+
+static NativeFn native_code(Vm vm, CompiledFunction* fn);
+
+// the runtime helpers called from native code, wrapping the VM's own with
+// the collection that follows them in the interpreter
+
+static VmErr jit_binary_operation(Vm vm, OpCode op) {
+  VmErr err;
+  CHECK(exec_binary_operation(vm, op));
+  COLLECT_GARBAGE();
+  return NULL;
+}
+
+static VmErr jit_comparison(Vm vm, OpCode op) {
+  return exec_comparison(vm, op);
+}
+
+static VmErr jit_minus(Vm vm) {
+  return exec_minus_operator(vm);
+}
+
+static VmErr jit_bang(Vm vm) {
+  return exec_bang_operator(vm);
+}
+
+static VmErr jit_array(Vm vm, int num_elements) {
+  VmErr err;
+  Object* array = build_array(vm, vm->sp - num_elements, vm->sp);
+  vm->sp -= num_elements;
+  CHECK(push(vm, VALUE_OBJ(array)));
+  COLLECT_GARBAGE();
+  return NULL;
+}
+
+static VmErr jit_hash(Vm vm, int num_elements) {
+  VmErr err;
+  CHECK(build_hash(vm, vm->sp - num_elements, vm->sp));
+  COLLECT_GARBAGE();
+  return NULL;
+}
+
+static VmErr jit_index(Vm vm) {
+  Value index = pop(vm);
+  Value left = pop(vm);
+  return exec_index_expr(vm, left, index);
+}
+
+static VmErr jit_get_builtin(Vm vm, int builtin_index) {
+  VmErr err;
+  CHECK(push(vm, VALUE_OBJ(get_builtin_by_index(builtin_index))));
+  COLLECT_GARBAGE();
+  return NULL;
+}
+
+static VmErr jit_closure(Vm vm, int const_index, int num_free) {
+  VmErr err;
+  CHECK(push_closure(vm, const_index, num_free));
+  COLLECT_GARBAGE();
+  return NULL;
+}
+
+// a called closure's native code runs to completion here, on the native
+// stack, which MAX_FRAMES bounds like the VM's
+static VmErr jit_call(Vm vm, int num_args) {
+  VmErr err;
+  int frames_index = vm->frames_index;
+  CHECK(execute_call(vm, num_args));
+  if (vm->frames_index > frames_index) {
+    NativeFn native = native_code(vm, current_frame(vm)->cl->fn);
+    if (!native)
+      return "jit: out of executable memory";
+    CHECK(native(vm));
+  }
+  COLLECT_GARBAGE();
+  return NULL;
+}
+
+// the caller's frame is replaced as in the interpreter, then the caller
+// jumps to the callee's `entry` in place of returning, so the native stack
+// doesn't grow either. Builtins leave `entry` NULL and return as usual
+static VmErr jit_tail_call(Vm vm, int num_args, NativeFn* entry) {
+  VmErr err;
+  Value callee = vm->stack[vm->sp - 1 - num_args];
+  *entry = NULL;
+  CHECK(execute_tail_call(vm, num_args));
+  if (VALUE_HAS_TYPE(callee, CLOSURE_OBJ)) {
+    *entry = native_code(vm, current_frame(vm)->cl->fn);
+    if (!*entry)
+      return "jit: out of executable memory";
+  }
+  COLLECT_GARBAGE();
+  return NULL;
+}
+
+static void emit_prologue(Assembler* a, int max_depth, int overflow) {
+  emit_push_reg(a, RBX);
+  emit_push_reg(a, R12);
+  emit_push_reg(a, R13);
+  emit_push_reg(a, R14);
+  emit_push_reg(a, R15);
+  emit_alu_imm(a, IMM_ADD, RSP, -16);  // keeps rsp 16-byte aligned
+  emit_mov(a, VM, RDI);
+
+  // rax = &vm->frames[vm->frames_index] - the frames' offset
+  emit_load_int(a, RAX, VM, offsetof(struct Vm_t, frames_index));
+  emit_op_reg(a, true, 0x69, RAX, RAX);  // imul rax, rax, sizeof(Frame)
+  emit_int32(a, sizeof(Frame));
+  emit_alu(a, true, ALU_ADD, RAX, VM);
+  int frame = offsetof(struct Vm_t, frames) - sizeof(Frame);
+  emit_load(a, CLOSURE, RAX, frame + offsetof(Frame, cl));
+  emit_load_int(a, RCX, RAX, frame + offsetof(Frame, base_pointer));
+  emit_op_mem(a, true, 0x8d, LOCALS, VM, RCX, offsetof(struct Vm_t, stack));
+  emit_load(a, CONSTANTS, VM, offsetof(struct Vm_t, constants));
+
+  emit_load_int(a, RCX, VM, offsetof(struct Vm_t, sp));
+  emit_alu_imm(a, IMM_CMP, RCX, STACK_SIZE - max_depth);
+  emit_jump_if(a, CC_G, overflow);
+  emit_op_mem(a, true, 0x8d, SP, VM, RCX, offsetof(struct Vm_t, stack));
+}
+
+// pops the frame, leaving the value in rax in the callee's slot
+static void emit_return(Assembler* a, int exit) {
+  emit_store(a, LOCALS, -(int)sizeof(Value), RAX);
+  emit_mov(a, SP, LOCALS);
+  emit_op_mem(a, false, 0x81, 0, VM, NO_INDEX,
+    offsetof(struct Vm_t, frames_index));  // add dword [..], -1
+  emit_int32(a, -1);
+  emit_sync_sp(a);
+  emit_alu(a, false, 0x31, RAX, RAX);  // xor eax, eax
+  emit_jump(a, exit);
+}
+
+static void compile_instruction(Assembler* a, Byte* bytes, int exit) {
+  OpCode op = bytes[0];
+  int done = new_label(a), slow = new_label(a);
+  switch (op) {
+    case OP_CONSTANT:
+      emit_load(a, RAX, CONSTANTS, read_uint16(&bytes[1]) * sizeof(Value));
+      emit_push(a, RAX);
+      break;
+
+    case OP_TRUE:
+    case OP_FALSE:
+    case OP_NULL:
+      emit_store_imm(a, SP, 0,
+        op == OP_TRUE ? VALUE_TRUE : op == OP_FALSE ? VALUE_FALSE : VALUE_NULL);
+      emit_alu_imm(a, IMM_ADD, SP, sizeof(Value));
+      break;
+
+    case OP_POP:
+      emit_alu_imm(a, IMM_ADD, SP, -(int)sizeof(Value));
+      break;
+
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+    case OP_ADD_INT:
+    case OP_SUB_INT:
+    case OP_MUL_INT:
+      emit_int_operands(a, slow);
+      emit_int_arithmetic(a, generic_opcode(op));
+      emit_store(a, SP, -2 * (int)sizeof(Value), RAX);
+      emit_alu_imm(a, IMM_ADD, SP, -(int)sizeof(Value));
+      emit_jump(a, done);
+      bind(a, slow);
+      emit_helper_call(
+        a, (int64_t)jit_binary_operation, generic_opcode(op), 0, exit);
+      break;
+
+    // rare enough in hot code to leave to the VM
+    case OP_DIV:
+    case OP_DIV_INT:
+      emit_helper_call(a, (int64_t)jit_binary_operation, OP_DIV, 0, exit);
+      break;
+
+    case OP_EQUAL:
+    case OP_NOT_EQUAL:
+    case OP_GREATER_THAN:
+    case OP_EQUAL_INT:
+    case OP_NOT_EQUAL_INT:
+    case OP_GREATER_THAN_INT: {
+      OpCode comparison = generic_opcode(op);
+      int cc = comparison == OP_EQUAL       ? CC_E
+               : comparison == OP_NOT_EQUAL ? CC_NE
+                                            : CC_G;
+      emit_int_operands(a, slow);
+      // tagging preserves the order of ints, so they compare as is
+      emit_alu(a, true, ALU_CMP, RAX, RCX);
+      emit_op_reg(a, false, 0x0f90 | cc, 0, RAX);    // setcc al
+      emit_op_reg(a, false, 0x0fb6, RAX, RAX);       // movzx eax, al
+      emit_alu(a, false, ALU_ADD, RAX, RAX);         // VALUE_FALSE or
+      emit_alu_imm(a, IMM_ADD, RAX, VALUE_FALSE);    // VALUE_TRUE
+      emit_store(a, SP, -2 * (int)sizeof(Value), RAX);
+      emit_alu_imm(a, IMM_ADD, SP, -(int)sizeof(Value));
+      emit_jump(a, done);
+      bind(a, slow);
+      emit_helper_call(a, (int64_t)jit_comparison, comparison, 0, exit);
+      break;
+    }
+
+    case OP_GET_LOCAL_CONSTANT:
+      emit_load(a, RAX, LOCALS, bytes[1] * sizeof(Value));
+      emit_push(a, RAX);
+      emit_load(a, RAX, CONSTANTS, read_uint16(&bytes[2]) * sizeof(Value));
+      emit_push(a, RAX);
+      break;
+
+    case OP_ADD_LOCAL_CONSTANT:
+    case OP_SUB_LOCAL_CONSTANT:
+      emit_load(a, RAX, LOCALS, bytes[1] * sizeof(Value));
+      emit_push(a, RAX);
+      emit_load(a, RAX, CONSTANTS, read_uint16(&bytes[2]) * sizeof(Value));
+      emit_push(a, RAX);
+      emit_int_operands(a, slow);
+      emit_int_arithmetic(a, generic_opcode(op));
+      emit_store(a, SP, -2 * (int)sizeof(Value), RAX);
+      emit_alu_imm(a, IMM_ADD, SP, -(int)sizeof(Value));
+      emit_jump(a, done);
+      bind(a, slow);
+      emit_helper_call(
+        a, (int64_t)jit_binary_operation, generic_opcode(op), 0, exit);
+      break;
+
+    case OP_JUMP_IF_NOT_EQUAL:
+    case OP_JUMP_IF_EQUAL:
+    case OP_JUMP_IF_NOT_GREATER: {
+      int target = read_uint32(&bytes[1]);
+      int cc = op == OP_JUMP_IF_NOT_EQUAL ? CC_NE
+               : op == OP_JUMP_IF_EQUAL   ? CC_E
+                                          : CC_LE;
+      emit_int_operands(a, slow);
+      emit_alu_imm(a, IMM_ADD, SP, -2 * (int)sizeof(Value));
+      emit_alu(a, true, ALU_CMP, RAX, RCX);
+      emit_jump_if(a, cc, target);
+      emit_jump(a, done);
+      bind(a, slow);
+      emit_helper_call(a, (int64_t)jit_comparison, generic_opcode(op), 0, exit);
+      emit_alu_imm(a, IMM_ADD, SP, -(int)sizeof(Value));
+      emit_load(a, RAX, SP, 0);
+      emit_alu_imm(a, IMM_CMP, RAX, VALUE_TRUE);
+      emit_jump_if(a, CC_NE, target);
+      break;
+    }
+
+    case OP_MINUS:
+      emit_helper_call(a, (int64_t)jit_minus, 0, 0, exit);
+      break;
+
+    case OP_BANG:
+      emit_helper_call(a, (int64_t)jit_bang, 0, 0, exit);
+      break;
+
+    case OP_JUMP:
+      emit_jump(a, read_uint32(&bytes[1]));
+      break;
+
+    case OP_JUMP_NOT_TRUTHY: {
+      int target = read_uint32(&bytes[1]);
+      emit_alu_imm(a, IMM_ADD, SP, -(int)sizeof(Value));
+      emit_load(a, RAX, SP, 0);
+      emit_alu_imm(a, IMM_CMP, RAX, VALUE_NULL);
+      emit_jump_if(a, CC_E, target);
+      emit_alu_imm(a, IMM_CMP, RAX, VALUE_FALSE);
+      emit_jump_if(a, CC_E, target);
+      break;
+    }
+
+    case OP_GET_GLOBAL:
+      emit_load(a, RAX, VM, offsetof(struct Vm_t, globals));
+      emit_load(a, RAX, RAX, read_uint16(&bytes[1]) * sizeof(Value));
+      emit_push(a, RAX);
+      break;
+
+    case OP_SET_GLOBAL: {
+      int global_index = read_uint16(&bytes[1]);
+      emit_alu_imm(a, IMM_ADD, SP, -(int)sizeof(Value));
+      emit_load(a, RCX, SP, 0);
+      emit_load(a, RAX, VM, offsetof(struct Vm_t, globals));
+      emit_store(a, RAX, global_index * sizeof(Value), RCX);
+      emit_op_mem(a, false, 0x81, IMM_CMP, VM, NO_INDEX,
+        offsetof(struct Vm_t, num_globals));
+      emit_int32(a, global_index + 1);
+      emit_jump_if(a, CC_GE, done);
+      emit_op_mem(a, false, 0xc7, 0, VM, NO_INDEX,
+        offsetof(struct Vm_t, num_globals));
+      emit_int32(a, global_index + 1);
+      break;
+    }
+
+    case OP_SET_LOCAL:
+      emit_alu_imm(a, IMM_ADD, SP, -(int)sizeof(Value));
+      emit_load(a, RAX, SP, 0);
+      emit_store(a, LOCALS, bytes[1] * sizeof(Value), RAX);
+      break;
+
+    case OP_GET_LOCAL:
+      emit_load(a, RAX, LOCALS, bytes[1] * sizeof(Value));
+      emit_push(a, RAX);
+      break;
+
+    case OP_ARRAY:
+      emit_helper_call(a, (int64_t)jit_array, read_uint16(&bytes[1]), 0, exit);
+      break;
+
+    case OP_HASH:
+      emit_helper_call(a, (int64_t)jit_hash, read_uint16(&bytes[1]), 0, exit);
+      break;
+
+    case OP_INDEX:
+      emit_helper_call(a, (int64_t)jit_index, 0, 0, exit);
+      break;
+
+    case OP_CALL:
+      emit_helper_call(a, (int64_t)jit_call, bytes[1], 0, exit);
+      break;
+
+    case OP_TAIL_CALL:
+      emit_sync_sp(a);
+      emit_mov(a, RDI, VM);
+      emit_mov_imm32(a, RSI, bytes[1]);
+      emit_mov(a, RDX, RSP);  // the entry is returned in the spill slot
+      emit_mov_imm64(a, RAX, (int64_t)jit_tail_call);
+      emit_op_reg(a, false, 0xff, 2, RAX);  // call rax
+      emit_alu(a, true, 0x85, RAX, RAX);
+      emit_jump_if(a, CC_NE, exit);
+      emit_load(a, RAX, RSP, 0);
+      emit_alu(a, true, 0x85, RAX, RAX);
+      emit_jump_if(a, CC_E, slow);
+      emit_mov(a, RDI, VM);
+      emit_epilogue(a);
+      emit_op_reg(a, false, 0xff, 4, RAX);  // jmp rax
+      bind(a, slow);
+      emit_reload_sp(a);
+      break;
+
+    case OP_RETURN_VALUE:
+      emit_load(a, RAX, SP, -(int)sizeof(Value));
+      emit_return(a, exit);
+      break;
+
+    case OP_RETURN:
+      emit_mov_imm32(a, RAX, VALUE_NULL);
+      emit_return(a, exit);
+      break;
+
+    case OP_GET_BUILTIN:
+      emit_helper_call(a, (int64_t)jit_get_builtin, bytes[1], 0, exit);
+      break;
+
+    case OP_CLOSURE:
+      emit_helper_call(
+        a, (int64_t)jit_closure, read_uint16(&bytes[1]), bytes[3], exit);
+      break;
+
+    case OP_CURRENT_CLOSURE:
+      emit_load(a, RAX, CLOSURE, offsetof(Closure, object));
+      emit_push(a, RAX);
+      break;
+
+    case OP_GET_FREE:
+      emit_load(
+        a, RAX, CLOSURE, offsetof(Closure, free) + bytes[1] * sizeof(Value));
+      emit_push(a, RAX);
+      break;
+  }
+  bind(a, done);
+}
+
+// translates the whole function into a fresh mapping, made executable (and
+// no longer writable) once it's complete
+static NativeFn compile_function(CompiledFunction* fn) {
+  Instruct* ins = fn->instructions;
+  Assembler a = {0};
+  a.capacity = 64 + ins->length * 16;
+  a.code = malloc(a.capacity);
+  for (int i = 0; i <= ins->length; i++)
+    new_label(&a);
+  int exit = new_label(&a), overflow = new_label(&a);
+
+  emit_prologue(&a, code_max_stack_depth(ins), overflow);
+  for (int ip = 0; ip < ins->length;
+       ip += code_instruction_width(ins->bytes[ip])) {
+    bind(&a, ip);
+    compile_instruction(&a, &ins->bytes[ip], exit);
+  }
+  // only the main program runs off its end
+  bind(&a, ins->length);
+  emit_sync_sp(&a);
+  emit_alu(&a, false, 0x31, RAX, RAX);
+  bind(&a, exit);
+  emit_epilogue(&a);
+  emit_byte(&a, 0xc3);  // ret
+  bind(&a, overflow);
+  emit_mov_imm64(&a, RAX, (int64_t) "stack overflow");
+  emit_jump(&a, exit);
+
+  for (int i = 0; i < a.num_fixups; i++) {
+    Fixup fixup = a.fixups[i];
+    int32_t rel = a.labels[fixup.label] - (fixup.at + 4);
+    memcpy(&a.code[fixup.at], &rel, sizeof(rel));
+  }
+
+  void* native = mmap(NULL, a.length, PROT_READ | PROT_WRITE,
+    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (native != MAP_FAILED) {
+    memcpy(native, a.code, a.length);
+    if (mprotect(native, a.length, PROT_READ | PROT_EXEC) != 0) {
+      munmap(native, a.length);
+      native = MAP_FAILED;
+    }
+  }
+  free(a.code);
+  free(a.labels);
+  free(a.fixups);
+  return native == MAP_FAILED ? NULL : (NativeFn)native;
+}
+
+// the native code is kept on the function, shared by every closure of it
+static NativeFn native_code(Vm vm, CompiledFunction* fn) {
+  if (!fn->native) {
+    fn->native = compile_function(fn);
+    if (fn->native)
+      vm->stats.jit_compiled++;
+  }
+  return (NativeFn)fn->native;
+}
+
+VmErr jit_run(Vm vm) {
+  NativeFn native = native_code(vm, current_frame(vm)->cl->fn);
+  if (!native)
+    return "jit: out of executable memory";
+  return native(vm);
+}
+
+#else
+
+VmErr jit_run(Vm vm) {
+  (void)vm;
+  return "jit: not supported on this platform";
+}
+
+#endif  // JIT_SUPPORTED
@@ -1,424 +1,698 @@
-#include "vm.h"
+#include "vm_internal.h"
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "../code/code.h"
 #include "../compiler/compiler.h"
 
-#define STACK_SIZE 2048
-#define MAX_FRAMES 1024
-
 #define SET_ERR(fmt, ...)             \
   do {                                \
     err = malloc(500 * sizeof(char)); \
     sprintf(err, fmt, __VA_ARGS__);   \
   } while (0)
 
-typedef struct Frame {
-  Closure* cl;
-  int ip;
-  int base_pointer;
-} Frame;
-
-struct Vm_t {
-  ConstantPool* constant_pool;
-  Object* stack[STACK_SIZE];
-  Object** globals;
-  Frame* frames[MAX_FRAMES];
-  int frames_index;
-  int sp;
-};
-
-static VmErr push(Vm vm, Object* object);
-static Object* pop(Vm vm);
-static Object* bool_obj(bool boolean);
-static Object* build_array(Vm vm, int start_index, int end_index);
-static Object* build_hash(Vm vm, int start_index, int end_index);
-static VmErr exec_index_expr(Vm vm, Object* left, Object* index);
-static VmErr exec_array_index(Vm vm, Object* array, Object* index);
-static VmErr exec_hash_index(Vm vm, Object* hash, Object* index);
-static VmErr exec_binary_operation(Vm vm, OpCode op);
+static VmErr run(Vm vm);
+static VmErr exec_array_index(Vm vm, Object* array, int index);
+static VmErr exec_hash_index(Vm vm, Object* hash, Value index);
 static VmErr exec_binary_int_operation(Vm vm, OpCode op, int left, int right);
 static VmErr exec_binary_str_operation(
   Vm vm, OpCode op, char* left, char* right);
-static VmErr exec_comparison(Vm vm, OpCode op);
 static VmErr exec_int_comparison(Vm vm, OpCode op, int left, int right);
-static VmErr exec_bang_operator(Vm vm);
-static VmErr exec_minus_operator(Vm vm);
 void inspect_stack(Vm vm, const char* fn);
 static Object* new_compiled_fn(Instruct* instructions, int num_locals);
-static Frame* new_frame(Closure* cl, int base_pointer);
-static Frame* current_frame(Vm vm);
-static void push_frame(Vm vm, Frame* frame);
-static Frame* pop_frame(Vm vm);
-static Instruct* current_instructions(Vm vm);
+static Frame* push_frame(Vm vm, Closure* cl, int base_pointer);
+static void pop_frame(Vm vm);
 static VmErr call_closure(Vm vm, Object* fn, int num_args);
 static VmErr call_builtin(Vm vm, Object* fn, int num_args);
-static VmErr execute_call(Vm vm, int num_args);
-static VmErr push_closure(Vm vm, int const_index, int num_free);
+static Closure* new_closure(CompiledFunction* fn, int num_free);
+static OpCode int_specialized(OpCode op);
+static OpCode generic(OpCode op);
+static void quicken(Vm vm, Byte* op);
+static void dequicken(Vm vm, Byte* op);
 
 static VmErr err = NULL;
 
 Vm vm_new(Bytecode* bytecode) {
-  Object** globals = calloc(GLOBALS_SIZE, sizeof(Object*));
+  Value* globals = calloc(GLOBALS_SIZE, sizeof(Value));
   return vm_new_with_globals(bytecode, globals);
 }
 
-Vm vm_new_with_globals(Bytecode* bytecode, Object** globals) {
+Vm vm_new_with_globals(Bytecode* bytecode, Value* globals) {
   struct Vm_t* vm = malloc(sizeof(struct Vm_t));
+  ConstantPool* pool = bytecode->constants;
+  vm->constants = malloc(sizeof(Value) * (pool->length + 1));
+  for (int i = 0; i < pool->length; i++)
+    vm->constants[i] = value_from(pool->constants[i]);
+  vm->num_constants = pool->length;
   vm->globals = globals;
-  vm->constant_pool = bytecode->constants;
+  vm->num_globals = GLOBALS_SIZE;
+  while (vm->num_globals > 0 && globals[vm->num_globals - 1] == 0)
+    vm->num_globals--;
   vm->sp = 0;
+  vm->jit = false;
+  vm->stats = (VmStats){0};
+#ifdef MONKEY_PROFILE
+  vm->stats.opcode_pairs = calloc(NUM_OPCODES * NUM_OPCODES, sizeof(long));
+#endif
+  heap_init(&vm->heap);
   Object* main_fn = new_compiled_fn(bytecode->instructions, 0);
-  Closure* main_closure = malloc(sizeof(Closure));
-  main_closure->fn = main_fn->value.compiled_fn;
-  vm->frames[0] = new_frame(main_closure, 0);
-  vm->frames_index = 1;
+  Closure* main_closure = new_closure(main_fn->value.compiled_fn, 0);
+  vm->frames_index = 0;
+  push_frame(vm, main_closure, 0);
   return vm;
 }
 
 VmErr vm_run(Vm vm) {
-  int global_index, local_index, ip;
-  Instruct* ins;
-  while (current_frame(vm)->ip < current_instructions(vm)->length - 1) {
-    current_frame(vm)->ip++;
-    ip = current_frame(vm)->ip;
-    ins = current_instructions(vm);
-    OpCode op = ins->bytes[ip];
-    switch (op) {
-      case OP_CONSTANT: {
-        int const_idx = read_uint16(&ins->bytes[ip + 1]);
-        current_frame(vm)->ip += 2;
-        err = push(vm, &vm->constant_pool->constants[const_idx]);
-        if (err)
-          return err;
-      } break;
-
-      case OP_TRUE:
-        err = push(vm, &TRUE);
-        if (err)
-          return err;
-        break;
-
-      case OP_FALSE:
-        err = push(vm, &FALSE);
-        if (err)
-          return err;
-        break;
-
-      case OP_ADD:  // fallthrough
-      case OP_SUB:  // fallthrough
-      case OP_MUL:  // fallthrough
-      case OP_DIV:  // fallthrough
-        err = exec_binary_operation(vm, op);
-        if (err)
-          return err;
-        break;
-
-      case OP_EQUAL:         // fallthrough
-      case OP_NOT_EQUAL:     // fallthrough
-      case OP_GREATER_THAN:  // fallthrough
-        err = exec_comparison(vm, op);
-        if (err)
-          return err;
-        break;
-
-      case OP_POP:
-        pop(vm);
-        break;
-
-      case OP_MINUS:
-        err = exec_minus_operator(vm);
-        if (err)
-          return err;
-        break;
-
-      case OP_BANG:
-        err = exec_bang_operator(vm);
-        if (err)
-          return err;
-        break;
-
-      case OP_JUMP: {
-        int pos = read_uint16(&ins->bytes[ip + 1]);
-        current_frame(vm)->ip = pos - 1;
-      } break;
-
-      case OP_JUMP_NOT_TRUTHY: {
-        int pos = read_uint16(&ins->bytes[ip + 1]);
-        current_frame(vm)->ip += 2;
-        Object* condition = pop(vm);
-        if (!is_truthy(*condition)) {
-          current_frame(vm)->ip = pos - 1;
-        }
-      } break;
-
-      case OP_NULL:
-        err = push(vm, &M_NULL);
-        if (err)
-          return err;
-        break;
-
-      case OP_GET_GLOBAL:
-        global_index = read_uint16(&ins->bytes[ip + 1]);
-        current_frame(vm)->ip += 2;
-        err = push(vm, vm->globals[global_index]);
-        if (err)
-          return err;
-        break;
-
-      case OP_SET_GLOBAL:
-        global_index = read_uint16(&ins->bytes[ip + 1]);
-        current_frame(vm)->ip += 2;
-        vm->globals[global_index] = pop(vm);
-        break;
-
-      case OP_SET_LOCAL: {
-        local_index = (int)ins->bytes[ip + 1];
-        Frame* frame = current_frame(vm);
-        frame->ip += 1;
-        vm->stack[frame->base_pointer + local_index] = pop(vm);
-      } break;
-
-      case OP_GET_LOCAL: {
-        local_index = (int)ins->bytes[ip + 1];
-        Frame* frame = current_frame(vm);
-        frame->ip += 1;
-        err = push(vm, vm->stack[frame->base_pointer + local_index]);
-        if (err)
-          return err;
-      } break;
-
-      case OP_ARRAY: {
-        int num_elements = read_uint16(&ins->bytes[ip + 1]);
-        current_frame(vm)->ip += 2;
-        Object* array = build_array(vm, vm->sp - num_elements, vm->sp);
-        vm->sp = vm->sp - num_elements;
-        err = push(vm, array);
-        if (err)
-          return err;
-      } break;
-
-      case OP_HASH: {
-        int num_elements = read_uint16(&ins->bytes[ip + 1]);
-        current_frame(vm)->ip += 2;
-        Object* hash = build_hash(vm, vm->sp - num_elements, vm->sp);
-        vm->sp = vm->sp - num_elements;
-        err = push(vm, hash);
-        if (err)
-          return err;
-      } break;
-
-      case OP_INDEX: {
-        Object* index = pop(vm);
-        Object* left = pop(vm);
-        err = exec_index_expr(vm, left, index);
-        if (err)
-          return err;
-      } break;
-
-      case OP_CALL: {
-        int num_args = (int)ins->bytes[ip + 1];
-        current_frame(vm)->ip += 1;
-        err = execute_call(vm, num_args);
-        if (err)
-          return err;
-      } break;
-
-      case OP_RETURN_VALUE: {
-        Object* return_value = pop(vm);
-        Frame* frame = pop_frame(vm);
-        vm->sp = frame->base_pointer - 1;
-        err = push(vm, return_value);
-        if (err)
-          return err;
-      } break;
-
-      case OP_RETURN: {
-        Frame* frame = pop_frame(vm);
-        vm->sp = frame->base_pointer - 1;
-        err = push(vm, &M_NULL);
-        if (err)
-          return err;
-      } break;
-
-      case OP_GET_BUILTIN: {
-        int builtin_index = (int)ins->bytes[ip + 1];
-        current_frame(vm)->ip += 1;
-        Object* builtin = get_builtin_by_index(builtin_index);
-        err = push(vm, builtin);
-        if (err)
-          return err;
-      } break;
-
-      case OP_CLOSURE: {
-        int const_index = read_uint16(&ins->bytes[ip + 1]);
-        int num_free = (int)ins->bytes[ip + 3];
-        current_frame(vm)->ip += 3;
-        err = push_closure(vm, const_index, num_free);
-        if (err)
-          return err;
-      } break;
-
-      case OP_CURRENT_CLOSURE: {
-        Closure* current_closure = current_frame(vm)->cl;
-        Object* object = malloc(sizeof(Object));
-        object->type = CLOSURE_OBJ;
-        object->value.closure = current_closure;
-        err = push(vm, object);
-        if (err)
-          return err;
-      } break;
-
-      case OP_GET_FREE: {
-        int free_index = (int)ins->bytes[ip + 1];
-        current_frame(vm)->ip += 1;
-        Closure* current_closure = current_frame(vm)->cl;
-        err = push(vm, current_closure->free[free_index]);
-        if (err)
-          return err;
-      } break;
+  long allocations[NUM_OBJECT_TYPES];
+  for (int type = 0; type < NUM_OBJECT_TYPES; type++)
+    allocations[type] = object_alloc_count_of(type);
+  heap_activate(&vm->heap);
+  VmErr run_err = vm->jit ? jit_run(vm) : run(vm);
+  heap_activate(NULL);
+  for (int type = 0; type < NUM_OBJECT_TYPES; type++) {
+    long allocated = object_alloc_count_of(type) - allocations[type];
+    vm->stats.allocations_by_type[type] += allocated;
+    vm->stats.allocations += allocated;
+  }
+  return run_err;
+}
+
+bool vm_use_jit(Vm vm) {
+#ifdef JIT_SUPPORTED
+  vm->jit = true;
+#endif
+  return vm->jit;
+}
+
+VmStats vm_stats(Vm vm) {
+  return vm->stats;
+}
+
+// threaded dispatch through a labels-as-values jump table when the compiler
+// supports it, unless the portable `switch` is requested at build time
+// with `make monkey DISPATCH=switch`
+#if defined(__GNUC__) && !defined(MONKEY_SWITCH_DISPATCH)
+#define COMPUTED_GOTO
+#endif
+
+// counts every dispatched instruction, and each pair of consecutive ones
+#ifdef MONKEY_PROFILE
+#define PROFILE_DISPATCH()                                                \
+  do {                                                                    \
+    vm->stats.dispatches++;                                               \
+    vm->stats.opcode_pairs[prev_op * NUM_OPCODES + bytes[ip]]++;          \
+    prev_op = bytes[ip];                                                  \
+  } while (0)
+#else
+#define PROFILE_DISPATCH()
+#endif
+
+#ifdef COMPUTED_GOTO
+#pragma GCC diagnostic ignored "-Wpedantic"
+#define TARGET(op) L_##op:
+#define DISPATCH()                   \
+  do {                               \
+    if (++ip >= length)              \
+      goto done;                     \
+    PROFILE_DISPATCH();              \
+    goto* dispatch_table[bytes[ip]]; \
+  } while (0)
+#else
+#define TARGET(op) case op:
+#define DISPATCH() continue
+#endif
+
+// the current frame's ip, instructions and base pointer live in locals while
+// the frame executes, and are only written back when the frame changes
+#define SAVE_FRAME() frame->ip = ip
+#define LOAD_FRAME()                                 \
+  do {                                               \
+    frame = current_frame(vm);                       \
+    bytes = frame->cl->fn->instructions->bytes;      \
+    length = frame->cl->fn->instructions->length;    \
+    ip = frame->ip;                                  \
+    bp = frame->base_pointer;                        \
+  } while (0)
+
+// only called right after an instruction's result is pushed, when every live
+// value is reachable from the stack, globals, frames or constants
+#define COLLECT_GARBAGE()                  \
+  do {                                     \
+    if (heap_needs_collection(&vm->heap))  \
+      collect_garbage(vm);                 \
+  } while (0)
+
+// both operands are ints iff the int tag survives and-ing them together
+#define BOTH_INTS(left, right) VALUE_IS_INT((left) & (right))
+
+#define CHECK(expr)  \
+  do {               \
+    err = (expr);    \
+    if (err)         \
+      return err;    \
+  } while (0)
+
+static VmErr run(Vm vm) {
+  Frame* frame;
+  Byte* bytes;
+  int length, ip, bp;
+  LOAD_FRAME();
+#ifdef MONKEY_PROFILE
+  OpCode prev_op = OP_POP;
+#endif
+
+#ifdef COMPUTED_GOTO
+  static void* dispatch_table[] = {
+    [OP_CONSTANT] = &&L_OP_CONSTANT,
+    [OP_ADD] = &&L_OP_ADD,
+    [OP_POP] = &&L_OP_POP,
+    [OP_SUB] = &&L_OP_SUB,
+    [OP_MUL] = &&L_OP_MUL,
+    [OP_DIV] = &&L_OP_DIV,
+    [OP_TRUE] = &&L_OP_TRUE,
+    [OP_FALSE] = &&L_OP_FALSE,
+    [OP_NULL] = &&L_OP_NULL,
+    [OP_EQUAL] = &&L_OP_EQUAL,
+    [OP_NOT_EQUAL] = &&L_OP_NOT_EQUAL,
+    [OP_GREATER_THAN] = &&L_OP_GREATER_THAN,
+    [OP_MINUS] = &&L_OP_MINUS,
+    [OP_BANG] = &&L_OP_BANG,
+    [OP_JUMP] = &&L_OP_JUMP,
+    [OP_JUMP_NOT_TRUTHY] = &&L_OP_JUMP_NOT_TRUTHY,
+    [OP_SET_GLOBAL] = &&L_OP_SET_GLOBAL,
+    [OP_GET_GLOBAL] = &&L_OP_GET_GLOBAL,
+    [OP_SET_LOCAL] = &&L_OP_SET_LOCAL,
+    [OP_GET_LOCAL] = &&L_OP_GET_LOCAL,
+    [OP_ARRAY] = &&L_OP_ARRAY,
+    [OP_HASH] = &&L_OP_HASH,
+    [OP_INDEX] = &&L_OP_INDEX,
+    [OP_CALL] = &&L_OP_CALL,
+    [OP_RETURN] = &&L_OP_RETURN,
+    [OP_RETURN_VALUE] = &&L_OP_RETURN_VALUE,
+    [OP_GET_BUILTIN] = &&L_OP_GET_BUILTIN,
+    [OP_CLOSURE] = &&L_OP_CLOSURE,
+    [OP_CURRENT_CLOSURE] = &&L_OP_CURRENT_CLOSURE,
+    [OP_GET_FREE] = &&L_OP_GET_FREE,
+    [OP_TAIL_CALL] = &&L_OP_TAIL_CALL,
+    [OP_ADD_INT] = &&L_OP_ADD_INT,
+    [OP_SUB_INT] = &&L_OP_SUB_INT,
+    [OP_MUL_INT] = &&L_OP_MUL_INT,
+    [OP_DIV_INT] = &&L_OP_DIV_INT,
+    [OP_EQUAL_INT] = &&L_OP_EQUAL_INT,
+    [OP_NOT_EQUAL_INT] = &&L_OP_NOT_EQUAL_INT,
+    [OP_GREATER_THAN_INT] = &&L_OP_GREATER_THAN_INT,
+    [OP_GET_LOCAL_CONSTANT] = &&L_OP_GET_LOCAL_CONSTANT,
+    [OP_ADD_LOCAL_CONSTANT] = &&L_OP_ADD_LOCAL_CONSTANT,
+    [OP_SUB_LOCAL_CONSTANT] = &&L_OP_SUB_LOCAL_CONSTANT,
+    [OP_JUMP_IF_NOT_EQUAL] = &&L_OP_JUMP_IF_NOT_EQUAL,
+    [OP_JUMP_IF_EQUAL] = &&L_OP_JUMP_IF_EQUAL,
+    [OP_JUMP_IF_NOT_GREATER] = &&L_OP_JUMP_IF_NOT_GREATER,
+  };
+  DISPATCH();
+#else
+  for (;;) {
+    if (++ip >= length)
+      goto done;
+    PROFILE_DISPATCH();
+    switch (bytes[ip]) {
+#endif
+
+  TARGET(OP_CONSTANT) {
+    int const_idx = read_uint16(&bytes[ip + 1]);
+    ip += 2;
+    CHECK(push(vm, vm->constants[const_idx]));
+  }
+  DISPATCH();
+
+  TARGET(OP_TRUE) {
+    CHECK(push(vm, VALUE_TRUE));
+  }
+  DISPATCH();
+
+  TARGET(OP_FALSE) {
+    CHECK(push(vm, VALUE_FALSE));
+  }
+  DISPATCH();
+
+  TARGET(OP_ADD)
+  TARGET(OP_SUB)
+  TARGET(OP_MUL)
+  TARGET(OP_DIV) {
+    OpCode op = bytes[ip];
+    quicken(vm, &bytes[ip]);
+    CHECK(exec_binary_operation(vm, op));
+    COLLECT_GARBAGE();
+  }
+  DISPATCH();
+
+  TARGET(OP_EQUAL)
+  TARGET(OP_NOT_EQUAL)
+  TARGET(OP_GREATER_THAN) {
+    OpCode op = bytes[ip];
+    quicken(vm, &bytes[ip]);
+    CHECK(exec_comparison(vm, op));
+  }
+  DISPATCH();
+
+// on a type miss the generic opcode is restored and re-dispatched, as it
+// is to report a division by zero
+#define INT_OPERATION(quick_op, result)                      \
+  TARGET(quick_op) {                                         \
+    Value right = vm->stack[vm->sp - 1];                     \
+    Value left = vm->stack[vm->sp - 2];                      \
+    if (!BOTH_INTS(left, right) ||                           \
+        (quick_op == OP_DIV_INT && right == VALUE_INT(0))) { \
+      dequicken(vm, &bytes[ip]);                             \
+      ip--;                                                  \
+      DISPATCH();                                            \
+    }                                                        \
+    int l = VALUE_AS_INT(left), r = VALUE_AS_INT(right);     \
+    vm->stack[--vm->sp - 1] = (result);                      \
+  }                                                          \
+  DISPATCH();
+
+  INT_OPERATION(OP_ADD_INT, VALUE_INT(l + r))
+  INT_OPERATION(OP_SUB_INT, VALUE_INT(l - r))
+  INT_OPERATION(OP_MUL_INT, VALUE_INT(l * r))
+  INT_OPERATION(OP_DIV_INT, VALUE_INT(l / r))
+  INT_OPERATION(OP_EQUAL_INT, VALUE_BOOL(l == r))
+  INT_OPERATION(OP_NOT_EQUAL_INT, VALUE_BOOL(l != r))
+  INT_OPERATION(OP_GREATER_THAN_INT, VALUE_BOOL(l > r))
+
+  TARGET(OP_GET_LOCAL_CONSTANT) {
+    int local_index = bytes[ip + 1];
+    int const_idx = read_uint16(&bytes[ip + 2]);
+    ip += 3;
+    CHECK(push(vm, vm->stack[bp + local_index]));
+    CHECK(push(vm, vm->constants[const_idx]));
+  }
+  DISPATCH();
+
+// `local op constant`, with the int case inline and the rest left to
+// the generic opcode's implementation
+#define LOCAL_CONSTANT_OPERATION(fused_op, generic_op, result)  \
+  TARGET(fused_op) {                                           \
+    Value left = vm->stack[bp + bytes[ip + 1]];                \
+    Value right = vm->constants[read_uint16(&bytes[ip + 2])];  \
+    ip += 3;                                                   \
+    if (BOTH_INTS(left, right)) {                              \
+      int l = VALUE_AS_INT(left), r = VALUE_AS_INT(right);     \
+      CHECK(push(vm, (result)));                               \
+    } else {                                                   \
+      CHECK(push(vm, left));                                   \
+      CHECK(push(vm, right));                                  \
+      CHECK(exec_binary_operation(vm, generic_op));            \
+      COLLECT_GARBAGE();                                       \
+    }                                                          \
+  }                                                            \
+  DISPATCH();
+
+  LOCAL_CONSTANT_OPERATION(OP_ADD_LOCAL_CONSTANT, OP_ADD, VALUE_INT(l + r))
+  LOCAL_CONSTANT_OPERATION(OP_SUB_LOCAL_CONSTANT, OP_SUB, VALUE_INT(l - r))
+
+// a comparison followed by OP_JUMP_NOT_TRUTHY
+#define COMPARE_AND_JUMP(fused_op, generic_op, int_result)  \
+  TARGET(fused_op) {                                       \
+    int pos = read_uint32(&bytes[ip + 1]);                 \
+    ip += 4;                                               \
+    Value right = vm->stack[vm->sp - 1];                   \
+    Value left = vm->stack[vm->sp - 2];                    \
+    bool result;                                           \
+    if (BOTH_INTS(left, right)) {                          \
+      int l = VALUE_AS_INT(left), r = VALUE_AS_INT(right); \
+      vm->sp -= 2;                                         \
+      result = (int_result);                               \
+    } else {                                               \
+      CHECK(exec_comparison(vm, generic_op));              \
+      result = pop(vm) == VALUE_TRUE;                      \
+    }                                                      \
+    if (!result)                                           \
+      ip = pos - 1;                                        \
+  }                                                        \
+  DISPATCH();
+
+  COMPARE_AND_JUMP(OP_JUMP_IF_NOT_EQUAL, OP_EQUAL, l == r)
+  COMPARE_AND_JUMP(OP_JUMP_IF_EQUAL, OP_NOT_EQUAL, l != r)
+  COMPARE_AND_JUMP(OP_JUMP_IF_NOT_GREATER, OP_GREATER_THAN, l > r)
+
+  TARGET(OP_POP) {
+    pop(vm);
+  }
+  DISPATCH();
+
+  TARGET(OP_MINUS) {
+    CHECK(exec_minus_operator(vm));
+  }
+  DISPATCH();
+
+  TARGET(OP_BANG) {
+    CHECK(exec_bang_operator(vm));
+  }
+  DISPATCH();
+
+  TARGET(OP_JUMP) {
+    ip = read_uint32(&bytes[ip + 1]) - 1;
+  }
+  DISPATCH();
+
+  TARGET(OP_JUMP_NOT_TRUTHY) {
+    int pos = read_uint32(&bytes[ip + 1]);
+    ip += 4;
+    Value condition = pop(vm);
+    if (!VALUE_IS_TRUTHY(condition))
+      ip = pos - 1;
+  }
+  DISPATCH();
+
+  TARGET(OP_NULL) {
+    CHECK(push(vm, VALUE_NULL));
+  }
+  DISPATCH();
+
+  TARGET(OP_GET_GLOBAL) {
+    int global_index = read_uint16(&bytes[ip + 1]);
+    ip += 2;
+    CHECK(push(vm, vm->globals[global_index]));
+  }
+  DISPATCH();
+
+  TARGET(OP_SET_GLOBAL) {
+    int global_index = read_uint16(&bytes[ip + 1]);
+    ip += 2;
+    vm->globals[global_index] = pop(vm);
+    if (global_index >= vm->num_globals)
+      vm->num_globals = global_index + 1;
+  }
+  DISPATCH();
+
+  TARGET(OP_SET_LOCAL) {
+    int local_index = bytes[ip + 1];
+    ip += 1;
+    vm->stack[bp + local_index] = pop(vm);
+  }
+  DISPATCH();
+
+  TARGET(OP_GET_LOCAL) {
+    int local_index = bytes[ip + 1];
+    ip += 1;
+    CHECK(push(vm, vm->stack[bp + local_index]));
+  }
+  DISPATCH();
+
+  TARGET(OP_ARRAY) {
+    int num_elements = read_uint16(&bytes[ip + 1]);
+    ip += 2;
+    Object* array = build_array(vm, vm->sp - num_elements, vm->sp);
+    vm->sp = vm->sp - num_elements;
+    CHECK(push(vm, VALUE_OBJ(array)));
+    COLLECT_GARBAGE();
+  }
+  DISPATCH();
+
+  TARGET(OP_HASH) {
+    int num_elements = read_uint16(&bytes[ip + 1]);
+    ip += 2;
+    CHECK(build_hash(vm, vm->sp - num_elements, vm->sp));
+    COLLECT_GARBAGE();
+  }
+  DISPATCH();
+
+  TARGET(OP_INDEX) {
+    Value index = pop(vm);
+    Value left = pop(vm);
+    CHECK(exec_index_expr(vm, left, index));
+  }
+  DISPATCH();
+
+  TARGET(OP_CALL) {
+    int num_args = bytes[ip + 1];
+    ip += 1;
+    SAVE_FRAME();
+    CHECK(execute_call(vm, num_args));
+    LOAD_FRAME();
+    COLLECT_GARBAGE();
+  }
+  DISPATCH();
+
+  TARGET(OP_TAIL_CALL) {
+    int num_args = bytes[ip + 1];
+    ip += 1;
+    SAVE_FRAME();
+    CHECK(execute_tail_call(vm, num_args));
+    LOAD_FRAME();
+    COLLECT_GARBAGE();
+  }
+  DISPATCH();
+
+  TARGET(OP_RETURN_VALUE) {
+    Value return_value = pop(vm);
+    pop_frame(vm);
+    vm->sp = bp - 1;
+    LOAD_FRAME();
+    CHECK(push(vm, return_value));
+  }
+  DISPATCH();
+
+  TARGET(OP_RETURN) {
+    pop_frame(vm);
+    vm->sp = bp - 1;
+    LOAD_FRAME();
+    CHECK(push(vm, VALUE_NULL));
+  }
+  DISPATCH();
+
+  TARGET(OP_GET_BUILTIN) {
+    int builtin_index = bytes[ip + 1];
+    ip += 1;
+    Object* builtin = get_builtin_by_index(builtin_index);
+    CHECK(push(vm, VALUE_OBJ(builtin)));
+    COLLECT_GARBAGE();
+  }
+  DISPATCH();
+
+  TARGET(OP_CLOSURE) {
+    int const_index = read_uint16(&bytes[ip + 1]);
+    int num_free = bytes[ip + 3];
+    ip += 3;
+    CHECK(push_closure(vm, const_index, num_free));
+    COLLECT_GARBAGE();
+  }
+  DISPATCH();
+
+  TARGET(OP_CURRENT_CLOSURE) {
+    CHECK(push(vm, VALUE_OBJ(frame->cl->object)));
+  }
+  DISPATCH();
+
+  TARGET(OP_GET_FREE) {
+    int free_index = bytes[ip + 1];
+    ip += 1;
+    CHECK(push(vm, frame->cl->free[free_index]));
+  }
+  DISPATCH();
+
+#ifndef COMPUTED_GOTO
+      default:
+        SET_ERR("unknown opcode: %d", bytes[ip]);
+        return err;
     }
   }
+#endif
+
+done:
+  SAVE_FRAME();
   return NULL;
 }
 
-static VmErr push_closure(Vm vm, int const_index, int num_free) {
-  Object* constant = &vm->constant_pool->constants[const_index];
-  if (constant->type != COMPILED_FUNCTION_OBJ) {
-    SET_ERR("not a function: %s", object_type(*constant));
+static OpCode int_specialized(OpCode op) {
+  switch (op) {
+    case OP_ADD:
+      return OP_ADD_INT;
+    case OP_SUB:
+      return OP_SUB_INT;
+    case OP_MUL:
+      return OP_MUL_INT;
+    case OP_DIV:
+      return OP_DIV_INT;
+    case OP_EQUAL:
+      return OP_EQUAL_INT;
+    case OP_NOT_EQUAL:
+      return OP_NOT_EQUAL_INT;
+    default:
+      return OP_GREATER_THAN_INT;
+  }
+}
+
+static OpCode generic(OpCode op) {
+  switch (op) {
+    case OP_ADD_INT:
+      return OP_ADD;
+    case OP_SUB_INT:
+      return OP_SUB;
+    case OP_MUL_INT:
+      return OP_MUL;
+    case OP_DIV_INT:
+      return OP_DIV;
+    case OP_EQUAL_INT:
+      return OP_EQUAL;
+    case OP_NOT_EQUAL_INT:
+      return OP_NOT_EQUAL;
+    default:
+      return OP_GREATER_THAN;
+  }
+}
+
+// rewrites the generic binary opcode at `op` in place if both of its
+// operands (still on the stack) are ints, so it skips type dispatch next time
+static void quicken(Vm vm, Byte* op) {
+  if (BOTH_INTS(vm->stack[vm->sp - 2], vm->stack[vm->sp - 1])) {
+    *op = int_specialized(*op);
+    vm->stats.quickenings++;
+  }
+}
+
+static void dequicken(Vm vm, Byte* op) {
+  *op = generic(*op);
+  vm->stats.dequickenings++;
+}
+
+VmErr push_closure(Vm vm, int const_index, int num_free) {
+  Value constant = vm->constants[const_index];
+  if (!VALUE_HAS_TYPE(constant, COMPILED_FUNCTION_OBJ)) {
+    SET_ERR("not a function: %s", value_type(constant));
     return err;
   }
 
-  Closure* closure = malloc(sizeof(Closure));
-  closure->fn = constant->value.compiled_fn;
+  CompiledFunction* fn = VALUE_AS_OBJ(constant)->value.compiled_fn;
+  if (num_free == 0 && fn->closure != NULL)
+    return push(vm, VALUE_OBJ(fn->closure));
 
+  Closure* closure = new_closure(fn, num_free);
   for (int i = 0; i < num_free; i++)
     closure->free[i] = vm->stack[vm->sp - num_free + i];
   vm->sp -= num_free;
 
-  Object* object = malloc(sizeof(Object));
-  object->type = CLOSURE_OBJ;
-  object->value.closure = closure;
-  return push(vm, object);
+  if (num_free == 0)
+    fn->closure = closure->object;
+  return push(vm, VALUE_OBJ(closure->object));
 }
 
-static VmErr exec_index_expr(Vm vm, Object* left, Object* index) {
-  if (left->type == ARRAY_OBJ && index->type == INTEGER_OBJ) {
-    return exec_array_index(vm, left, index);
-  } else if (left->type == HASH_OBJ) {
-    return exec_hash_index(vm, left, index);
+static Closure* new_closure(CompiledFunction* fn, int num_free) {
+  Closure* closure = malloc(sizeof(Closure) + num_free * sizeof(Value));
+  closure->fn = fn;
+  closure->num_free = num_free;
+  closure->object = object_alloc(CLOSURE_OBJ);
+  closure->object->value.closure = closure;
+  return closure;
+}
+
+void collect_garbage(Vm vm) {
+  clock_t start = clock();
+  heap_begin_collection();
+  for (int i = 0; i < vm->sp; i++)
+    heap_mark(&vm->heap, vm->stack[i]);
+  for (int i = 0; i < vm->num_globals; i++)
+    heap_mark(&vm->heap, vm->globals[i]);
+  for (int i = 0; i < vm->frames_index; i++)
+    heap_mark(&vm->heap, VALUE_OBJ(vm->frames[i].cl->object));
+  for (int i = 0; i < vm->num_constants; i++)
+    heap_mark(&vm->heap, vm->constants[i]);
+  vm->stats.bytes_freed += heap_sweep(&vm->heap);
+  vm->stats.collections++;
+  vm->stats.gc_pause_time += (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+VmErr exec_index_expr(Vm vm, Value left, Value index) {
+  if (VALUE_HAS_TYPE(left, ARRAY_OBJ) && VALUE_IS_INT(index)) {
+    return exec_array_index(vm, VALUE_AS_OBJ(left), VALUE_AS_INT(index));
+  } else if (VALUE_HAS_TYPE(left, HASH_OBJ)) {
+    return exec_hash_index(vm, VALUE_AS_OBJ(left), index);
   } else {
-    SET_ERR("index operator not supported: %s", object_type(*left));
+    SET_ERR("index operator not supported: %s", value_type(left));
     return err;
   }
 }
 
-static VmErr exec_array_index(Vm vm, Object* array, Object* index) {
-  List* elements = array->value.list;
-  int i = index->value.i;
-  int max = list_count(elements) - 1;
-  if (i < 0 || i > max) {
-    return push(vm, &M_NULL);
-  }
-
-  List* current = elements;
-  for (int j = 0; j <= max; j++, current = current->next) {
-    if (j == i) {
-      return push(vm, current->item);
-    }
+static VmErr exec_array_index(Vm vm, Object* array, int i) {
+  Array* elements = array->value.array;
+  if (i < 0 || i >= elements->length) {
+    return push(vm, VALUE_NULL);
   }
-
-  puts("unexpected error indexing into array");
-  exit(EXIT_FAILURE);
+  return push(vm, array_get(elements, i));
 }
 
-static VmErr exec_hash_index(Vm vm, Object* hash, Object* index) {
-  char* index_hash = object_hash(*index);
-  if (index_hash == NULL) {
-    SET_ERR("unusable as hash key: %s", object_type(*index));
+static VmErr exec_hash_index(Vm vm, Object* hash, Value index) {
+  if (!object_hashable(index)) {
+    SET_ERR("unusable as hash key: %s", value_type(index));
     return err;
   }
-
-  for (List* current = hash->value.list; current; current = current->next) {
-    HashPair* pair = current->item;
-    char* key_hash = object_hash(*pair->key);
-    if (strcmp(key_hash, index_hash) == 0)
-      return push(vm, pair->value);
-  }
-
-  return push(vm, &M_NULL);
+  HashEntry* entry = hash_get(hash->value.hash, index);
+  return push(vm, entry ? entry->value : VALUE_NULL);
 }
 
-static Object* build_array(Vm vm, int start_index, int end_index) {
-  Object* array = malloc(sizeof(Object));
-  array->type = ARRAY_OBJ;
-  List* elements = NULL;
-  for (int i = start_index; i < end_index; i++)
-    elements = list_append(elements, vm->stack[i]);
-  array->value.list = elements;
+Object* build_array(Vm vm, int start_index, int end_index) {
+  Object* array = object_alloc(ARRAY_OBJ);
+  array->value.array =
+    array_from(&vm->stack[start_index], end_index - start_index);
   return array;
 }
 
-static Object* build_hash(Vm vm, int start_index, int end_index) {
-  Object* hash = malloc(sizeof(Object));
-  hash->type = HASH_OBJ;
-  List* pairs = NULL;
+VmErr build_hash(Vm vm, int start_index, int end_index) {
+  Hash* entries = hash_new((end_index - start_index) / 2);
   for (int i = start_index; i < end_index; i += 2) {
-    Object* key = vm->stack[i];
-    Object* value = vm->stack[i + 1];
-    HashPair* pair = malloc(sizeof(HashPair));
-    pair->key = key;
-    pair->value = value;
-    pairs = list_append(pairs, pair);
+    if (!hash_put(entries, vm->stack[i], vm->stack[i + 1])) {
+      SET_ERR("unusable as hash key: %s", value_type(vm->stack[i]));
+      return err;
+    }
   }
-  hash->value.list = pairs;
-  return hash;
+  Object* hash = object_alloc(HASH_OBJ);
+  hash->value.hash = entries;
+  vm->sp = start_index;
+  return push(vm, VALUE_OBJ(hash));
 }
 
 VmErr exec_minus_operator(Vm vm) {
-  Object* operand = pop(vm);
-  if (operand->type != INTEGER_OBJ) {
-    SET_ERR("unsupported type for negation: %s", object_type(*operand));
+  Value operand = pop(vm);
+  if (!VALUE_IS_INT(operand)) {
+    SET_ERR("unsupported type for negation: %s", value_type(operand));
     return err;
   }
-  Object* inverse = malloc(sizeof(Object));
-  inverse->type = INTEGER_OBJ;
-  inverse->value.i = -(operand->value.i);
-  return push(vm, inverse);
+  return push(vm, VALUE_INT(-VALUE_AS_INT(operand)));
 }
 
 VmErr exec_bang_operator(Vm vm) {
-  Object* operand = pop(vm);
-  if (operand->type == BOOLEAN_OBJ) {
-    return push(vm, bool_obj(!operand->value.b));
-  } else if (operand->type == NULL_OBJ) {
-    return push(vm, &TRUE);
+  Value operand = pop(vm);
+  if (VALUE_IS_BOOL(operand)) {
+    return push(vm, VALUE_BOOL(operand == VALUE_FALSE));
+  } else if (operand == VALUE_NULL) {
+    return push(vm, VALUE_TRUE);
   } else {
-    return push(vm, &FALSE);
+    return push(vm, VALUE_FALSE);
   }
 }
 
 VmErr exec_comparison(Vm vm, OpCode op) {
-  Object* right = pop(vm);
-  Object* left = pop(vm);
-  if (left->type == INTEGER_OBJ && right->type == INTEGER_OBJ) {
-    return exec_int_comparison(vm, op, left->value.i, right->value.i);
+  Value right = pop(vm);
+  Value left = pop(vm);
+  if (VALUE_IS_INT(left) && VALUE_IS_INT(right)) {
+    return exec_int_comparison(
+      vm, op, VALUE_AS_INT(left), VALUE_AS_INT(right));
   }
-  if (left->type != BOOLEAN_OBJ && right->type != BOOLEAN_OBJ) {
+  if (!VALUE_IS_BOOL(left) && !VALUE_IS_BOOL(right)) {
     SET_ERR("unsupported types for comparison operation: %s %s",
-      object_type(*left), object_type(*right));
+      value_type(left), value_type(right));
     return err;
   }
   switch (op) {
     case OP_EQUAL:
-      return push(vm, bool_obj(right->value.b == left->value.b));
+      return push(vm, VALUE_BOOL(right == left));
     case OP_NOT_EQUAL:
-      return push(vm, bool_obj(right->value.b != left->value.b));
+      return push(vm, VALUE_BOOL(right != left));
     default:
-      SET_ERR("unknown operator: %d, (%s %s)", op, object_type(*left),
-        object_type(*right));
+      SET_ERR("unknown operator: %d, (%s %s)", op, value_type(left),
+        value_type(right));
       return err;
   }
 }
@@ -426,11 +700,11 @@ VmErr exec_comparison(Vm vm, OpCode op) {
 VmErr exec_int_comparison(Vm vm, OpCode op, int leftValue, int rightValue) {
   switch (op) {
     case OP_EQUAL:
-      return push(vm, bool_obj(leftValue == rightValue));
+      return push(vm, VALUE_BOOL(leftValue == rightValue));
     case OP_NOT_EQUAL:
-      return push(vm, bool_obj(leftValue != rightValue));
+      return push(vm, VALUE_BOOL(leftValue != rightValue));
     case OP_GREATER_THAN:
-      return push(vm, bool_obj(leftValue > rightValue));
+      return push(vm, VALUE_BOOL(leftValue > rightValue));
     default:
       SET_ERR("unknown operator: %d", op);
       return err;
@@ -438,41 +712,38 @@ VmErr exec_int_comparison(Vm vm, OpCode op, int leftValue, int rightValue) {
 }
 
 VmErr exec_binary_operation(Vm vm, OpCode op) {
-  Object* right = pop(vm);
-  Object* left = pop(vm);
+  Value right = pop(vm);
+  Value left = pop(vm);
 
-  if (left->type == INTEGER_OBJ && right->type == INTEGER_OBJ)
-    return exec_binary_int_operation(vm, op, left->value.i, right->value.i);
+  if (VALUE_IS_INT(left) && VALUE_IS_INT(right))
+    return exec_binary_int_operation(
+      vm, op, VALUE_AS_INT(left), VALUE_AS_INT(right));
 
-  if (left->type == STRING_OBJ && right->type == STRING_OBJ)
-    return exec_binary_str_operation(vm, op, left->value.str, right->value.str);
+  if (VALUE_HAS_TYPE(left, STRING_OBJ) && VALUE_HAS_TYPE(right, STRING_OBJ))
+    return exec_binary_str_operation(vm, op, VALUE_AS_OBJ(left)->value.str,
+      VALUE_AS_OBJ(right)->value.str);
 
-  SET_ERR("unsupported types for binary operation: %s %s", object_type(*left),
-    object_type(*right));
+  SET_ERR("unsupported types for binary operation: %s %s", value_type(left),
+    value_type(right));
   return err;
 }
 
 static VmErr exec_binary_int_operation(Vm vm, OpCode op, int left, int right) {
-  Object* object = malloc(sizeof object);
-  object->type = INTEGER_OBJ;
   switch ((int)op) {
     case OP_SUB:
-      object->value.i = left - right;
-      break;
+      return push(vm, VALUE_INT(left - right));
     case OP_ADD:
-      object->value.i = left + right;
-      break;
+      return push(vm, VALUE_INT(left + right));
     case OP_MUL:
-      object->value.i = left * right;
-      break;
+      return push(vm, VALUE_INT(left * right));
     case OP_DIV:
-      object->value.i = left / right;
-      break;
+      if (right == 0)
+        return "division by zero";
+      return push(vm, VALUE_INT(left / right));
     default:
       SET_ERR("unknown integer operator: %d", op);
       return err;
   }
-  return push(vm, object);
 }
 
 static VmErr exec_binary_str_operation(
@@ -483,87 +754,78 @@ static VmErr exec_binary_str_operation(
   }
   char* combined = malloc(strlen(left) + strlen(right) + 1);
   sprintf(combined, "%s%s", left, right);
-  Object* object = malloc(sizeof(Object));
-  object->type = STRING_OBJ;
+  Object* object = object_alloc(STRING_OBJ);
   object->value.str = combined;
-  return push(vm, object);
+  return push(vm, VALUE_OBJ(object));
 }
 
-VmErr push(Vm vm, Object* object) {
-  if (vm->sp > STACK_SIZE)
+VmErr push(Vm vm, Value value) {
+  if (vm->sp >= STACK_SIZE)
     return "stack overflow";
-  vm->stack[vm->sp] = object;
+  vm->stack[vm->sp] = value;
   vm->sp++;
   return NULL;
 }
 
-Object* pop(Vm vm) {
-  Object* object = vm->stack[--vm->sp];
-  return object;
+Value pop(Vm vm) {
+  return vm->stack[--vm->sp];
 }
 
 Object* vm_stack_top(Vm vm) {
   if (vm->sp == 0) {
     return NULL;
   } else {
-    return vm->stack[vm->sp - 1];
+    return value_box(vm->stack[vm->sp - 1]);
   }
 }
 
 static Object* new_compiled_fn(Instruct* instructions, int num_locals) {
   CompiledFunction* compiled_fn = malloc(sizeof(CompiledFunction));
   compiled_fn->num_locals = num_locals;
+  compiled_fn->num_params = 0;
   compiled_fn->instructions = instructions;
-  Object* obj = malloc(sizeof(Object));
-  obj->type = COMPILED_FUNCTION_OBJ;
+  compiled_fn->closure = NULL;
+  compiled_fn->native = NULL;
+  Object* obj = object_alloc(COMPILED_FUNCTION_OBJ);
   obj->value.compiled_fn = compiled_fn;
   return obj;
 }
 
-static Frame* new_frame(Closure* closure, int base_pointer) {
-  Frame* frame = malloc(sizeof(Frame));
-  frame->cl = closure;
-  frame->ip = -1;
-  frame->base_pointer = base_pointer;
-  return frame;
-}
-
 Object* vm_last_popped(Vm vm) {
-  return vm->stack[vm->sp];
-}
-
-Object* bool_obj(bool boolean) {
-  return boolean ? &TRUE : &FALSE;
+  return value_box(vm->stack[vm->sp]);
 }
 
 void inspect_stack(Vm vm, const char* fn) {
   printf("\n-- inspected from (%s) sp=%d --\n", fn, vm->sp);
   for (int i = 0; i < vm->sp; i++) {
     printf("vm->stack[%d]=%p\n", i, (void*)vm->stack[i]);
-    object_print(*vm->stack[i]);
+    object_print(value_to_object(vm->stack[i]));
   }
 }
 
-static Frame* current_frame(Vm vm) {
-  return vm->frames[vm->frames_index - 1];
+Frame* current_frame(Vm vm) {
+  return &vm->frames[vm->frames_index - 1];
 }
 
-static void push_frame(Vm vm, Frame* frame) {
-  vm->frames[vm->frames_index++] = frame;
-}
-
-static Frame* pop_frame(Vm vm) {
-  return vm->frames[--vm->frames_index];
+static Frame* push_frame(Vm vm, Closure* closure, int base_pointer) {
+  Frame* frame = &vm->frames[vm->frames_index++];
+  frame->cl = closure;
+  frame->ip = -1;
+  frame->base_pointer = base_pointer;
+  return frame;
 }
 
-static Instruct* current_instructions(Vm vm) {
-  return current_frame(vm)->cl->fn->instructions;
+static void pop_frame(Vm vm) {
+  vm->frames_index--;
 }
 
-static VmErr execute_call(Vm vm, int num_args) {
-  Object* fn = vm->stack[vm->sp - 1 - num_args];
-  if (fn == NULL)
+VmErr execute_call(Vm vm, int num_args) {
+  Value callee = vm->stack[vm->sp - 1 - num_args];
+  if (callee == 0)
     return "null pointer for execute_call()";
+  if (!VALUE_IS_OBJ(callee))
+    return "calling non-function and non-built-in";
+  Object* fn = VALUE_AS_OBJ(callee);
   switch (fn->type) {
     case CLOSURE_OBJ:
       return call_closure(vm, fn, num_args);
@@ -574,25 +836,44 @@ static VmErr execute_call(Vm vm, int num_args) {
   }
 }
 
+// a closure called in tail position replaces the caller: the callee and its
+// arguments slide down over the caller's, so loops written as tail
+// recursion run in constant stack. Builtins return to the caller as usual,
+// whose next instruction returns their result
+VmErr execute_tail_call(Vm vm, int num_args) {
+  Value callee = vm->stack[vm->sp - 1 - num_args];
+  if (!VALUE_HAS_TYPE(callee, CLOSURE_OBJ))
+    return execute_call(vm, num_args);
+
+  int caller_slot = current_frame(vm)->base_pointer - 1;
+  memmove(&vm->stack[caller_slot], &vm->stack[vm->sp - 1 - num_args],
+    sizeof(Value) * (num_args + 1));
+  vm->sp = caller_slot + 1 + num_args;
+  pop_frame(vm);
+  return call_closure(vm, VALUE_AS_OBJ(callee), num_args);
+}
+
 static VmErr call_closure(Vm vm, Object* fn, int num_args) {
   if (num_args != fn->value.closure->fn->num_params) {
     SET_ERR("wrong number of arguments: want=%d, got=%d",
       fn->value.closure->fn->num_params, num_args);
     return err;
   }
-  Frame* frame = new_frame(fn->value.closure, vm->sp - num_args);
-  push_frame(vm, frame);
-  vm->sp = frame->base_pointer + fn->value.closure->fn->num_locals;
+  int num_locals = fn->value.closure->fn->num_locals;
+  if (vm->frames_index >= MAX_FRAMES || vm->sp + num_locals >= STACK_SIZE)
+    return "stack overflow";
+  Frame* frame = push_frame(vm, fn->value.closure, vm->sp - num_args);
+  // clear stale values from the new locals, the collector scans them
+  for (; vm->sp < frame->base_pointer + num_locals; vm->sp++)
+    vm->stack[vm->sp] = VALUE_NULL;
   return NULL;
 }
 
 static VmErr call_builtin(Vm vm, Object* fn, int num_args) {
-  List* args = NULL;
-  for (int i = vm->sp - num_args; i < vm->sp; i++) {
-    args = list_append(args, vm->stack[i]);
-  }
-  Object result = (fn->value.builtin_fn)(args);
-  if (result.type == ERROR_OBJ)
-    return result.value.str;
-  return push(vm, memcpy(malloc(sizeof(Object)), &result, sizeof(Object)));
+  Value* args = &vm->stack[vm->sp - num_args];
+  Value result = (fn->value.builtin_fn)(args, num_args);
+  if (VALUE_HAS_TYPE(result, ERROR_OBJ))
+    return VALUE_AS_OBJ(result)->value.str;
+  vm->sp = vm->sp - num_args - 1;
+  return push(vm, result);
 }
@@ -6,14 +6,41 @@
 
 #define GLOBALS_SIZE 65536
 
+// native code generation is only implemented for x86-64 Linux
+#if defined(__x86_64__) && defined(__linux__)
+#define JIT_SUPPORTED
+#endif
+
 typedef char* VmErr;
 
 // incomplete declaration for encapsulation
 typedef struct Vm_t* Vm;
 
+typedef struct VmStats {
+  long allocations;
+  long allocations_by_type[NUM_OBJECT_TYPES];
+  long collections;
+  long bytes_freed;
+  double gc_pause_time;  // seconds spent collecting garbage
+  long quickenings;      // generic opcodes rewritten to int-specialized ones
+  long dequickenings;    // ...and rewritten back after a non-int operand
+  long jit_compiled;     // functions translated to native code
+  // only counted in builds with `make monkey PROFILE=true`
+  long dispatches;
+  long* opcode_pairs;  // [previous * NUM_OPCODES + next], NULL if unprofiled
+} VmStats;
+
 Vm vm_new(Bytecode* bytecode);
-Vm vm_new_with_globals(Bytecode* bytecode, Object** globals);
+Vm vm_new_with_globals(Bytecode* bytecode, Value* globals);
 VmErr vm_run(Vm vm);
+
+/**
+ * Runs the program as native code on later `vm_run()`s, translating each
+ * function on its first call. Returns false, leaving the interpreter in
+ * place, where the JIT isn't supported.
+ */
+bool vm_use_jit(Vm vm);
+VmStats vm_stats(Vm vm);
 Object* vm_stack_top(Vm vm);
 Object* vm_last_popped(Vm vm);
 
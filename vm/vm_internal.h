@@ -0,0 +1,51 @@
+#ifndef __VM_INTERNAL_H__
+#define __VM_INTERNAL_H__
+
+#include <stdbool.h>
+#include "vm.h"
+
+// the VM's state and the runtime helpers its instructions are built from,
+// shared by the interpreter in vm.c and the native code generator in jit.c
+
+#define STACK_SIZE 2048
+#define MAX_FRAMES 1024
+
+typedef struct Frame {
+  Closure* cl;
+  int ip;
+  int base_pointer;
+} Frame;
+
+struct Vm_t {
+  Value* constants;
+  int num_constants;
+  Value stack[STACK_SIZE];
+  Value* globals;
+  int num_globals;  // globals at or past this index are unset
+  Frame frames[MAX_FRAMES];  // stored inline, reused across calls
+  int frames_index;
+  int sp;
+  Heap heap;
+  VmStats stats;
+  bool jit;  // run as native code, see `vm_use_jit()`
+};
+
+VmErr push(Vm vm, Value value);
+Value pop(Vm vm);
+Object* build_array(Vm vm, int start_index, int end_index);
+VmErr build_hash(Vm vm, int start_index, int end_index);
+VmErr exec_index_expr(Vm vm, Value left, Value index);
+VmErr exec_binary_operation(Vm vm, OpCode op);
+VmErr exec_comparison(Vm vm, OpCode op);
+VmErr exec_bang_operator(Vm vm);
+VmErr exec_minus_operator(Vm vm);
+Frame* current_frame(Vm vm);
+VmErr execute_call(Vm vm, int num_args);
+VmErr execute_tail_call(Vm vm, int num_args);
+VmErr push_closure(Vm vm, int const_index, int num_free);
+void collect_garbage(Vm vm);
+
+// implemented in jit.c
+VmErr jit_run(Vm vm);
+
+#endif  // __VM_INTERNAL_H__
@@ -7,6 +7,8 @@
 #include <string.h>
 #include "../compiler/compiler.h"
 #include "../parser/parser.h"
+#include "../regvm/reg_compiler.h"
+#include "../regvm/reg_vm.h"
 #include "../test/test.h"
 #include "../utils/colors.h"
 
@@ -31,6 +33,8 @@ typedef struct Expected {
   } v;
 } Expected;
 
+typedef enum Backend { BACKEND_STACK, BACKEND_JIT, BACKEND_REGISTERS } Backend;
+
 typedef struct VmTest {
   char* input;
   Expected expected;
@@ -44,6 +48,7 @@ Expected expect_err(char* err_msg);
 Expected expect_null();
 Expected* make_exp_int(int integer);
 void run_vm_tests(int len, VmTest tests[len], const char* test);
+void run_vm_test(VmTest t, Backend backend, const char* test);
 void test_expected_object(Expected exp, Object* obj, char* test);
 
 static int _ = INT_MAX;
@@ -66,6 +71,11 @@ void test_integer_arithmetic(void) {
     {.input = "-10", .expected = expect_int(-10)},                 //
     {.input = "-50 + 100 + -50", .expected = expect_int(0)},       //
     {.input = "(5 + 10 / 3) * -2", .expected = expect_int(-16)},   //
+    {.input = "1 / 0", .expected = expect_err("division by zero")},  //
+    {
+      .input = "let f = fn(x) { 10 / x }; f(5) + f(0)",
+      .expected = expect_err("division by zero"),
+    },
   };
   run_vm_tests(LEN(tests), tests, "integer_arithmetic");
 }
@@ -207,6 +217,14 @@ void test_index_expressions(void) {
     {.input = "{1: 1, 2: 2}[2]", .expected = expect_int(2)},    //
     {.input = "{1: 1}[0]", .expected = expect_null()},          //
     {.input = "{}[0]", .expected = expect_null()},              //
+    {.input = "{true: 1, false: 2}[false]", .expected = expect_int(2)},
+    {.input = "{1: 1, 1: 2}[1]", .expected = expect_int(2)},
+    {.input = "{\"foo\": 5}[\"fo\" + \"o\"]", .expected = expect_int(5)},
+    {.input = "{\"a\": 1, \"b\": 2, \"c\": 3, \"d\": 4, \"e\": 5, \"f\": 6,"
+              " \"g\": 7, \"h\": 8, \"i\": 9}[\"h\"]",
+      .expected = expect_int(8)},
+    {.input = "{[1]: 2}",
+      .expected = expect_err("unusable as hash key: ARRAY")},
   };
   run_vm_tests(LEN(tests), tests, __func__);
 }
@@ -428,6 +446,15 @@ void test_builtin_fns(void) {
       .input = "len(\"hello world\")",
       .expected = expect_int(11),
     },
+    {
+      .input = "push([1], len([1, 2]))",
+      .expected = expect_int_arr(1, 2, _),
+    },
+    {
+      .input = "let a = [1, 2, 3]; let b = push(a, 4); let c = push(a, 5);"
+               "[len(a), b[3], c[3], last(rest(b))]",
+      .expected = expect_int_arr(3, 4, 5, 4, _),
+    },
     {
       .input = "len(1)",
       .expected = expect_err("argument to `len` not supported, got INTEGER"),
@@ -476,13 +503,17 @@ void test_builtin_fns(void) {
       .input = "rest([])",
       .expected = expect_null(),
     },
+    {
+      .input = "rest(1)",
+      .expected = expect_err("argument to `rest` must be ARRAY, got INTEGER"),
+    },
     {
       .input = "push([], 1)",
       .expected = expect_int_arr(1, _),
     },
     {
       .input = "push(1, 1)",
-      .expected = expect_err("arguemnt to `push` must be ARRAY, got INTEGER"),
+      .expected = expect_err("argument to `push` must be ARRAY, got INTEGER"),
     },
   };
   run_vm_tests(LEN(tests), tests, __func__);
@@ -537,6 +568,20 @@ void test_closures(void) {
       closure();",
       .expected = expect_int(99),
     },
+    {
+      .input = "\
+      let newAdder = fn(a) { fn(b) { a + b; }; };\
+      let addOne = newAdder(1);\
+      let addTwo = newAdder(2);\
+      addOne(10) + addTwo(10);",
+      .expected = expect_int(23),
+    },
+    {
+      .input = "\
+      let newFive = fn() { fn() { 5; }; };\
+      newFive()() + newFive()();",
+      .expected = expect_int(10),
+    },
   };
   run_vm_tests(LEN(tests), tests, __func__);
 }
@@ -589,8 +634,200 @@ void test_recursive_closures(void) {
   run_vm_tests(LEN(tests), tests, __func__);
 }
 
+void test_stack_overflow(void) {
+  VmTest tests[] = {
+    {
+      .input = "\
+      let countDown = fn(x) {\
+        if (x == 0) {\
+          return 0;\
+        } else {\
+          1 + countDown(x - 1);\
+        }\
+      };\
+      countDown(5000);",
+      .expected = expect_err("stack overflow"),
+    },
+  };
+  run_vm_tests(LEN(tests), tests, __func__);
+}
+
+void test_tail_calls(void) {
+  VmTest tests[] = {
+    {
+      .input = "let count = fn(n, acc) {"
+               "  if (n == 0) { acc } else { count(n - 1, acc + 1) }"
+               "};"
+               "count(1000000, 0)",
+      .expected = expect_int(1000000),
+    },
+    {
+      .input = "let bounce = fn(n, f, g) {"
+               "  if (n == 0) { return n; }"
+               "  f(n - 1, g, f)"
+               "};"
+               "bounce(100000, bounce, bounce)",
+      .expected = expect_int(0),
+    },
+    {
+      .input = "let make = fn(step) {"
+               "  let loop = fn(n, acc) {"
+               "    if (n == 0) { acc } else { loop(n - 1, acc + step) }"
+               "  };"
+               "  loop"
+               "};"
+               "make(3)(100000, 0)",
+      .expected = expect_int(300000),
+    },
+    {
+      .input = "let sum = fn(a, b, c) { a + b + c };"
+               "let one = fn(x) { sum(x, x, x) };"
+               "let three = fn(a, b, c) { let d = a * b; one(d + c) };"
+               "[one(2), three(1, 2, 3), 1 + three(0, 0, 1)]",
+      .expected = expect_int_arr(6, 15, 4, _),
+    },
+    {
+      .input = "let f = fn(a) { len(a) }; f([1, 2, 3]) + 1",
+      .expected = expect_int(4),
+    },
+    {
+      .input = "let f = fn(a) { a }; let g = fn() { f() }; g()",
+      .expected = expect_err("wrong number of arguments: want=1, got=0"),
+    },
+  };
+  run_vm_tests(LEN(tests), tests, __func__);
+}
+
+void test_garbage_collection(void) {
+  char* input =
+    "let keep = [1, 2, 3];"
+    "let str = \"a\" + \"b\";"
+    "let newAdder = fn(x) { fn(y) { x + y } };"
+    "let addThree = newAdder(keep[2]);"
+    "let build = fn(arr, n) {"
+    "  if (n == 0) { arr } else { build(push(arr, n), n - 1) }"
+    "};"
+    "let loop = fn(i, acc) {"
+    "  if (i == 0) { acc } else { loop(i - 1, acc + len(build([], 100))) }"
+    "};"
+    "loop(200, 0) + addThree(first(keep)) + len(str);";
+  Program* program = parse_program(input);
+  Compiler compiler = compiler_new();
+  assert(compile(compiler, program, PROGRAM_NODE) == NULL, "compiled",
+    __func__);
+  Vm vm = vm_new(compiler_bytecode(compiler));
+  assert(vm_run(vm) == NULL, "ran without error", __func__);
+  assert_integer_object(20006, *vm_last_popped(vm), __func__);
+  VmStats stats = vm_stats(vm);
+  assert(stats.collections > 0, "collected garbage", __func__);
+  assert(stats.bytes_freed > 0, "freed garbage", __func__);
+}
+
+void test_quickening(void) {
+  VmTest tests[] = {
+    {
+      .input = "let f = fn(a, b) { a + b };"
+               "let x = f(1, 2); let s = f(\"a\", \"b\");"
+               "[x, len(s), f(3, 4)]",
+      .expected = expect_int_arr(3, 2, 7, _),
+    },
+    {
+      .input = "let eq = fn(a, b) { a == b }; eq(1, 2); eq(true, true)",
+      .expected = expect_bool(true),
+    },
+    {
+      .input = "let gt = fn(a, b) { a > b }; gt(1, 2); gt(3, 2)",
+      .expected = expect_bool(true),
+    },
+  };
+  run_vm_tests(LEN(tests), tests, __func__);
+
+  Program* program = parse_program(
+    "let f = fn(a, b) { a - b }; f(5, 3); f(\"a\", 1); f(9, 3);");
+  Compiler compiler = compiler_new();
+  compile(compiler, program, PROGRAM_NODE);
+  Vm vm = vm_new(compiler_bytecode(compiler));
+  assert(vm_run(vm) != NULL, "string minus int is an error", __func__);
+  VmStats stats = vm_stats(vm);
+  assert_int_is(1, stats.quickenings, "quickened once", __func__);
+  assert_int_is(1, stats.dequickenings, "dequickened on type miss", __func__);
+}
+
+void test_superinstructions(void) {
+  VmTest tests[] = {
+    {
+      .input = "let f = fn(x) { if (x == 1) { x + 2 } else { x - 3 } };"
+               "[f(1), f(10)]",
+      .expected = expect_int_arr(3, 7, _),
+    },
+    {
+      .input = "let f = fn(s) { s + \"!\" }; f(\"hi\")",
+      .expected = expect_str("hi!"),
+    },
+    {
+      .input = "let f = fn(b) { if (b != true) { 1 } else { 2 } }; f(false)",
+      .expected = expect_int(1),
+    },
+    {
+      .input = "let f = fn(x) { (if (x > 1) { 1 } else { x }) - 1 };"
+               "[f(5), f(0)]",
+      .expected = expect_int_arr(0, -1, _),
+    },
+    {
+      .input = "let f = fn(s) { s - 1 }; f(\"a\")",
+      .expected = expect_err("unsupported types for binary operation: "
+                             "STRING INTEGER"),
+    },
+  };
+  run_vm_tests(LEN(tests), tests, __func__);
+}
+
+void test_large_programs(void) {
+  Program* program = parse_program("if (true) { false } else { true };");
+  List* statements = NULL;
+  for (int i = 0; i < 100000; i++) {
+    List* node = malloc(sizeof(List));
+    node->item = program->statements->item;
+    node->next = statements;
+    statements = node;
+  }
+  program->statements = statements;
+  Compiler compiler = compiler_new();
+  assert(compile(compiler, program, PROGRAM_NODE) == NULL, "compiled",
+    __func__);
+  Vm vm = vm_new(compiler_bytecode(compiler));
+  assert(vm_run(vm) == NULL, "ran without error", __func__);
+  Object* result = vm_last_popped(vm);
+  assert(result->type == BOOLEAN_OBJ && !result->value.b, "false", __func__);
+}
+
+// the program and each function are translated once, on their first call
+void test_jit(void) {
+#ifdef JIT_SUPPORTED
+  Program* program = parse_program(
+    "let add = fn(a, b) { a + b };"
+    "let twice = fn(f, x) { f(x, x) };"
+    "twice(add, 2) + twice(add, 3)");
+  Compiler compiler = compiler_new();
+  assert(compile(compiler, program, PROGRAM_NODE) == NULL, "compiled",
+    __func__);
+  Vm vm = vm_new(compiler_bytecode(compiler));
+  assert(vm_use_jit(vm), "jit enabled", __func__);
+  assert(vm_run(vm) == NULL, "ran without error", __func__);
+  assert_integer_object(10, *vm_last_popped(vm), __func__);
+  assert_int_is(3, vm_stats(vm).jit_compiled, "compiled once each", __func__);
+#endif
+}
+
 int main(int argc, char** argv) {
   pass_argv(argc, argv);
+  test_jit();
+  test_large_programs();
+  test_quickening();
+  test_superinstructions();
+  test_garbage_collection();
+  test_tail_calls();
+  test_stack_overflow();
   test_recursive_closures();
   test_closures();
   test_builtin_fns();
@@ -613,11 +850,38 @@ int main(int argc, char** argv) {
   return 0;
 }
 
+// every case runs on the interpreter, then again as native code where the
+// JIT is supported and on the register VM, held to the same expectations
 void run_vm_tests(int len, VmTest tests[len], const char* test) {
-  char* err = NULL;
   for (int i = 0; i < len; i++) {
-    VmTest t = tests[i];
-    Program* program = parse_program(t.input);
+    run_vm_test(tests[i], BACKEND_STACK, test);
+#ifdef JIT_SUPPORTED
+    run_vm_test(tests[i], BACKEND_JIT, ss("%s (jit)", test));
+#endif
+    run_vm_test(tests[i], BACKEND_REGISTERS, ss("%s (registers)", test));
+  }
+}
+
+// the register VM's result is the value of the last expression statement,
+// the stack VM's is the last value popped
+static char* run_registers(Program* program, Object** result) {
+  RegCompiler compiler = reg_compiler_new();
+  char* err = reg_compile(compiler, program);
+  if (err)
+    return ss("compiler error: %s", err);
+  RegVm vm = reg_vm_new(reg_compiler_bytecode(compiler));
+  err = reg_vm_run(vm);
+  *result = err ? NULL : reg_vm_result(vm);
+  return err;
+}
+
+void run_vm_test(VmTest t, Backend backend, const char* test) {
+  Program* program = parse_program(t.input);
+  char* err;
+  Object* last_popped = NULL;
+  if (backend == BACKEND_REGISTERS) {
+    err = run_registers(program, &last_popped);
+  } else {
     Compiler compiler = compiler_new();
     err = compile(compiler, program, PROGRAM_NODE);
     if (err) {
@@ -625,25 +889,29 @@ void run_vm_tests(int len, VmTest tests[len], const char* test) {
     }
 
     Vm vm = vm_new(compiler_bytecode(compiler));
+    if (backend == BACKEND_JIT)
+      vm_use_jit(vm);
     err = vm_run(vm);
+    last_popped = err ? NULL : vm_last_popped(vm);
+  }
 
-    if (t.expected.type == EXP_ERR) {
-      if (!err)
-        fail("expected VM error but resulted in none", test);
-      else if (strcmp(err, t.expected.v.s) != 0)
-        fail(ss("wrong VM error: want=%s, got=%s", t.expected.v.s, err), test);
-      else
-        assert_str_is(t.expected.v.s, err, "expected VM err correct", test);
-      return;
-    }
-
-    if (err)
-      fail(ss("vm error: %s", err), test);
+  if (t.expected.type == EXP_ERR) {
+    if (!err)
+      fail("expected VM error but resulted in none", test);
+    else if (strcmp(err, t.expected.v.s) != 0)
+      fail(ss("wrong VM error: want=%s, got=%s", t.expected.v.s, err), test);
+    else
+      assert_str_is(t.expected.v.s, err, "expected VM err correct", test);
+    return;
+  }
 
-    Object* last_popped = vm_last_popped(vm);
-    test_expected_object(
-      t.expected, last_popped, ss("%s, input=`%s`", test, t.input));
+  if (err) {
+    fail(ss("vm error: %s", err), test);
+    return;
   }
+
+  test_expected_object(
+    t.expected, last_popped, ss("%s, input=`%s`", test, t.input));
 }
 
 void test_expected_object(Expected exp, Object* obj, char* test) {
@@ -663,23 +931,25 @@ void test_expected_object(Expected exp, Object* obj, char* test) {
       break;
     case EXP_INT_ARR: {
       assert(obj->type == ARRAY_OBJ, "array obj correct type", test);
-      assert_int_is(exp.arr_len, list_count(obj->value.list),
-        "correct num arr elements", test);
-      int index = 0;
-      for (List* cur = obj->value.list; cur != NULL; cur = cur->next, index++) {
-        Object* arr_element = cur->item;
-        assert_integer_object(exp.v.arr[index]->v.i, *arr_element, test);
+      Array* array = obj->value.array;
+      assert_int_is(
+        exp.arr_len, array->length, "correct num arr elements", test);
+      for (int index = 0; index < array->length; index++) {
+        Object arr_element = value_to_object(array_get(array, index));
+        assert_integer_object(exp.v.arr[index]->v.i, arr_element, test);
       }
     } break;
     case EXP_HASH: {
       assert(obj->type == HASH_OBJ, "hash obj correct type", test);
-      assert_int_is(exp.arr_len, list_count(obj->value.list) * 2,
-        "correct num hash elements", test);
+      Hash* hash = obj->value.hash;
+      assert_int_is(
+        exp.arr_len, hash->length * 2, "correct num hash elements", test);
       int index = 0;
-      for (List* cur = obj->value.list; cur != NULL; cur = cur->next) {
-        HashPair* pair = cur->item;
-        test_expected_object(*exp.v.arr[index++], pair->key, test);
-        test_expected_object(*exp.v.arr[index++], pair->value, test);
+      for (int i = 0; i < hash->length; i++) {
+        HashEntry* entry = &hash->entries[i];
+        test_expected_object(*exp.v.arr[index++], value_box(entry->key), test);
+        test_expected_object(
+          *exp.v.arr[index++], value_box(entry->value), test);
       }
     } break;
     default: